@@ -21,14 +21,18 @@ then
   TEST_CPU_AND_MEMORY=true
   TEST_CALLGRIND=false
   TEST_PERF=true
+  TEST_COMPARISONS=true
+  TEST_VERIFY=true
+  TEST_SCRATCH=true
 
   DEV_SETTINGS=false
 
   if [ "$DEV_SETTINGS" == false ] ; then
 
     #introsort ignored at this time because it is implemented as std_sort
-    SORTS=( sequential_timsort null std_sort std_stable_sort  tvs_timsort )
-    #deque omitted because it is slower and seems to be a little unstable
+    SORTS=( sequential_timsort null std_sort std_stable_sort block_merge_sort dual_pivot_quicksort pdqsort simd_introsort tvs_timsort gfx_powersort tvs_powersort heapsort radix_sort auto )
+    #deque omitted because it is slower and seems to be a little unstable; add it
+    #to compare the '<sort>_segmented' runs with the generic ones
     CONTAINERS=( vector )
     ORDERINGS=( random_order median_of_three_killer sorted )
     LENGTHS=( )
@@ -39,6 +43,83 @@ then
       LENGTHS+=( $(( 2**i )) )
     done
 
+    #Parallel sorts are run once per thread count, from 1 up to the number of
+    #hardware threads, and reported as '<sort>_j<threads>' so the speedup curve
+    #can be read off of the same plots.
+    PARALLEL_SORTS=( parallel_introsort parallel_timsort parallel_samplesort )
+    THREAD_COUNTS=( )
+    for (( i = 1 ; i <= $(nproc) ; i *= 2 )) ; do
+      THREAD_COUNTS+=( "$i" )
+    done
+
+    #Sorts whose merges can use another merge kernel are also run once per
+    #kernel, and reported as '<sort>_m<kernel>' next to the default 'gallop'.
+    MERGE_KERNEL_SORTS=( tvs_timsort tvs_powersort )
+    MERGE_KERNELS=( branchless simd )
+
+    #Sorts that can sort short ranges another way are also run once per way,
+    #reported as '<sort>_s<small sort>' next to the default 'insertion'.  With
+    #--verify the timsorts are also checked to stay stable with each.
+    SMALL_SORT_SORTS=( introsort simd_introsort gfx_timsort tvs_timsort gfx_powersort tvs_powersort )
+    SMALL_SORTS=( network static_network )
+
+    #Same for the way the runs left at the end are merged, reported as
+    #'<sort>_f<final merge>' next to the default 'binary'.
+    FINAL_MERGE_SORTS=( tvs_timsort )
+    FINAL_MERGES=( multiway )
+
+    #Sorts whose merges can prefetch are also run with --prefetch, reported as
+    #'<sort>_prefetch'.
+    PREFETCH_SORTS=( gfx_timsort tvs_timsort )
+
+    #Sorts also run with --segmented, reported as '<sort>_segmented'.  On a
+    #deque this moves it into a buffer, sorts that through pointers and moves
+    #it back, to compare with the generic runs; on a vector it only sorts
+    #through pointers.
+    SEGMENTED_SORTS=( introsort pdqsort tvs_timsort )
+
+    #Sorts also run with their data and merge buffers in 4 KiB and in 2 MiB
+    #pages, reported as '<sort>_pg<page size>', to compare with --perf-counters.
+    PAGE_SIZE_SORTS=( introsort gfx_timsort tvs_timsort )
+    PAGE_SIZES=( 4k 2m )
+
+    #Sorts that can keep their scratch buffers between calls are also run with
+    #--warm-scratch, reported as '<sort>_warm', printing the first and warm call.
+    WARM_SCRATCH_SORTS=( gfx_timsort tvs_timsort )
+
+    #Selection algorithms are run in --mode select for the median, reported as
+    #'select_<type>', and in --mode partial once per K, reported as
+    #'partial_<type>_k<K>'.
+    SELECT_TYPES=( heap_select introselect floyd_rivest simd_quickselect sort_truncate )
+    PARTIAL_KS=( 10 1000 )
+
+    #The append workload starts from the length, sorted, and appends a batch
+    #and sorts again APPEND_ROUNDS times, reported as 'append_<sort>_b<batch>'
+    #when the sort sorts everything and 'append_merge_<sort>_b<batch>' when it
+    #sorts only the batch and merges it in.
+    APPEND_SORTS=( std_sort tvs_timsort )
+    APPEND_BATCHES=( 16 1024 )
+    APPEND_ROUNDS=16
+
+    #Sorting by a key that takes some rounds of hashing to compute, reported as
+    #'project_<sort>_c<rounds>' when the sort computes the keys in every
+    #comparison and 'decorate_<sort>_c<rounds>' when they are computed once up
+    #front.
+    KEY_COST_SORTS=( std_sort tvs_timsort radix_sort )
+    KEY_COSTS=( 1 16 )
+
+    #The distributed sort is run once per process count, with these sorts for
+    #the local sort, and reported as 'distributed_<sort>_p<processes>'.
+    DISTRIBUTED_SORTS=( std_sort )
+    PROCESS_COUNTS=( "${THREAD_COUNTS[@]}" )
+
+    #The length is also sorted as independent arrays of each of these lengths,
+    #reported as 'small_arrays_<sort>_u<array length>', and for the sorts with a
+    #batch entry point also as 'small_arrays_batch_<sort>_u<array length>'.
+    SMALL_ARRAY_SORTS=( introsort static_network tvs_timsort )
+    BATCH_ENTRY_SORTS=( static_network tvs_timsort )
+    ARRAY_LENGTHS=( 8 16 32 64 256 )
+
     #While developing use 2, else 7
     NUM_TRIALS=7
 
@@ -50,16 +131,55 @@ then
     #TEST_TIME=true
     #TEST_CALLGRIND=false
     #TEST_PERF=false
+    #TEST_COMPARISONS=true
   else
 
     #introsort ignored at this time because it is implemented as std_sort
-    SORTS=( null std_sort std_stable_sort sequential_timsort gfx_timsort tvs_timsort )
+    SORTS=( null std_sort std_stable_sort block_merge_sort sequential_timsort gfx_timsort tvs_timsort )
     #deque omitted because it is slower and seems to be a little unstable
     CONTAINERS=( vector )
     ORDERINGS=( sorted random_order median_of_three_killer )
 
     LENGTHS=( 512 )
 
+    PARALLEL_SORTS=( parallel_introsort )
+    THREAD_COUNTS=( 1 2 )
+
+    MERGE_KERNEL_SORTS=( tvs_timsort )
+    MERGE_KERNELS=( simd )
+
+    SMALL_SORT_SORTS=( tvs_timsort )
+    SMALL_SORTS=( static_network )
+
+    FINAL_MERGE_SORTS=( tvs_timsort )
+    FINAL_MERGES=( multiway )
+
+    PREFETCH_SORTS=( tvs_timsort )
+
+    SEGMENTED_SORTS=( introsort )
+
+    PAGE_SIZE_SORTS=( tvs_timsort )
+    PAGE_SIZES=( 4k 2m )
+
+    WARM_SCRATCH_SORTS=( tvs_timsort )
+
+    SELECT_TYPES=( introselect floyd_rivest )
+    PARTIAL_KS=( 10 )
+
+    APPEND_SORTS=( tvs_timsort )
+    APPEND_BATCHES=( 16 )
+    APPEND_ROUNDS=4
+
+    KEY_COST_SORTS=( std_sort )
+    KEY_COSTS=( 16 )
+
+    DISTRIBUTED_SORTS=( std_sort )
+    PROCESS_COUNTS=( 2 )
+
+    SMALL_ARRAY_SORTS=( static_network )
+    BATCH_ENTRY_SORTS=( static_network )
+    ARRAY_LENGTHS=( 16 )
+
     NUM_TRIALS=2
 
     #TEST_ITERATOR_METRICS=false
@@ -67,13 +187,170 @@ then
     TEST_TIME=true
     TEST_CALLGRIND=false
     #TEST_PERF=false
+    TEST_COMPARISONS=false
   fi
 
 
+  for SORT in "${PARALLEL_SORTS[@]}" ; do
+    for THREADS in "${THREAD_COUNTS[@]}" ; do
+      SORTS+=( "$SORT""_j""$THREADS" )
+    done
+  done
+
+  for SORT in "${MERGE_KERNEL_SORTS[@]}" ; do
+    for KERNEL in "${MERGE_KERNELS[@]}" ; do
+      SORTS+=( "$SORT""_m""$KERNEL" )
+    done
+  done
+
+  for SORT in "${SMALL_SORT_SORTS[@]}" ; do
+    for SMALL_SORT in "${SMALL_SORTS[@]}" ; do
+      SORTS+=( "$SORT""_s""$SMALL_SORT" )
+    done
+  done
+
+  for SORT in "${FINAL_MERGE_SORTS[@]}" ; do
+    for FINAL_MERGE in "${FINAL_MERGES[@]}" ; do
+      SORTS+=( "$SORT""_f""$FINAL_MERGE" )
+    done
+  done
+
+  for SORT in "${PREFETCH_SORTS[@]}" ; do
+    SORTS+=( "$SORT""_prefetch" )
+  done
+
+  for SORT in "${SEGMENTED_SORTS[@]}" ; do
+    SORTS+=( "$SORT""_segmented" )
+  done
+
+  for SORT in "${PAGE_SIZE_SORTS[@]}" ; do
+    for PAGE_SIZE in "${PAGE_SIZES[@]}" ; do
+      SORTS+=( "$SORT""_pg""$PAGE_SIZE" )
+    done
+  done
+
+  for SORT in "${WARM_SCRATCH_SORTS[@]}" ; do
+    SORTS+=( "$SORT""_warm" )
+  done
+
+
+  for SELECT in "${SELECT_TYPES[@]}" ; do
+    SORTS+=( "select_$SELECT" )
+    for K in "${PARTIAL_KS[@]}" ; do
+      SORTS+=( "partial_$SELECT""_k""$K" )
+    done
+  done
+
+  for SORT in "${APPEND_SORTS[@]}" ; do
+    for BATCH in "${APPEND_BATCHES[@]}" ; do
+      SORTS+=( "append_$SORT""_b""$BATCH" "append_merge_$SORT""_b""$BATCH" )
+    done
+  done
+
+  for SORT in "${KEY_COST_SORTS[@]}" ; do
+    for COST in "${KEY_COSTS[@]}" ; do
+      SORTS+=( "project_$SORT""_c""$COST" "decorate_$SORT""_c""$COST" )
+    done
+  done
+
+  for SORT in "${DISTRIBUTED_SORTS[@]}" ; do
+    for PROCESSES in "${PROCESS_COUNTS[@]}" ; do
+      SORTS+=( "distributed_$SORT""_p""$PROCESSES" )
+    done
+  done
+
+  for SORT in "${SMALL_ARRAY_SORTS[@]}" ; do
+    for ARRAY_LENGTH in "${ARRAY_LENGTHS[@]}" ; do
+      SORTS+=( "small_arrays_$SORT""_u""$ARRAY_LENGTH" )
+    done
+  done
+
+  for SORT in "${BATCH_ENTRY_SORTS[@]}" ; do
+    for ARRAY_LENGTH in "${ARRAY_LENGTHS[@]}" ; do
+      SORTS+=( "small_arrays_batch_$SORT""_u""$ARRAY_LENGTH" )
+    done
+  done
+
+
   ALREADY_SETUP=true
 
 fi
 
+#$1=sort name as listed in SORTS
+#Prints the SCP arguments selecting that sort, splitting a '_j<threads>' suffix
+#off into the thread count, a '_m<kernel>' suffix into the merge kernel, a
+#'_s<small sort>' suffix into the small sort and a '_f<final merge>' suffix into
+#the final merge, a '_prefetch' suffix into
+#--prefetch, a '_segmented' suffix into --segmented, a '_pg<page size>'
+#suffix into --pages and a '_warm' suffix into --warm-scratch.  'select_<type>' and
+#'partial_<type>_k<K>' select instead of sorting, 'append_<sort>_b<batch>'
+#and 'append_merge_<sort>_b<batch>' run the append workload, and
+#'project_<sort>_c<rounds>' and 'decorate_<sort>_c<rounds>' sort by a costly
+#key, 'distributed_<sort>_p<processes>' runs the distributed sort, and
+#'small_arrays_<sort>_u<array length>' sorts independent small arrays, through
+#the sort's batch entry point with 'small_arrays_batch_<sort>_u<array length>'.
+function sort_arguments {
+  if [[ "$1" =~ ^small_arrays_batch_(.*)_u([0-9]+)$ ]] ; then
+    echo "--mode=small_arrays --batch-entry --sort-type=${BASH_REMATCH[1]} --array-length=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^small_arrays_(.*)_u([0-9]+)$ ]] ; then
+    echo "--mode=small_arrays --sort-type=${BASH_REMATCH[1]} --array-length=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^distributed_(.*)_p([0-9]+)$ ]] ; then
+    echo "--mode=distributed --sort-type=${BASH_REMATCH[1]} --processes=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^(project|decorate)_(.*)_c([0-9]+)$ ]] ; then
+    echo "--mode=${BASH_REMATCH[1]} --sort-type=${BASH_REMATCH[2]} --key-cost=${BASH_REMATCH[3]}"
+  elif [[ "$1" =~ ^append_merge_(.*)_b([0-9]+)$ ]] ; then
+    echo "--mode=append_merge --sort-type=${BASH_REMATCH[1]} --batch=${BASH_REMATCH[2]} --rounds=$APPEND_ROUNDS"
+  elif [[ "$1" =~ ^append_(.*)_b([0-9]+)$ ]] ; then
+    echo "--mode=append --sort-type=${BASH_REMATCH[1]} --batch=${BASH_REMATCH[2]} --rounds=$APPEND_ROUNDS"
+  elif [[ "$1" =~ ^select_(.*)$ ]] ; then
+    echo "--mode=select --select-type=${BASH_REMATCH[1]}"
+  elif [[ "$1" =~ ^partial_(.*)_k([0-9]+)$ ]] ; then
+    echo "--mode=partial --select-type=${BASH_REMATCH[1]} --k=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^(.*)_j([0-9]+)$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --threads=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^(.*)_m(gallop|branchless|simd)$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --merge-kernel=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^(.*)_s(insertion|network|static_network)$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --small-sort=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^(.*)_prefetch$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --prefetch"
+  elif [[ "$1" =~ ^(.*)_segmented$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --segmented"
+  elif [[ "$1" =~ ^(.*)_pg(4k|2m|hugetlbfs)$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --pages=${BASH_REMATCH[2]}"
+  elif [[ "$1" =~ ^(.*)_warm$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --warm-scratch"
+  elif [[ "$1" =~ ^(.*)_f(binary|multiway)$ ]] ; then
+    echo "--sort-type=${BASH_REMATCH[1]} --final-merge=${BASH_REMATCH[2]}"
+  else
+    echo "--sort-type=$1"
+  fi
+}
+
+#$1=sort name as listed in SORTS
+#Succeeds if SCP can count the comparisons the sort makes.  sequential_timsort
+#takes no comparator, so it can't, radix_sort makes none, and the distributed
+#sort makes them in other processes.
+function counts_comparisons {
+  [[ "$1" != *sequential_timsort* && "$1" != *radix_sort* && "$1" != distributed_* ]]
+}
+
+#$1=sort name as listed in SORTS
+#Succeeds if the sort's result can be verified: 'null' doesn't sort.
+function verifies {
+  [[ "$1" != null ]]
+}
+
+#$1=sort name as listed in SORTS
+#$2=length
+#Succeeds if the sort can run on that many elements; a partial sort needs at
+#least K.
+function runs_at_length {
+  if [[ "$1" =~ ^partial_.*_k([0-9]+)$ ]] ; then
+    [ "${BASH_REMATCH[1]}" -le "$2" ]
+  fi
+}
+
 #$1=path to data
 #$2=title
 #$3=x axis label
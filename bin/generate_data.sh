@@ -1,6 +1,7 @@
 #!/bin/bash
 # shellcheck disable=SC1091
 # shellcheck disable=SC2153
+# shellcheck disable=SC2046
 
 #Some code pulled from:
 #https://stackoverflow.com/questions/16959337/usr-bin-time-format-output-elapsed-time-in-milliseconds
@@ -48,6 +49,15 @@ fi
 if [ "$TEST_PERF" == true ] ; then
   echo "Testing using perf"
 fi
+if [ "$TEST_COMPARISONS" == true ] ; then
+  echo "Testing number of comparisons"
+fi
+if [ "$TEST_VERIFY" == true ] ; then
+  echo "Verifying results"
+fi
+if [ "$TEST_SCRATCH" == true ] ; then
+  echo "Testing scratch memory"
+fi
 
     TEST_TIME=true
 
@@ -99,6 +109,14 @@ for SORT in "${SORTS[@]}" ; do
         PERF_PATH="data/cpudata/$TESTING_PATH"
         mkdir -p "$PERF_PATH"
       fi
+      if [ "$TEST_COMPARISONS" == true ] && counts_comparisons "$SORT" ; then
+        CMP_PATH="data/cmpdata/$TESTING_PATH"
+        mkdir -p "$CMP_PATH"
+      fi
+      if [ "$TEST_SCRATCH" == true ] ; then
+        SCRATCH_PATH="data/scratchdata/$TESTING_PATH"
+        mkdir -p "$SCRATCH_PATH"
+      fi
     done
   done
 done
@@ -111,6 +129,7 @@ for SORT in "${SORTS[@]}" ; do
   for CONTAINER in "${CONTAINERS[@]}" ; do
     for ORDERING in "${ORDERINGS[@]}" ; do
       for LENGTH in "${LENGTHS[@]}" ; do
+        runs_at_length "$SORT" "$LENGTH" || continue
         echo "Running test for sort '$SORT' on data type '$CONTAINER' with $ORDERING elements of length $LENGTH "
         echo -n "Trial: "
         TESTING_PATH="$CONTAINER/$ORDERING/$SORT"
@@ -120,7 +139,7 @@ for SORT in "${SORTS[@]}" ; do
             #TODO: this one can actually be more appropriately split up more.
             echo -n '.'
             CPU_AND_MEM_PATH="data/rundata/$TESTING_PATH"
-            /usr/bin/time -f '%P\t%M' -o "$CPU_AND_MEM_PATH/$LENGTH.tsv" -a ./SCP --container="$CONTAINER" --length="$LENGTH" --sort-type="$SORT" --test="$ORDERING"
+            /usr/bin/time -f '%P\t%M' -o "$CPU_AND_MEM_PATH/$LENGTH.tsv" -a ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING"
           fi
           if [ "$TEST_TIME" == true ] ; then
             echo -n '.'
@@ -128,7 +147,7 @@ for SORT in "${SORTS[@]}" ; do
             mkdir -p "$TIME_PATH"
             touch "$TIME_PATH/$LENGTH.tsv"
             ts=$(date +%s%N)
-            ./SCP --container="$CONTAINER" --length="$LENGTH" --sort-type="$SORT" --test="$ORDERING"
+            ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING"
             echo $(($(date +%s%N) - ts)) >> "$TIME_PATH/$LENGTH.tsv"
           fi
           if [ "$TEST_PERF" == true ] ; then
@@ -137,7 +156,7 @@ for SORT in "${SORTS[@]}" ; do
             PERF_PATH="data/ipc/$TESTING_PATH"
             mkdir -p "$PERF_PATH"
             touch "$PERF_PATH/$LENGTH.tsv"
-            perf stat -o /tmp/perf_tmp.txt -B ./SCP --container="$CONTAINER" --length="$LENGTH" --sort-type="$SORT" --test="$ORDERING"
+            perf stat -o /tmp/perf_tmp.txt -B ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING"
             cat /tmp/perf_tmp.txt | grep -o -e '[0-9]\+\.[0-9]\+[ ]\+insn per cycle' | grep -o -e "[0-9]\+\.[0-9]\+" >> "$PERF_PATH/$LENGTH.tsv"
             #rm -f /tmp/perf_tmp.txt
             #echo "" >> "$PERF_PATH/$LENGTH.tsv"
@@ -149,7 +168,24 @@ for SORT in "${SORTS[@]}" ; do
         if [ "$TEST_CALLGRIND" == true ] ; then
           echo -n '.'
           CPU_PATH="data/cpudata/$TESTING_PATH"
-          valgrind --tool=cachegrind --cachegrind-out-file=/dev/null ./SCP --container="$CONTAINER" --length="$LENGTH" --sort-type="$SORT" --test="$ORDERING" 2>> "$CPU_PATH/$LENGTH.tsv"
+          valgrind --tool=cachegrind --cachegrind-out-file=/dev/null ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING" 2>> "$CPU_PATH/$LENGTH.tsv"
+        fi
+        #Comparison counts only depend on the data, so one run is enough.
+        if [ "$TEST_COMPARISONS" == true ] && counts_comparisons "$SORT" ; then
+          echo -n '.'
+          CMP_PATH="data/cmpdata/$TESTING_PATH"
+          ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING" --count-comparisons | grep -o -e '^comparisons: [0-9]\+' | grep -o -e '[0-9]\+' > "$CMP_PATH/$LENGTH.tsv"
+        fi
+        #So is the memory the sort allocates.
+        if [ "$TEST_SCRATCH" == true ] ; then
+          echo -n '.'
+          SCRATCH_PATH="data/scratchdata/$TESTING_PATH"
+          ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING" --scratch-bytes | grep -o -e '^scratch bytes: [0-9]\+' | grep -o -e '[0-9]\+' > "$SCRATCH_PATH/$LENGTH.tsv"
+        fi
+        #So is whether the result is right.
+        if [ "$TEST_VERIFY" == true ] && verifies "$SORT" ; then
+          echo -n '.'
+          ./SCP --container="$CONTAINER" --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING" --verify > /dev/null || echo -n " failed verification "
         fi
         echo "done!"
       done
@@ -75,6 +75,14 @@ for SORT in "${SORTS[@]}" ; do
           PERF_PATH="data/ipc/$TESTING_PATH/points.dat"
           printf 'LENGTH\t%s\n' "$SORT" > "$PERF_PATH"
         fi
+        if [ "$TEST_COMPARISONS" == true ] && counts_comparisons "$SORT" ; then
+          CMP_PATH="data/cmpdata/$TESTING_PATH/points.dat"
+          printf 'LENGTH\t%s\n' "$SORT" > "$CMP_PATH"
+        fi
+        if [ "$TEST_SCRATCH" == true ] ; then
+          SCRATCH_PATH="data/scratchdata/$TESTING_PATH/points.dat"
+          printf 'LENGTH\t%s\n' "$SORT" > "$SCRATCH_PATH"
+        fi
       done
   done
 done
@@ -92,6 +100,7 @@ for SORT in "${SORTS[@]}" ; do
     for ORDERING in "${ORDERINGS[@]}" ; do
       TESTING_PATH="$CONTAINER/$ORDERING/$SORT"
       for LENGTH in "${LENGTHS[@]}" ; do
+        runs_at_length "$SORT" "$LENGTH" || continue
 
         if [ "$TEST_ITERATOR_METRICS" == true ] ; then
           #$ITR_PATH="data/itrdata/$SORT/$CONTAINER/$ORDERING/$LENGTH.tsv"
@@ -127,6 +136,16 @@ for SORT in "${SORTS[@]}" ; do
           IPC_MEDIAN="$(median "$(awk '{print $1}' "$INPUT_PATH" )" )"
           printf '%d\t%.4f\n' "$LENGTH" "$IPC_MEDIAN" >> "$OUTPUT_PATH"
         fi
+        if [ "$TEST_COMPARISONS" == true ] && counts_comparisons "$SORT" ; then
+          INPUT_PATH="data/cmpdata/$TESTING_PATH/$LENGTH.tsv"
+          OUTPUT_PATH="data/cmpdata/$TESTING_PATH/points.dat"
+          printf '%d\t%d\n' "$LENGTH" "$(cat "$INPUT_PATH")" >> "$OUTPUT_PATH"
+        fi
+        if [ "$TEST_SCRATCH" == true ] ; then
+          INPUT_PATH="data/scratchdata/$TESTING_PATH/$LENGTH.tsv"
+          OUTPUT_PATH="data/scratchdata/$TESTING_PATH/points.dat"
+          printf '%d\t%d\n' "$LENGTH" "$(cat "$INPUT_PATH")" >> "$OUTPUT_PATH"
+        fi
       done
     done
   done
@@ -145,6 +164,8 @@ for CONTAINER in "${CONTAINERS[@]}" ; do
     MEM_PATH=()
     CACHE_PATH=()
     IPC_PATH=()
+    CMP_PATH=()
+    SCRATCH_PATH=()
 
     # Build up paths of files
     for SORT in "${SORTS[@]}" ; do
@@ -165,6 +186,12 @@ for CONTAINER in "${CONTAINERS[@]}" ; do
       if [ "$TEST_PERF" == true ] ; then
         IPC_PATH+=("data/ipc/$TESTING_PATH/points.dat")
       fi
+      if [ "$TEST_COMPARISONS" == true ] && counts_comparisons "$SORT" ; then
+        CMP_PATH+=("data/cmpdata/$TESTING_PATH/points.dat")
+      fi
+      if [ "$TEST_SCRATCH" == true ] ; then
+        SCRATCH_PATH+=("data/scratchdata/$TESTING_PATH/points.dat")
+      fi
     done
 
     # merge files of interest
@@ -229,6 +256,24 @@ for CONTAINER in "${CONTAINERS[@]}" ; do
       SAVE_PATH="IPC_$ORDERING""_""$CONTAINER.eps"
       plot_wrapper "$DATA_PATH" "$TITLE" "$XLABEL" "$YLABEL" "$SAVE_PATH"
     fi
+    if [ "$TEST_COMPARISONS" == true ] ; then
+      DATA_PATH="data/cmpdata/$COMPILED_TESTS_PATH/compiled_points.dat"
+      recursive_join "${CMP_PATH[@]}" > "$DATA_PATH"
+      TITLE="Comparisons per sort on $ORDERING data in a $CONTAINER"
+      XLABEL="Number of Elements"
+      YLABEL="Number of Comparisons"
+      SAVE_PATH="comparisons_$ORDERING""_""$CONTAINER.eps"
+      plot_wrapper "$DATA_PATH" "$TITLE" "$XLABEL" "$YLABEL" "$SAVE_PATH"
+    fi
+    if [ "$TEST_SCRATCH" == true ] ; then
+      DATA_PATH="data/scratchdata/$COMPILED_TESTS_PATH/compiled_points.dat"
+      recursive_join "${SCRATCH_PATH[@]}" > "$DATA_PATH"
+      TITLE="Scratch memory per sort on $ORDERING data in a $CONTAINER"
+      XLABEL="Number of Elements"
+      YLABEL="Bytes Allocated"
+      SAVE_PATH="scratch_$ORDERING""_""$CONTAINER.eps"
+      plot_wrapper "$DATA_PATH" "$TITLE" "$XLABEL" "$YLABEL" "$SAVE_PATH"
+    fi
   done
 done
 echo "done"
@@ -0,0 +1,121 @@
+#!/bin/bash
+# shellcheck disable=SC1091
+# shellcheck disable=SC2046
+
+#Fits the cost models the 'auto' sort chooses with, see
+#../include/auto_sort.hpp, to this machine.
+#
+#Each engine 'auto' picks from is timed the way generate_data.sh times sorts,
+#on random and on sorted vectors, into the same data/timedata tree; timings
+#already there are reused.  From the median times, less the 'null' sort's
+#median for the same input, the models are solved for:
+#
+#  introsort           seconds per element and level of log2(n), on random
+#  tvs_timsort          seconds per element on sorted input, a single run, and
+#                       per level of log2(n/32) merges on random input
+#  radix_sort           seconds per element and per pass, from random input,
+#                       8 passes, and sorted input, one pass per byte of n
+#
+#Each constant is the median over the lengths tried.  They are written to
+#../include/auto_sort_model.hpp, after which SCP has to be rebuilt.
+
+source functions.sh
+
+TRAIN_SORTS=( null introsort tvs_timsort radix_sort )
+TRAIN_ORDERINGS=( random_order sorted )
+TRAIN_LENGTHS=( )
+for i in 19 20 21 22 23 ; do
+  TRAIN_LENGTHS+=( $(( 2**i )) )
+done
+MODEL="../include/auto_sort_model.hpp"
+
+#$1=path to a file of one number per line
+function median {
+  sort -n "$1" | awk '{ v[NR] = $1 }
+    END { print (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+for SORT in "${TRAIN_SORTS[@]}" ; do
+  for ORDERING in "${TRAIN_ORDERINGS[@]}" ; do
+    for LENGTH in "${TRAIN_LENGTHS[@]}" ; do
+      TIME_PATH="data/timedata/vector/$ORDERING/$SORT"
+      mkdir -p "$TIME_PATH"
+      touch "$TIME_PATH/$LENGTH.tsv"
+      echo -n "Timing '$SORT' on $ORDERING elements of length $LENGTH "
+      while [ "$(wc -l < "$TIME_PATH/$LENGTH.tsv")" -lt "$NUM_TRIALS" ] ; do
+        echo -n '.'
+        ts=$(date +%s%N)
+        ./SCP --container=vector --length="$LENGTH" $(sort_arguments "$SORT") --test="$ORDERING"
+        echo $(($(date +%s%N) - ts)) >> "$TIME_PATH/$LENGTH.tsv"
+      done
+      echo "done!"
+    done
+  done
+done
+
+#The licence block, as in the header the models are for.
+head -n 21 ../include/auto_sort.hpp > "$MODEL"
+echo "" >> "$MODEL"
+
+for SORT in "${TRAIN_SORTS[@]}" ; do
+  for ORDERING in "${TRAIN_ORDERINGS[@]}" ; do
+    for LENGTH in "${TRAIN_LENGTHS[@]}" ; do
+      echo "$SORT $ORDERING $LENGTH $(median "data/timedata/vector/$ORDERING/$SORT/$LENGTH.tsv")"
+    done
+  done
+done | awk -v model="$MODEL" '
+  function median(list,    v, n, i, j, t) {
+    n = split(list, v, " ")
+    for (i = 2; i <= n; i++)
+      for (j = i; j > 1 && v[j - 1] > v[j]; j--) {
+        t = v[j]; v[j] = v[j - 1]; v[j - 1] = t
+      }
+    return (n % 2) ? v[(n + 1) / 2] : (v[n / 2] + v[n / 2 + 1]) / 2
+  }
+  function log2(x) { return log(x) / log(2) }
+  function positive(x) { return x > 0 ? x : 0 }
+
+  { ns[$1, $2, $3] = $4 ; lengths[$3] = 1 }
+
+  END {
+    for (n in lengths) {
+      for (s in ns) {
+        split(s, key, SUBSEP)
+        if (key[3] == n)
+          t[key[1], key[2]] = (ns[s] - ns["null", key[2], n]) * 1e-9 / n
+      }
+      intro = intro " " t["introsort", "random_order"] / log2(n)
+      tim_element = tim_element " " t["tvs_timsort", "sorted"]
+      tim_level = tim_level " " (t["tvs_timsort", "random_order"] - t["tvs_timsort", "sorted"]) / log2(n / 32)
+      sorted_passes = int((log2(n) + 7) / 8)
+      pass = (t["radix_sort", "random_order"] - t["radix_sort", "sorted"]) / (8 - sorted_passes)
+      radix_pass = radix_pass " " pass
+      radix_element = radix_element " " t["radix_sort", "sorted"] - pass * sorted_passes
+    }
+
+    print "/*******************************************************************************" >> model
+    print "Generated by bin/train_auto_sort.sh; rerun it to fit these to another machine." >> model
+    print "Seconds per element, from the timings of vector<long int>." >> model
+    print "Heapsort isn't a candidate, see auto_sort.hpp, so it has no model." >> model
+    print "*******************************************************************************/" >> model
+    print "" >> model
+    print "#pragma once" >> model
+    print "" >> model
+    print "" >> model
+    print "namespace SCP{" >> model
+    print "namespace autosort{" >> model
+    print "namespace model{" >> model
+    print "" >> model
+    printf "inline constexpr double introsort_per_level = %.3e;\n", positive(median(intro)) >> model
+    printf "inline constexpr double timsort_per_element = %.3e;\n", positive(median(tim_element)) >> model
+    printf "inline constexpr double timsort_per_level = %.3e;\n", positive(median(tim_level)) >> model
+    printf "inline constexpr double radix_per_element = %.3e;\n", positive(median(radix_element)) >> model
+    printf "inline constexpr double radix_per_pass = %.3e;\n", positive(median(radix_pass)) >> model
+    print "" >> model
+    print "};" >> model
+    print "};" >> model
+    print "};" >> model
+  }'
+
+echo "Wrote $MODEL:"
+cat "$MODEL"
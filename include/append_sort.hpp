@@ -0,0 +1,152 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+
+/*******************************************************************************
+@brief Re-sorting a range that was sorted before a batch was appended to it.
+
+sort_appended() is told where the sorted prefix ends, so it only sorts the
+appended tail, with whichever sort it is handed, and merges the two in one
+pass.  A sort given the whole range instead has to find the prefix again:
+timsort's run detection takes a comparison per element of it, and sorts that
+don't look for runs at all do the whole O(n log n) again.
+
+The merge moves the tail out to a buffer and fills the range from the back.
+For each tail element, from the greatest, the prefix elements greater than it
+are found by galloping back from the end of what is left of the prefix, then
+moved up in one block.  For a tail of b elements that is O(b log(n / b))
+comparisons, and the prefix is only moved as far as there are tail elements
+below it; tail elements no less than the whole prefix cost a comparison each.
+Equal elements of the prefix stay ahead of those of the tail, so it is stable
+if the tail's sort is.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+
+namespace SCP{
+
+/// Returns the first element of [__first, __last) greater than __value,
+/// expecting it to be near __last: steps of 1, 3, 7, ... elements back from
+/// __last bound it before the binary search, so it takes O(log d) comparisons
+/// for a distance d from the end.
+template<
+  typename _RandomAccessIterator,
+  typename _Tp,
+  typename _Compare>
+_RandomAccessIterator
+gallop_upper_bound_from_back(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  const _Tp &__value,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::difference_type
+    _Distance;
+  const _Distance __len = __last - __first;
+  _Distance __last_ofs = 0;
+  _Distance __ofs = 1;
+  while(__ofs <= __len && __comp(__value, *(__last - __ofs))){
+    __last_ofs = __ofs;
+    __ofs = 2 * __ofs + 1;
+  }
+  if(__ofs > __len)
+    __ofs = __len;
+  return std::upper_bound(__last - __ofs, __last - __last_ofs, __value, __comp);
+}
+
+
+/// Merges the sorted [__first, __middle) and [__middle, __last), buffering
+/// the latter, which is expected to be the shorter.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+merge_appended(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __middle,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  if(__first == __middle || __middle == __last
+     || !__comp(*__middle, *(__middle - 1)))
+    return;
+
+  std::vector<_ValueType> __buffer(std::make_move_iterator(__middle),
+                                   std::make_move_iterator(__last));
+  auto __buffer_last = __buffer.end();
+  _RandomAccessIterator __prefix_last = __middle;
+  _RandomAccessIterator __out = __last;
+  while(__buffer_last != __buffer.begin() && __prefix_last != __first){
+    const _RandomAccessIterator __greater = gallop_upper_bound_from_back(
+      __first, __prefix_last, *(__buffer_last - 1), __comp);
+    __out = std::move_backward(__greater, __prefix_last, __out);
+    __prefix_last = __greater;
+    *--__out = std::move(*--__buffer_last);
+  }
+  std::move_backward(__buffer.begin(), __buffer_last, __out);
+}
+
+
+/// Sorts [__first, __last), of which [__first, __middle) is already sorted,
+/// by sorting [__middle, __last) with __sort and merging it in.
+template<
+  typename _RandomAccessIterator,
+  typename _Sort,
+  typename _Compare>
+void
+sort_appended(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __middle,
+  _RandomAccessIterator __last,
+  _Sort __sort,
+  _Compare __comp
+){
+  __sort(__middle, __last);
+  merge_appended(__first, __middle, __last, __comp);
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Sort>
+void
+sort_appended(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __middle,
+  _RandomAccessIterator __last,
+  _Sort __sort
+){
+  sort_appended(__first, __middle, __last, __sort, std::less<>());
+}
+
+};
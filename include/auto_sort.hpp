@@ -0,0 +1,413 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+/*******************************************************************************
+@brief A sort that takes a small sample of its input first, and from that picks
+introsort, timsort or radix sort to do the actual sorting.
+
+The probe looks at:
+
+ * Runs: a few dozen short windows at random positions are scanned for runs the
+   way timsort finds them, ascending or strictly descending, giving the number
+   of run boundaries per adjacent pair.  Runs too long for the windows to see
+   their ends are caught by a point sample taken at evenly spaced positions:
+   the sample, read in order, can't have more runs than the input.
+ * Inversions: the fraction of pairs of the point sample that are out of order,
+   counted while merge sorting it.  0 for sorted input, 1/2 for random input,
+   1 for reversed input.
+ * Duplicates: the fraction of the sorted point sample equal to its
+   predecessor.
+ * Key range: for integer keys, the number of bits spanned by the smallest and
+   largest key of the point sample, which sets the passes radix sort needs.
+
+Each engine has a cost model in seconds per element, and the engine with the
+lowest predicted cost is run.  The constants of the models live in
+auto_sort_model.hpp, and are fitted to SCP's own timings on the machine at hand
+by bin/train_auto_sort.sh; see there for what is measured.  Inversions and
+duplicates are reported, but carry no weight in the models: over the training
+data none of the engines' times depended on them beyond what the run count and
+key range already tell.
+
+Heapsort isn't a candidate.  Its cost per level of log2(n) came out more than
+twice introsort's, and introsort already falls back to heapsort where it would
+go quadratic, so there was no input where it could be picked.
+
+What the probe found, what it chose and how long the probe and the sort took
+are kept in last_decision for reporting.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ostream>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "auto_sort_model.hpp"
+#include "introsort.hpp"
+#include "other_timsorts.hpp"
+#include "radix_sort.hpp"
+
+
+namespace SCP{
+namespace autosort{
+
+/// The sorts auto_sort() picks from.
+enum class engine { introsort, timsort, radix_sort };
+
+/// Inputs shorter than this are left to introsort without probing.
+enum { min_probe_length = 1 << 14 };
+
+/// Windows scanned for runs, their length, and the size of the point sample.
+enum { probe_windows = 32, probe_window_length = 32, probe_points = 256 };
+
+
+/// The sort type name of an engine, as given to --sort-type.
+inline
+const char *
+engine_name(
+  engine __e
+){
+  switch(__e){
+    case engine::introsort:  return "introsort";
+    case engine::timsort:    return "tvs_timsort";
+    case engine::radix_sort: return "radix_sort";
+  }
+  return "";
+}
+
+
+struct probe_result{
+  double runs            = 1;  ///< Estimated number of timsort runs.
+  double inversion_ratio = 0;  ///< Out of order pairs over all pairs.
+  double duplicate_ratio = 0;  ///< Repeated keys over sampled keys.
+  double key_bits        = -1; ///< Bits of the key range, -1 if not integers.
+};
+
+
+struct decision{
+  bool          probed        = false;
+  probe_result  probe;
+  engine        chosen        = engine::introsort;
+  double        probe_seconds = 0;
+  double        sort_seconds  = 0;
+
+  void
+  report(
+    std::ostream &out
+  ) const {
+    out << "probe seconds: " << probe_seconds << '\n'
+        << "sort seconds: " << sort_seconds << '\n'
+        << "chosen sort: " << engine_name(chosen) << '\n';
+    if(!probed)
+      return;
+    out << "estimated runs: " << probe.runs << '\n'
+        << "inversion ratio: " << probe.inversion_ratio << '\n'
+        << "duplicate ratio: " << probe.duplicate_ratio << '\n';
+    if(probe.key_bits >= 0)
+      out << "key bits: " << probe.key_bits << '\n';
+  }
+};
+
+/// What the last auto_sort() call found and did.
+inline decision last_decision;
+
+
+/// The number of places [__first, __last) breaks into a new run, where a run
+/// is ascending or strictly descending, as timsort finds them.
+template<
+  typename _Iterator,
+  typename _Compare>
+std::size_t
+run_boundaries(
+  _Iterator __it,
+  const _Iterator __end,
+  _Compare &__comp
+){
+  std::size_t __boundaries = 0;
+  if(__it == __end)
+    return 0;
+  while(++__it != __end){
+    if(__comp(*__it, *(__it - 1))){
+      while(++__it != __end && __comp(*__it, *(__it - 1))) {}
+    }else{
+      while(++__it != __end && !__comp(*__it, *(__it - 1))) {}
+    }
+    if(__it == __end)
+      break;
+    ++__boundaries;
+  }
+  return __boundaries;
+}
+
+
+/// Merge sorts [__first, __last) using __buffer, which is at least as long,
+/// and returns the number of inverted pairs.
+template<
+  typename _Tp,
+  typename _Compare>
+std::size_t
+sort_counting_inversions(
+  _Tp *__first,
+  _Tp *__last,
+  _Tp *__buffer,
+  _Compare &__comp
+){
+  const std::size_t __len = __last - __first;
+  if(__len < 2)
+    return 0;
+  _Tp *__middle = __first + __len / 2;
+  std::size_t __inversions =
+      sort_counting_inversions(__first, __middle, __buffer, __comp)
+    + sort_counting_inversions(__middle, __last, __buffer, __comp);
+
+  _Tp *__left = __first, *__right = __middle, *__out = __buffer;
+  while(__left != __middle && __right != __last){
+    if(__comp(*__right, *__left)){
+      __inversions += __middle - __left;
+      *__out++ = *__right++;
+    }else{
+      *__out++ = *__left++;
+    }
+  }
+  __out = std::copy(__left, __middle, __out);
+  std::copy(__buffer, __out, __first);
+  return __inversions;
+}
+
+
+/// Bits needed for the distance between the unsigned keys __low and __high.
+template<
+  typename _Tp>
+double
+key_range_bits(
+  const _Tp &__low,
+  const _Tp &__high
+){
+  if constexpr(std::is_integral<_Tp>::value){
+    auto __range = radix_key(__high) - radix_key(__low);
+    double __bits = 0;
+    for(; __range != 0; __range >>= 1)
+      ++__bits;
+    return __bits;
+  }else{
+    return -1;
+  }
+}
+
+
+/**
+*  @brief Estimate how presorted [__first, __last) is from a sample of it.
+*
+*  Reads probe_windows * probe_window_length + probe_points elements,
+*  whatever the length of the range, which should be a good deal more than
+*  that.  The positions are drawn from a fixed seed, so the same input always
+*  gives the same estimate.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+probe_result
+probe(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type _Tp;
+  const std::size_t __len = __last - __first;
+  probe_result __result;
+  std::minstd_rand __rng(__len);
+
+  // Runs inside the windows.
+  std::size_t __boundaries = 0;
+  std::uniform_int_distribution<std::size_t>
+      __start_dist(0, __len - probe_window_length);
+  for(int __w = 0; __w < probe_windows; ++__w){
+    const _RandomAccessIterator __start = __first + __start_dist(__rng);
+    __boundaries += run_boundaries(__start, __start + probe_window_length,
+                                   __comp);
+  }
+  const double __density = double(__boundaries)
+                         / (probe_windows * (probe_window_length - 1));
+
+  // The point sample, at evenly spaced positions with a random offset.
+  std::vector<_Tp> __sample, __buffer(probe_points);
+  __sample.reserve(probe_points);
+  const std::size_t __stride = __len / probe_points;
+  std::size_t __position = std::uniform_int_distribution<std::size_t>(
+                               0, __stride - 1)(__rng);
+  for(int __i = 0; __i < probe_points; ++__i, __position += __stride)
+    __sample.push_back(*(__first + __position));
+  const std::size_t __sample_boundaries =
+      run_boundaries(__sample.begin(), __sample.end(), __comp);
+  __result.runs = std::max(1 + __density * (__len - 1),
+                           1.0 + __sample_boundaries);
+
+  const std::size_t __inversions = sort_counting_inversions(
+      __sample.data(), __sample.data() + probe_points, __buffer.data(), __comp);
+  __result.inversion_ratio = double(__inversions)
+                           / (probe_points * (probe_points - 1) / 2);
+
+  std::size_t __duplicates = 0;
+  for(int __i = 1; __i < probe_points; ++__i)
+    if(!__comp(__sample[__i - 1], __sample[__i]))
+      ++__duplicates;
+  __result.duplicate_ratio = double(__duplicates) / probe_points;
+
+  __result.key_bits = key_range_bits(__sample.front(), __sample.back());
+  return __result;
+}
+
+
+/// Predicted seconds per element of sorting __len elements with __e.
+inline
+double
+predicted_cost(
+  engine __e,
+  const probe_result &__probe,
+  std::size_t __len
+){
+  const double __levels = std::log2(double(__len));
+  switch(__e){
+    case engine::introsort:
+      return model::introsort_per_level * __levels;
+    case engine::timsort: {
+      // Runs shorter than the minimum run length are extended to it by
+      // insertion sort, so there are never many more than __len / 32.
+      const double __runs = std::min(__probe.runs, __len / 32.0);
+      return model::timsort_per_element
+           + model::timsort_per_level * std::log2(std::max(__runs, 1.0));
+    }
+    case engine::radix_sort: {
+      const double __passes = std::max(std::ceil(__probe.key_bits / 8), 1.0);
+      return model::radix_per_element + model::radix_per_pass * __passes;
+    }
+  }
+  return 0;
+}
+
+
+/// The engine with the lowest predicted_cost(); radix_sort only if
+/// __radix_allowed.
+inline
+engine
+choose(
+  const probe_result &__probe,
+  std::size_t __len,
+  bool __radix_allowed
+){
+  engine __best = engine::introsort;
+  double __best_cost = predicted_cost(__best, __probe, __len);
+  for(engine __e : {engine::timsort, engine::radix_sort}){
+    if(__e == engine::radix_sort && !__radix_allowed)
+      continue;
+    const double __cost = predicted_cost(__e, __probe, __len);
+    if(__cost < __best_cost){
+      __best = __e;
+      __best_cost = __cost;
+    }
+  }
+  return __best;
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+auto_sort_impl(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp,
+  bool __radix_allowed
+){
+  typedef std::chrono::steady_clock clock;
+  const std::size_t __len = __last - __first;
+  decision &__d = last_decision;
+  __d = decision();
+
+  const clock::time_point __start = clock::now();
+  if(__len >= min_probe_length){
+    __d.probed = true;
+    __d.probe = probe(__first, __last, __comp);
+    __d.chosen = choose(__d.probe, __len, __radix_allowed);
+  }
+  const clock::time_point __probed = clock::now();
+
+  switch(__d.chosen){
+    case engine::introsort:  SCP::introsort(__first, __last, __comp); break;
+    case engine::timsort:    tim::timsort(__first, __last, __comp);   break;
+    case engine::radix_sort:
+      if constexpr(std::is_integral<typename std::iterator_traits<
+                       _RandomAccessIterator>::value_type>::value)
+        SCP::radix_sort(__first, __last);
+      break;
+  }
+  const clock::time_point __sorted = clock::now();
+
+  __d.probe_seconds = std::chrono::duration<double>(__probed - __start).count();
+  __d.sort_seconds = std::chrono::duration<double>(__sorted - __probed).count();
+}
+
+
+/**
+*  @brief Sort the elements of a sequence with whichever engine the probe
+*  predicts is fastest for it.
+*
+*  Integer keys may go to radix_sort, which the overload taking a comparator
+*  never picks.  Not stable, as introsort may be picked.
+*/
+template<
+  typename _RandomAccessIterator>
+void
+auto_sort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type _Tp;
+  auto_sort_impl(__first, __last, std::less<_Tp>(),
+                 std::is_integral<_Tp>::value);
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+auto_sort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  auto_sort_impl(__first, __last, __comp, false);
+}
+
+};
+};
@@ -0,0 +1,44 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+/*******************************************************************************
+Generated by bin/train_auto_sort.sh; rerun it to fit these to another machine.
+Seconds per element, from the timings of vector<long int>.
+Heapsort isn't a candidate, see auto_sort.hpp, so it has no model.
+*******************************************************************************/
+
+#pragma once
+
+
+namespace SCP{
+namespace autosort{
+namespace model{
+
+inline constexpr double introsort_per_level = 6.974e-09;
+inline constexpr double timsort_per_element = 1.633e-09;
+inline constexpr double timsort_per_level = 1.608e-08;
+inline constexpr double radix_per_element = 5.641e-08;
+inline constexpr double radix_per_pass = 6.204e-09;
+
+};
+};
+};
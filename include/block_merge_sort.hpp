@@ -0,0 +1,900 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+/*******************************************************************************
+@brief A stable merge sort in O(1) extra memory: a block merge sort, after
+Kim and Kutzner's "Ratio Based Stable In-Place Merging" as laid out in Mike
+McFadden's WikiSort.
+
+The sort is bottom-up.  Ranges of 4 to 7 elements are insertion sorted, then
+merged level by level, with ranges split evenly, so that every level merges
+ranges differing in length by at most one.  While the ranges are small, merges
+go through a fixed cache of cache_elements elements.  Beyond that, each level
+merges A and B in place:
+
+ * About 2 sqrt(|A|) distinct values are pulled out of the array, to the
+   front of an A or the back of a B, into two internal buffers.  Pulling out
+   the first of each run of equal values in the order they occur keeps the
+   sort stable.
+ * A is cut into blocks of sqrt(|A|) elements, and the first element of each
+   block is swapped with one of the first buffer, tagging the block with a
+   value that keeps the blocks' order recoverable.
+ * The A blocks are rolled through B a block at a time.  Whenever the smallest
+   remaining A block belongs before the next B block, it is dropped there,
+   and the previous A block is merged with the B values that followed it.
+   That merge uses the cache if the block fits there.  Otherwise it swaps
+   through the second internal buffer, which needs no extra memory since the
+   buffer's contents only have to be kept, not their order.
+ * At the end of the level the second buffer is insertion sorted, and both
+   buffers are merged back into the array where they came from.
+
+If there are too few distinct values for the buffers, merges fall back to
+binary searches and rotations, which is still O(n log n) comparisons, but the
+data moves more.
+
+The cache is the only memory used on top of the data, cache_elements elements
+whatever the length.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+
+namespace SCP{
+namespace blocksort{
+
+/// Elements in the cache, which bounds the memory used on top of the data.
+enum { cache_elements = 512 };
+
+
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+class block_merge_engine{
+public:
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type diff_t;
+
+
+  block_merge_engine(
+    RandomAccessIterator array_,
+    diff_t size_,
+    Compare comp_
+  ) : array(array_), size(size_), comp(comp_),
+      cache(std::min<diff_t>(size_, cache_elements)),
+      cache_size(cache.size()) {}
+
+
+  void
+  sort(
+  ){
+    if(size < 4){
+      insertion_sort(range(0, size));
+      return;
+    }
+
+    level_iterator it(size, 4);
+    while(!it.finished())
+      insertion_sort(it.next_range());
+    if(size < 8)
+      return;
+
+    do{
+      if(it.length() < cache_size)
+        merge_level_cached(it);
+      else
+        merge_level_in_place(it);
+    }while(it.next_level());
+  }
+
+
+private:
+  struct range{
+    diff_t start, end;
+
+    range() : start(0), end(0) {}
+    range(diff_t start_, diff_t end_) : start(start_), end(end_) {}
+    diff_t length() const { return end - start; }
+  };
+
+
+  /// Steps through a level's ranges, splitting size into 2^k ranges whose
+  /// lengths differ by at most one, for the smallest k leaving them shorter
+  /// than twice min_level.
+  class level_iterator{
+  public:
+    level_iterator(
+      diff_t size_,
+      diff_t min_level
+    ) : size(size_) {
+      diff_t power_of_two = 1;
+      while(power_of_two * 2 <= size)
+        power_of_two *= 2;
+      denominator = power_of_two / min_level;
+      numerator_step = size % denominator;
+      decimal_step = size / denominator;
+      begin();
+    }
+
+    void begin() { numerator = decimal = 0; }
+
+    range
+    next_range(
+    ){
+      diff_t start = decimal;
+      decimal += decimal_step;
+      numerator += numerator_step;
+      if(numerator >= denominator){
+        numerator -= denominator;
+        ++decimal;
+      }
+      return range(start, decimal);
+    }
+
+    bool finished() const { return decimal >= size; }
+
+    bool
+    next_level(
+    ){
+      decimal_step += decimal_step;
+      numerator_step += numerator_step;
+      if(numerator_step >= denominator){
+        numerator_step -= denominator;
+        ++decimal_step;
+      }
+      return decimal_step < size;
+    }
+
+    diff_t length() const { return decimal_step; }
+
+  private:
+    diff_t size, decimal, numerator, denominator, decimal_step, numerator_step;
+  };
+
+
+  /// Where one of the internal buffers is pulled out to and from.
+  struct pull_info{
+    diff_t from = 0, to = 0, count = 0;
+    range span;
+  };
+
+
+  RandomAccessIterator array;
+  diff_t size;
+  Compare comp;
+  std::vector<T> cache;
+  diff_t cache_size;
+
+
+  T& at(diff_t i) { return array[i]; }
+  bool less(diff_t a, diff_t b) { return comp(array[a], array[b]); }
+
+
+  void
+  insertion_sort(
+    range r
+  ){
+    for(diff_t i = r.start + 1; i < r.end; ++i){
+      T value = std::move(at(i));
+      diff_t j = i;
+      for(; j > r.start && comp(value, at(j - 1)); --j)
+        at(j) = std::move(at(j - 1));
+      at(j) = std::move(value);
+    }
+  }
+
+
+  /// The first index in r whose element is not less than value.
+  diff_t
+  binary_first(
+    const T &value,
+    range r
+  ){
+    return std::lower_bound(array + r.start, array + r.end, value, comp) - array;
+  }
+
+
+  /// The first index in r whose element is greater than value.
+  diff_t
+  binary_last(
+    const T &value,
+    range r
+  ){
+    return std::upper_bound(array + r.start, array + r.end, value, comp) - array;
+  }
+
+
+  // The find_* functions search r for value in steps of about
+  // r.length() / unique, then binary search the last step: faster than a
+  // binary search over r when value is expected among the first few of
+  // 'unique' roughly evenly spread distinct values.
+
+  diff_t
+  find_first_forward(
+    const T &value,
+    range r,
+    diff_t unique
+  ){
+    if(r.length() == 0)
+      return r.start;
+    diff_t skip = std::max<diff_t>(r.length() / unique, 1);
+    diff_t index;
+    for(index = r.start + skip; comp(at(index - 1), value); index += skip)
+      if(index >= r.end - skip)
+        return binary_first(value, range(index, r.end));
+    return binary_first(value, range(index - skip, index));
+  }
+
+
+  diff_t
+  find_last_forward(
+    const T &value,
+    range r,
+    diff_t unique
+  ){
+    if(r.length() == 0)
+      return r.start;
+    diff_t skip = std::max<diff_t>(r.length() / unique, 1);
+    diff_t index;
+    for(index = r.start + skip; !comp(value, at(index - 1)); index += skip)
+      if(index >= r.end - skip)
+        return binary_last(value, range(index, r.end));
+    return binary_last(value, range(index - skip, index));
+  }
+
+
+  diff_t
+  find_first_backward(
+    const T &value,
+    range r,
+    diff_t unique
+  ){
+    if(r.length() == 0)
+      return r.start;
+    diff_t skip = std::max<diff_t>(r.length() / unique, 1);
+    diff_t index;
+    for(index = r.end - skip; index > r.start && !comp(at(index - 1), value); index -= skip)
+      if(index < r.start + skip)
+        return binary_first(value, range(r.start, index));
+    return binary_first(value, range(index, index + skip));
+  }
+
+
+  diff_t
+  find_last_backward(
+    const T &value,
+    range r,
+    diff_t unique
+  ){
+    if(r.length() == 0)
+      return r.start;
+    diff_t skip = std::max<diff_t>(r.length() / unique, 1);
+    diff_t index;
+    for(index = r.end - skip; index > r.start && comp(value, at(index - 1)); index -= skip)
+      if(index < r.start + skip)
+        return binary_last(value, range(r.start, index));
+    return binary_last(value, range(index, index + skip));
+  }
+
+
+  void
+  block_swap(
+    diff_t start1,
+    diff_t start2,
+    diff_t block_size
+  ){
+    std::swap_ranges(array + start1, array + start1 + block_size, array + start2);
+  }
+
+
+  /// Rotates r left by amount, or right by -amount if it is negative, through
+  /// the cache if the shorter side fits in use_cache elements of it.
+  void
+  rotate(
+    diff_t amount,
+    range r,
+    diff_t use_cache
+  ){
+    if(r.length() == 0)
+      return;
+    const diff_t split = amount >= 0 ? r.start + amount : r.end + amount;
+    const range r1(r.start, split), r2(split, r.end);
+    if(r1.length() <= r2.length()){
+      if(r1.length() <= use_cache){
+        std::move(array + r1.start, array + r1.end, cache.begin());
+        std::move(array + r2.start, array + r2.end, array + r.start);
+        std::move(cache.begin(), cache.begin() + r1.length(),
+                  array + r.start + r2.length());
+        return;
+      }
+    }else if(r2.length() <= use_cache){
+      std::move(array + r2.start, array + r2.end, cache.begin());
+      std::move_backward(array + r1.start, array + r1.end, array + r.end);
+      std::move(cache.begin(), cache.begin() + r2.length(), array + r.start);
+      return;
+    }
+    std::rotate(array + r1.start, array + r2.start, array + r2.end);
+  }
+
+
+  /// Merges the adjacent sorted ranges a and b of from into into.
+  template<
+    typename From,
+    typename Into>
+  void
+  merge_into(
+    From from,
+    range a,
+    range b,
+    Into into
+  ){
+    From a_index = from + a.start, a_last = from + a.end;
+    From b_index = from + b.start, b_last = from + b.end;
+    while(true){
+      if(!comp(*b_index, *a_index)){
+        *into++ = std::move(*a_index++);
+        if(a_index == a_last){
+          std::move(b_index, b_last, into);
+          return;
+        }
+      }else{
+        *into++ = std::move(*b_index++);
+        if(b_index == b_last){
+          std::move(a_index, a_last, into);
+          return;
+        }
+      }
+    }
+  }
+
+
+  /// Merges a, whose contents are at the front of the cache, with b.
+  void
+  merge_external(
+    range a,
+    range b
+  ){
+    auto a_index = cache.begin(), a_last = cache.begin() + a.length();
+    RandomAccessIterator b_index = array + b.start, b_last = array + b.end;
+    RandomAccessIterator insert = array + a.start;
+    if(b.length() > 0 && a.length() > 0){
+      while(true){
+        if(!comp(*b_index, *a_index)){
+          *insert++ = std::move(*a_index++);
+          if(a_index == a_last)
+            break;
+        }else{
+          *insert++ = std::move(*b_index++);
+          if(b_index == b_last)
+            break;
+        }
+      }
+    }
+    std::move(a_index, a_last, insert);
+  }
+
+
+  /// Merges a, whose contents are in buffer, with b, swapping every element
+  /// into place so the buffer's contents are kept, out of order.
+  void
+  merge_internal(
+    range a,
+    range b,
+    range buffer
+  ){
+    diff_t a_count = 0, b_count = 0, insert = 0;
+    if(b.length() > 0 && a.length() > 0){
+      while(true){
+        if(!less(b.start + b_count, buffer.start + a_count)){
+          std::iter_swap(array + a.start + insert, array + buffer.start + a_count);
+          ++a_count;
+          ++insert;
+          if(a_count >= a.length())
+            break;
+        }else{
+          std::iter_swap(array + a.start + insert, array + b.start + b_count);
+          ++b_count;
+          ++insert;
+          if(b_count >= b.length())
+            break;
+        }
+      }
+    }
+    block_swap(buffer.start + a_count, a.start + insert, a.length() - a_count);
+  }
+
+
+  /// Merges a and b with binary searches and rotations, with no buffer.
+  void
+  merge_in_place(
+    range a,
+    range b
+  ){
+    if(a.length() == 0 || b.length() == 0)
+      return;
+    while(true){
+      // Insert the front of a where it belongs in b, and what follows it in a
+      // up to the next larger value along with it.
+      const diff_t mid = binary_first(at(a.start), b);
+      const diff_t amount = mid - a.end;
+      rotate(-amount, range(a.start, mid), cache_size);
+      if(b.end == mid)
+        break;
+      b.start = mid;
+      a = range(a.start + amount, b.start);
+      a.start = binary_last(at(a.start), a);
+      if(a.length() == 0)
+        break;
+    }
+  }
+
+
+  /// Moves a range's contents to out, merging them if they aren't in order.
+  template<
+    typename From,
+    typename Into>
+  void
+  merge_or_copy(
+    From from,
+    range a,
+    range b,
+    Into out
+  ){
+    if(comp(from[b.end - 1], from[a.start])){
+      std::move(from + a.start, from + a.end, out + b.length());
+      std::move(from + b.start, from + b.end, out);
+    }else if(comp(from[b.start], from[a.end - 1])){
+      merge_into(from, a, b, out);
+    }else{
+      std::move(from + a.start, from + a.end, out);
+      std::move(from + b.start, from + b.end, out + a.length());
+    }
+  }
+
+
+  /// Merges a level whose ranges fit in the cache, two levels at once if four
+  /// ranges do.
+  void
+  merge_level_cached(
+    level_iterator &it
+  ){
+    it.begin();
+    if((it.length() + 1) * 4 <= cache_size && it.length() * 4 <= size){
+      while(!it.finished()){
+        range a1 = it.next_range(), b1 = it.next_range();
+        range a2 = it.next_range(), b2 = it.next_range();
+        if(!comp(at(b1.start), at(a1.end - 1)) && !comp(at(b2.start), at(a2.end - 1))
+           && !comp(at(a2.start), at(b1.end - 1)))
+          continue;
+        merge_or_copy(array, a1, b1, cache.begin());
+        a1 = range(a1.start, b1.end);
+        merge_or_copy(array, a2, b2, cache.begin() + a1.length());
+        a2 = range(a2.start, b2.end);
+        const range a3(0, a1.length()), b3(a1.length(), a1.length() + a2.length());
+        merge_or_copy(cache.begin(), a3, b3, array + a1.start);
+      }
+      it.next_level();
+    }else{
+      while(!it.finished()){
+        range a = it.next_range(), b = it.next_range();
+        if(comp(at(b.end - 1), at(a.start))){
+          rotate(a.length(), range(a.start, b.end), cache_size);
+        }else if(comp(at(b.start), at(a.end - 1))){
+          std::move(array + a.start, array + a.end, cache.begin());
+          merge_external(a, b);
+        }
+      }
+    }
+  }
+
+
+  /// Finds up to 'find' distinct values at the front of a, or the back of b,
+  /// and records them in pull[pull_index] and the buffers if there are
+  /// enough.  Returns true once no more buffers need to be found.
+  bool
+  find_buffer(
+    range a,
+    range b,
+    bool from_a,
+    diff_t &find,
+    diff_t buffer_size,
+    diff_t block_size,
+    bool &find_separately,
+    pull_info *pull,
+    int &pull_index,
+    range &buffer1,
+    range &buffer2
+  ){
+    diff_t last, count, index = 0;
+    if(from_a){
+      for(last = a.start, count = 1; count < find; last = index, ++count){
+        index = find_last_forward(at(last), range(last + 1, a.end), find - count);
+        if(index == a.end)
+          break;
+      }
+    }else{
+      for(last = b.end - 1, count = 1; count < find; last = index - 1, ++count){
+        index = find_first_backward(at(last), range(b.start, last), find - count);
+        if(index == b.start)
+          break;
+      }
+    }
+    index = last;
+    // The values found, at the front of a or the back of b.
+    const range found = from_a ? range(a.start, a.start + count)
+                               : range(b.end - count, b.end);
+
+    if(count >= buffer_size){
+      pull[pull_index].span = range(a.start, b.end);
+      pull[pull_index].count = count;
+      pull[pull_index].from = index;
+      pull[pull_index].to = from_a ? a.start : b.end;
+      pull_index = 1;
+      if(count == buffer_size + buffer_size){
+        // Room for both buffers.
+        buffer1 = range(found.start, found.start + buffer_size);
+        buffer2 = range(found.start + buffer_size, found.end);
+        return true;
+      }else if(find == buffer_size + buffer_size){
+        // The first buffer, but the second has to be found elsewhere.
+        buffer1 = found;
+        find = buffer_size;
+        return false;
+      }else if(block_size <= cache_size){
+        // The cache does the second buffer's job.
+        buffer1 = found;
+        return true;
+      }else if(find_separately){
+        buffer1 = found;
+        find_separately = false;
+        return false;
+      }else{
+        // A second buffer pulled out of this b has to be left out of the
+        // first buffer's span, if that is of the same a.
+        if(!from_a && pull[0].span.start == a.start)
+          pull[0].span.end -= pull[1].count;
+        buffer2 = found;
+        return true;
+      }
+    }else if(pull_index == 0 && count > buffer1.length()){
+      // Keep the largest buffer found, in case none is large enough.
+      buffer1 = found;
+      pull[0].span = range(a.start, b.end);
+      pull[0].count = count;
+      pull[0].from = index;
+      pull[0].to = from_a ? a.start : b.end;
+    }
+    return false;
+  }
+
+
+  /// Merges a level in place, using internal buffers.
+  void
+  merge_level_in_place(
+    level_iterator &it
+  ){
+    diff_t block_size = std::sqrt(double(it.length()));
+    diff_t buffer_size = it.length() / block_size + 1;
+
+    // The internal buffers only need to be pulled out once per level.
+    range buffer1, buffer2;
+    pull_info pull[2];
+    int pull_index = 0;
+    diff_t find = buffer_size + buffer_size;
+    bool find_separately = false;
+    if(block_size <= cache_size){
+      // Every A block fits into the cache, so the second buffer isn't needed.
+      find = buffer_size;
+    }else if(find > it.length()){
+      // Both buffers won't fit in one range, so they are found separately.
+      find = buffer_size;
+      find_separately = true;
+    }
+
+    it.begin();
+    while(!it.finished()){
+      const range a = it.next_range(), b = it.next_range();
+      if(find_buffer(a, b, true, find, buffer_size, block_size, find_separately,
+                     pull, pull_index, buffer1, buffer2))
+        break;
+      if(find_buffer(a, b, false, find, buffer_size, block_size, find_separately,
+                     pull, pull_index, buffer1, buffer2))
+        break;
+    }
+
+    pull_out_buffers(pull);
+
+    // Adjust to the buffers there are.
+    buffer_size = buffer1.length();
+    block_size = it.length() / buffer_size + 1;
+
+    it.begin();
+    while(!it.finished()){
+      range a = it.next_range(), b = it.next_range();
+
+      // Leave out what the internal buffers took.
+      const diff_t start = a.start;
+      bool empty = false;
+      for(int p = 0; p < 2 && !empty; ++p){
+        if(start != pull[p].span.start)
+          continue;
+        if(pull[p].from > pull[p].to){
+          a.start += pull[p].count;
+          empty = a.length() == 0;
+        }else if(pull[p].from < pull[p].to){
+          b.end -= pull[p].count;
+          empty = b.length() == 0;
+        }
+      }
+      if(empty)
+        continue;
+
+      if(comp(at(b.end - 1), at(a.start))){
+        // In reverse order, so a rotation will do.
+        rotate(a.length(), range(a.start, b.end), cache_size);
+      }else if(comp(at(a.end), at(a.end - 1))){
+        merge_blocks(a, b, block_size, buffer1, buffer2);
+      }
+    }
+
+    // Sort the second buffer, which the merges jumbled, and put both buffers
+    // back where their values belong.
+    insertion_sort(buffer2);
+    redistribute_buffers(pull);
+  }
+
+
+  /// Moves the distinct values pull recorded to the front of an A, or the
+  /// back of a B, keeping everything else in order.
+  void
+  pull_out_buffers(
+    pull_info *pull
+  ){
+    for(int p = 0; p < 2; ++p){
+      const diff_t length = pull[p].count;
+      diff_t index;
+      if(pull[p].to < pull[p].from){
+        index = pull[p].from;
+        for(diff_t count = 1; count < length; ++count){
+          index = find_first_backward(at(index - 1),
+                                      range(pull[p].to, pull[p].from - (count - 1)),
+                                      length - count);
+          const range r(index + 1, pull[p].from + 1);
+          rotate(r.length() - count, r, cache_size);
+          pull[p].from = index + count;
+        }
+      }else if(pull[p].to > pull[p].from){
+        index = pull[p].from + 1;
+        for(diff_t count = 1; count < length; ++count){
+          index = find_last_forward(at(index), range(index, pull[p].to),
+                                    length - count);
+          const range r(pull[p].from, index - 1);
+          rotate(count, r, cache_size);
+          pull[p].from = index - 1 - count;
+        }
+      }
+    }
+  }
+
+
+  /// Merges the buffers back into the spans they were pulled out of.
+  void
+  redistribute_buffers(
+    pull_info *pull
+  ){
+    for(int p = 0; p < 2; ++p){
+      diff_t unique = pull[p].count * 2;
+      if(pull[p].from > pull[p].to){
+        range buffer(pull[p].span.start, pull[p].span.start + pull[p].count);
+        while(buffer.length() > 0){
+          const diff_t index = find_first_forward(
+              at(buffer.start), range(buffer.end, pull[p].span.end), unique);
+          const diff_t amount = index - buffer.end;
+          rotate(buffer.length(), range(buffer.start, index), cache_size);
+          buffer.start += amount + 1;
+          buffer.end += amount;
+          unique -= 2;
+        }
+      }else if(pull[p].from < pull[p].to){
+        range buffer(pull[p].span.end - pull[p].count, pull[p].span.end);
+        while(buffer.length() > 0){
+          const diff_t index = find_last_backward(
+              at(buffer.end - 1), range(pull[p].span.start, buffer.start), unique);
+          const diff_t amount = buffer.start - index;
+          rotate(amount, range(index, buffer.end), cache_size);
+          buffer.start -= amount;
+          buffer.end -= amount + 1;
+          unique -= 2;
+        }
+      }
+    }
+  }
+
+
+  /// Merges the previous A block with the B values after it, by the best
+  /// means available.
+  void
+  merge_block(
+    range a,
+    range b,
+    range buffer2
+  ){
+    if(a.length() <= cache_size)
+      merge_external(a, b);
+    else if(buffer2.length() > 0)
+      merge_internal(a, b, buffer2);
+    else
+      merge_in_place(a, b);
+  }
+
+
+  /// Merges a and b, which are out of order, by rolling a's blocks through b.
+  void
+  merge_blocks(
+    range a,
+    range b,
+    diff_t block_size,
+    range buffer1,
+    range buffer2
+  ){
+    // The uneven first block of a is left where it is.
+    range block_a(a.start, a.end);
+    const range first_a(a.start, a.start + block_a.length() % block_size);
+
+    // Tag each full block with a value of buffer1, by swapping its first
+    // element with it.
+    for(diff_t index_a = buffer1.start, index = first_a.end; index < block_a.end;
+        ++index_a, index += block_size)
+      std::iter_swap(array + index_a, array + index);
+
+    range last_a = first_a;
+    range last_b;
+    range block_b(b.start, b.start + std::min(block_size, b.length()));
+    block_a.start += first_a.length();
+    diff_t index_a = buffer1.start;
+
+    // The previous A block is kept in the cache or buffer2 for its merge.
+    if(last_a.length() <= cache_size)
+      std::move(array + last_a.start, array + last_a.end, cache.begin());
+    else if(buffer2.length() > 0)
+      block_swap(last_a.start, buffer2.start, last_a.length());
+
+    if(block_a.length() > 0){
+      while(true){
+        if((last_b.length() > 0 && !comp(at(last_b.end - 1), at(index_a)))
+           || block_b.length() == 0){
+          // Drop the smallest A block behind, splitting the previous B block
+          // where it belongs.
+          const diff_t b_split = binary_first(at(index_a), last_b);
+          const diff_t b_remaining = last_b.end - b_split;
+
+          diff_t min_a = block_a.start;
+          for(diff_t find_a = min_a + block_size; find_a < block_a.end; find_a += block_size)
+            if(less(find_a, min_a))
+              min_a = find_a;
+          block_swap(block_a.start, min_a, block_size);
+
+          // Untag it.
+          std::iter_swap(array + block_a.start, array + index_a);
+          ++index_a;
+
+          merge_block(last_a, range(last_a.end, b_split), buffer2);
+
+          if(buffer2.length() > 0 || block_size <= cache_size){
+            // Where the A block is going to be merged from anyway, and then
+            // what was in its place doesn't need its order kept, so B can be
+            // swapped in rather than rotated.
+            if(block_size <= cache_size)
+              std::move(array + block_a.start, array + block_a.start + block_size,
+                        cache.begin());
+            else
+              block_swap(block_a.start, buffer2.start, block_size);
+            block_swap(b_split, block_a.start + block_size - b_remaining, b_remaining);
+          }else{
+            rotate(block_a.start - b_split, range(b_split, block_a.start + block_size),
+                   cache_size);
+          }
+
+          last_a = range(block_a.start - b_remaining,
+                         block_a.start - b_remaining + block_size);
+          last_b = range(last_a.end, last_a.end + b_remaining);
+
+          block_a.start += block_size;
+          if(block_a.length() == 0)
+            break;
+        }else if(block_b.length() < block_size){
+          // Move the last, uneven, B block in front of the remaining A blocks.
+          // Not through the cache, which may hold the previous A block.
+          rotate(-block_b.length(), range(block_a.start, block_b.end), 0);
+          last_b = range(block_a.start, block_a.start + block_b.length());
+          block_a.start += block_b.length();
+          block_a.end += block_b.length();
+          block_b.end = block_b.start;
+        }else{
+          // Roll the leftmost A block to the end by swapping it with the next
+          // B block.
+          block_swap(block_a.start, block_b.start, block_size);
+          last_b = range(block_a.start, block_a.start + block_size);
+          block_a.start += block_size;
+          block_a.end += block_size;
+          block_b.start += block_size;
+          if(block_b.end > b.end - block_size)
+            block_b.end = b.end;
+          else
+            block_b.end += block_size;
+        }
+      }
+    }
+
+    merge_block(last_a, range(last_a.end, b.end), buffer2);
+  }
+};
+
+};
+
+
+/**
+*  @brief Sort the elements of a sequence, stably, in O(1) extra memory.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  The relative order of equivalent elements is preserved.  Uses a fixed
+*  cache of blocksort::cache_elements elements rather than a buffer
+*  proportional to the length.
+*/
+template<
+  typename RandomAccessIterator>
+void
+block_merge_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  blocksort::block_merge_engine<RandomAccessIterator, std::less<T> >(
+    first, last - first, std::less<T>()).sort();
+}
+
+
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+void
+block_merge_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  blocksort::block_merge_engine<RandomAccessIterator, Compare>(
+    first, last - first, comp).sort();
+}
+
+};
@@ -21,6 +21,7 @@ with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <random>
 
@@ -227,3 +228,67 @@ populate_container(
       exit(-3);
   };
 }
+
+
+/*Produces the same data as populate_container(), a chunk at a time, for sorts
+* that never hold all of it in memory.
+*/
+template<
+  typename T>
+class test_data_stream{
+public:
+  test_data_stream(
+    const struct config &args
+  ):
+    test(args.chosen_test),
+    length(args.test_length),
+    position(0),
+    rng(0)
+  {
+    if(test == median_of_three_killer and length % 2 != 0){
+      cout << "The 'median_of_three' requires an even length." << endl;
+      exit(EINVAL);
+    }
+    if(test != sorted and test != reverse_sorted and test != random_order
+       and test != median_of_three_killer)
+      exit(-3);
+  }
+
+  /*Stores up to 'max' more elements at 'out', and returns how many.  Returns 0
+  * once all 'length' elements were produced.
+  */
+  std::size_t
+  read(
+    T *out,
+    std::size_t max
+  ){
+    const ssize_t count = std::min<ssize_t>(max, length - position);
+    for(ssize_t i = position; i < position + count; i++){
+      switch(test){
+        case sorted:
+          *out++ = T(LONG_MIN + i);
+          break;
+        case reverse_sorted:
+          *out++ = T(LONG_MAX - i);
+          break;
+        case random_order:
+          *out++ = T(rng());
+          break;
+        default:
+          if(i < length/2)
+            *out++ = T(i % 2 == 0 ? i : (length/2)+(i-1));
+          else
+            *out++ = T((i-length) * 2);
+          break;
+      }
+    }
+    position += count;
+    return count;
+  }
+
+private:
+  sort_test_type test;
+  ssize_t length;
+  ssize_t position;
+  std::mt19937_64 rng;
+};
@@ -0,0 +1,157 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+
+/*******************************************************************************
+@brief Decorate-sort-undecorate, or the Schwartzian transform, for sorting by a
+key that is expensive to compute from an element.
+
+Sorting through a comparator that computes the keys computes two per
+comparison, so about 2 n log2(n) of them.  decorate_sort() computes each key
+once, into an array of (key, index) pairs, sorts that with the sort it is
+handed, and then moves the elements to where their index ended up, following
+the cycles of the permutation so that only one element is held aside at a
+time.  The pairs compare by key and then by index, so the result is stable
+whatever the sort, and small enough that sorting them moves less memory than
+sorting large elements would.
+
+The sort is called on iterators of a std::vector<decorated<Key> >, with their
+operator<.  Integer keys can also be radix sorted, through radix_key().
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "radix_sort.hpp"
+
+
+namespace SCP{
+
+/// An element's key, and where the element was before sorting.
+template<
+  typename _Key,
+  typename _Index = std::size_t>
+struct decorated{
+  _Key key;
+  _Index index;
+
+  bool
+  operator<(
+    const decorated &__other
+  ) const {
+    return key < __other.key
+       || (!(__other.key < key) && index < __other.index);
+  }
+};
+
+
+/// Radix sorts the pairs by their key alone; as the sort is stable and the
+/// pairs start out in index order, ties still end up in index order.
+template<
+  typename _Key,
+  typename _Index>
+inline
+auto
+radix_key(
+  const decorated<_Key, _Index> &__value
+) -> decltype(radix_key(__value.key)){
+  return radix_key(__value.key);
+}
+
+
+/// Moves *(__first + __order[i].index) to __first + i for every i, leaving
+/// every __order[i].index at i.
+template<
+  typename _RandomAccessIterator,
+  typename _Decorated>
+void
+apply_permutation(
+  _RandomAccessIterator __first,
+  std::vector<_Decorated> &__order
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  const std::size_t __len = __order.size();
+  for(std::size_t __i = 0; __i < __len; ++__i){
+    if(__order[__i].index == __i)
+      continue;
+    _ValueType __tmp = std::move(__first[__i]);
+    std::size_t __hole = __i;
+    while(__order[__hole].index != __i){
+      const std::size_t __next = __order[__hole].index;
+      __first[__hole] = std::move(__first[__next]);
+      __order[__hole].index = __hole;
+      __hole = __next;
+    }
+    __first[__hole] = std::move(__tmp);
+    __order[__hole].index = __hole;
+  }
+}
+
+
+/**
+*  @brief Sort the elements of a sequence by a projection of them.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __proj    Computes the key to sort an element by.
+*  @param  __sort    Sorts a range of decorated keys.
+*  @return  Nothing.
+*
+*  Sorts [__first, __last) stably by the keys __proj returns, calling it once
+*  per element.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Projection,
+  typename _Sort>
+void
+decorate_sort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Projection __proj,
+  _Sort __sort
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  typedef typename std::decay<
+    typename std::invoke_result<_Projection &, const _ValueType &>::type>::type
+    _Key;
+  const std::size_t __len = __last - __first;
+  if(__len < 2)
+    return;
+
+  std::vector<decorated<_Key> > __order;
+  __order.reserve(__len);
+  for(std::size_t __i = 0; __i < __len; ++__i)
+    __order.push_back(decorated<_Key>{__proj(__first[__i]), __i});
+  __sort(__order.begin(), __order.end());
+  apply_permutation(__first, __order);
+}
+
+};
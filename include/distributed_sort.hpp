@@ -0,0 +1,472 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+
+/*******************************************************************************
+@brief A distributed sample sort, by regular sampling, among processes on one
+machine, standing in for the nodes of a cluster.
+
+The data is copied into a POSIX shared memory segment and split evenly among P
+forked processes, and each then goes through these phases, separated by a
+barrier:
+
+ * Local sort: it sorts its share with the sort it is handed.
+ * Sampling: it takes P equally spaced elements of its sorted share.  The
+   first process sorts all P^2 of them and publishes every Pth as the P - 1
+   splitters, and each process then finds where they fall in its share.
+ * Exchange: each process sends the part of its share between splitters i - 1
+   and i to process i, through a bounded queue in the segment for every pair of
+   processes, and receives its own parts into memory of its own, as a node
+   would.  Queues are filled and drained in turns, so none of them blocks.
+ * Merge: it merges the P sorted parts it received with a loser tree, into its
+   place in the output.
+
+With regular sampling no process ends up with more than about twice its share
+of distinct keys; with many equal keys that bound doesn't hold.  The time of a
+phase is taken up to its barrier, so it is the time of the slowest process.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "multiway_merge.hpp"
+
+
+namespace SCP{
+namespace distributed{
+
+/// Most processes distributed_sort() runs, as each merges a part from every
+/// one of them in one pass.
+inline constexpr std::size_t max_processes = max_multiway_runs;
+
+/// Size of the queue from one process to another.
+inline constexpr std::size_t queue_bytes = std::size_t(1) << 16;
+
+enum phase{ local_sort_phase, sampling_phase, exchange_phase, merge_phase, phases };
+
+
+/// What distributed_sort() did, and how long it took.
+struct stats{
+  std::size_t processes = 0;
+  double local_sort_seconds = 0;
+  double sampling_seconds = 0;
+  double exchange_seconds = 0;
+  double merge_seconds = 0;
+  std::size_t bytes_exchanged = 0;
+  std::size_t largest_share = 0;
+
+  void
+  report(
+    std::ostream &out
+  ) const {
+    out << "processes: " << processes << std::endl;
+    out << "local sort seconds: " << local_sort_seconds << std::endl;
+    out << "sampling seconds: " << sampling_seconds << std::endl;
+    out << "exchange seconds: " << exchange_seconds << std::endl;
+    out << "merge seconds: " << merge_seconds << std::endl;
+    out << "bytes exchanged: " << bytes_exchanged << std::endl;
+    out << "largest share: " << largest_share << std::endl;
+  }
+};
+
+
+/// The start of the segment, through which the processes coordinate.
+struct control{
+  pthread_barrier_t barrier;
+  double seconds[max_processes][phases];
+  // counts[i][j] elements go from process i to process j
+  std::size_t counts[max_processes][max_processes];
+};
+
+
+/// The positions of a queue between two processes.  Only the sender moves the
+/// tail and only the receiver the head; the elements follow.
+struct alignas(64) queue_header{
+  alignas(64) std::atomic<std::size_t> head;
+  alignas(64) std::atomic<std::size_t> tail;
+};
+
+
+/// Where everything is in the segment, for P processes sorting n elements.
+template<
+  typename T>
+struct layout{
+  static std::size_t
+  align(
+    std::size_t offset
+  ){
+    return (offset + 63) & ~std::size_t(63);
+  }
+
+  layout(
+    std::size_t processes,
+    std::size_t length
+  ):
+    queue_capacity(std::max<std::size_t>(1, queue_bytes / sizeof(T)))
+  {
+    samples = align(sizeof(control));
+    splitters = align(samples + processes * processes * sizeof(T));
+    input = align(splitters + processes * sizeof(T));
+    output = align(input + length * sizeof(T));
+    queues = align(output + length * sizeof(T));
+    queue_stride = align(sizeof(queue_header) + queue_capacity * sizeof(T));
+    bytes = queues + processes * processes * queue_stride;
+  }
+
+  std::size_t queue_capacity;
+  std::size_t samples;
+  std::size_t splitters;
+  std::size_t input;
+  std::size_t output;
+  std::size_t queues;
+  std::size_t queue_stride;
+  std::size_t bytes;
+};
+
+
+/// Sends as much of [*first, last) as the queue has room for, advancing
+/// *first.  Returns whether anything was sent.
+template<
+  typename T>
+bool
+push(
+  queue_header &queue,
+  T *ring,
+  std::size_t capacity,
+  const T *&first,
+  const T *last
+){
+  const std::size_t tail = queue.tail.load(std::memory_order_relaxed);
+  const std::size_t head = queue.head.load(std::memory_order_acquire);
+  std::size_t count = std::min<std::size_t>(capacity - (tail - head), last - first);
+  if(count == 0)
+    return false;
+  const std::size_t at = tail % capacity;
+  const std::size_t before_wrap = std::min(count, capacity - at);
+  std::memcpy(ring + at, first, before_wrap * sizeof(T));
+  std::memcpy(ring, first + before_wrap, (count - before_wrap) * sizeof(T));
+  first += count;
+  queue.tail.store(tail + count, std::memory_order_release);
+  return true;
+}
+
+
+/// Receives whatever is in the queue, up to last, at *first, advancing it.
+/// Returns whether anything was received.
+template<
+  typename T>
+bool
+pop(
+  queue_header &queue,
+  const T *ring,
+  std::size_t capacity,
+  T *&first,
+  T *last
+){
+  const std::size_t head = queue.head.load(std::memory_order_relaxed);
+  const std::size_t tail = queue.tail.load(std::memory_order_acquire);
+  std::size_t count = std::min<std::size_t>(tail - head, last - first);
+  if(count == 0)
+    return false;
+  const std::size_t at = head % capacity;
+  const std::size_t before_wrap = std::min(count, capacity - at);
+  std::memcpy(first, ring + at, before_wrap * sizeof(T));
+  std::memcpy(first + before_wrap, ring, (count - before_wrap) * sizeof(T));
+  first += count;
+  queue.head.store(head + count, std::memory_order_release);
+  return true;
+}
+
+
+/// What process 'self' of 'processes' does, in a segment laid out as 'where'.
+template<
+  typename T,
+  typename Sort,
+  typename Compare>
+void
+worker(
+  char *segment,
+  const layout<T> &where,
+  std::size_t self,
+  std::size_t processes,
+  std::size_t length,
+  Sort &sort,
+  Compare comp
+){
+  typedef std::chrono::steady_clock clock;
+  control &shared = *reinterpret_cast<control*>(segment);
+  T *samples = reinterpret_cast<T*>(segment + where.samples);
+  T *splitters = reinterpret_cast<T*>(segment + where.splitters);
+  T *input = reinterpret_cast<T*>(segment + where.input);
+  T *output = reinterpret_cast<T*>(segment + where.output);
+  auto queue = [&](std::size_t from, std::size_t to) -> queue_header& {
+    return *reinterpret_cast<queue_header*>(
+      segment + where.queues + (from * processes + to) * where.queue_stride);
+  };
+  auto ring = [&](std::size_t from, std::size_t to){
+    return reinterpret_cast<T*>(&queue(from, to) + 1);
+  };
+  clock::time_point start = clock::now();
+  auto end_phase = [&](phase p){
+    pthread_barrier_wait(&shared.barrier);
+    const clock::time_point now = clock::now();
+    shared.seconds[self][p] = std::chrono::duration<double>(now - start).count();
+    start = now;
+  };
+
+  // LOCAL SORT
+  T *share = input + length * self / processes;
+  const std::size_t share_length = length * (self + 1) / processes
+                                 - length * self / processes;
+  sort(share, share + share_length);
+  end_phase(local_sort_phase);
+
+  // SAMPLING
+  // P regularly spaced samples from every share, or none from an empty one
+  if(share_length != 0)
+    for(std::size_t i = 0; i < processes; ++i)
+      samples[self * processes + i] = share[share_length * i / processes];
+  pthread_barrier_wait(&shared.barrier);
+  if(self == 0){
+    std::size_t count = 0;
+    for(std::size_t p = 0; p < processes; ++p){
+      const bool empty = length * (p + 1) / processes == length * p / processes;
+      if(!empty)
+        for(std::size_t i = 0; i < processes; ++i)
+          samples[count++] = samples[p * processes + i];
+    }
+    sort(samples, samples + count);
+    if(count != 0)
+      for(std::size_t i = 1; i < processes; ++i)
+        splitters[i - 1] = samples[count * i / processes];
+  }
+  pthread_barrier_wait(&shared.barrier);
+  std::size_t bounds[max_processes + 1];
+  bounds[0] = 0;
+  for(std::size_t i = 1; i < processes; ++i)
+    bounds[i] = std::upper_bound(share + bounds[i - 1], share + share_length,
+                                 splitters[i - 1], comp) - share;
+  bounds[processes] = share_length;
+  for(std::size_t to = 0; to < processes; ++to)
+    shared.counts[self][to] = bounds[to + 1] - bounds[to];
+  end_phase(sampling_phase);
+
+  // EXCHANGE
+  std::size_t received_bounds[max_processes + 1];
+  received_bounds[0] = 0;
+  for(std::size_t from = 0; from < processes; ++from)
+    received_bounds[from + 1] = received_bounds[from] + shared.counts[from][self];
+  std::vector<T> received(received_bounds[processes]);
+  const T *sending[max_processes];
+  T *receiving[max_processes];
+  for(std::size_t p = 0; p < processes; ++p){
+    sending[p] = share + bounds[p];
+    receiving[p] = received.data() + received_bounds[p];
+  }
+  // what stays with this process needs no queue
+  const T *const kept_end = share + bounds[self + 1];
+  receiving[self] = std::copy(sending[self], kept_end, receiving[self]);
+  sending[self] = kept_end;
+  for(;;){
+    bool progress = false;
+    bool done = true;
+    for(std::size_t p = 0; p < processes; ++p){
+      const T *send_end = share + bounds[p + 1];
+      T *receive_end = received.data() + received_bounds[p + 1];
+      if(sending[p] != send_end)
+        progress |= push(queue(self, p), ring(self, p), where.queue_capacity,
+                         sending[p], send_end);
+      if(receiving[p] != receive_end)
+        progress |= pop(queue(p, self), ring(p, self), where.queue_capacity,
+                        receiving[p], receive_end);
+      done = done && sending[p] == send_end && receiving[p] == receive_end;
+    }
+    if(done)
+      break;
+    if(!progress)
+      sched_yield();
+  }
+  end_phase(exchange_phase);
+
+  // MERGE
+  std::size_t output_offset = 0;
+  for(std::size_t p = 0; p < self; ++p)
+    for(std::size_t from = 0; from < processes; ++from)
+      output_offset += shared.counts[from][p];
+  loser_tree_merge(received.data(), received_bounds, processes,
+                   output + output_offset, comp);
+  end_phase(merge_phase);
+}
+
+
+/**
+ * Sorts [first, last) in ascending order by comp, with 'processes' forked
+ * processes as described above, each sorting its share with 'sort'.  Exits
+ * the program if the segment can't be set up or a process fails, killing the
+ * other processes first.
+ */
+template<
+  typename T,
+  typename Sort,
+  typename Compare = std::less<T> >
+stats
+distributed_sort(
+  T *first,
+  T *last,
+  Sort &&sort,
+  std::size_t processes,
+  Compare comp = Compare()
+){
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are copied between processes as they are in memory");
+  const std::size_t length = last - first;
+  processes = std::clamp<std::size_t>(processes, 1, max_processes);
+  stats counts;
+  counts.processes = processes;
+
+  const layout<T> where(processes, length);
+  const std::string name = "/SCP-" + std::to_string(::getpid());
+  const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if(fd < 0 || ::ftruncate(fd, where.bytes) != 0){
+    std::cout << "Can't create the shared memory segment " << name << ": "
+              << std::strerror(errno) << std::endl;
+    std::exit(errno);
+  }
+  void *mapping = ::mmap(nullptr, where.bytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+  ::shm_unlink(name.c_str());
+  ::close(fd);
+  if(mapping == MAP_FAILED){
+    std::cout << "Can't map the shared memory segment: "
+              << std::strerror(errno) << std::endl;
+    std::exit(errno);
+  }
+  char *segment = static_cast<char*>(mapping);
+
+  control &shared = *new(segment) control;
+  pthread_barrierattr_t attributes;
+  pthread_barrierattr_init(&attributes);
+  pthread_barrierattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&shared.barrier, &attributes, processes);
+  pthread_barrierattr_destroy(&attributes);
+  for(std::size_t from = 0; from < processes; ++from)
+    for(std::size_t to = 0; to < processes; ++to)
+      new(segment + where.queues + (from * processes + to) * where.queue_stride)
+        queue_header{{0}, {0}};
+  if(length != 0)
+    std::memcpy(segment + where.input, first, length * sizeof(T));
+
+  // stdout is flushed so that the processes don't inherit what is buffered
+  std::cout.flush();
+  std::vector<pid_t> children;
+  for(std::size_t self = 0; self < processes; ++self){
+    const pid_t child = ::fork();
+    if(child < 0){
+      std::cout << "Can't start a sort process: " << std::strerror(errno) << std::endl;
+      std::exit(errno);
+    }
+    if(child == 0){
+      worker(segment, where, self, processes, length, sort, comp);
+      ::_exit(0);
+    }
+    children.push_back(child);
+  }
+  // The processes are reaped in whatever order they exit.  One that dies
+  // leaves the others waiting for it at a barrier or a queue forever, so the
+  // first to fail takes the rest down with it.
+  for(std::size_t running = children.size(); running != 0; ){
+    int status;
+    const pid_t child = ::waitpid(-1, &status, 0);
+    if(child < 0){
+      if(errno == EINTR)
+        continue;
+      std::cout << "Can't wait for the sort processes: " << std::strerror(errno) << std::endl;
+      std::exit(errno);
+    }
+    const auto found = std::find(children.begin(), children.end(), child);
+    if(found == children.end())
+      continue;
+    *found = 0;
+    --running;
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+      continue;
+    if(WIFSIGNALED(status))
+      std::cout << "Sort process " << found - children.begin() << " was killed by signal "
+                << WTERMSIG(status) << " (" << ::strsignal(WTERMSIG(status)) << ")." << std::endl;
+    else
+      std::cout << "Sort process " << found - children.begin() << " exited with status "
+                << WEXITSTATUS(status) << "." << std::endl;
+    for(pid_t other : children)
+      if(other != 0)
+        ::kill(other, SIGKILL);
+    for(pid_t other : children)
+      if(other != 0)
+        while(::waitpid(other, &status, 0) < 0 && errno == EINTR);
+    std::cout << "A sort process failed." << std::endl;
+    std::exit(1);
+  }
+
+  if(length != 0)
+    std::memcpy(first, segment + where.output, length * sizeof(T));
+  for(std::size_t self = 0; self < processes; ++self){
+    counts.local_sort_seconds = std::max(counts.local_sort_seconds, shared.seconds[self][local_sort_phase]);
+    counts.sampling_seconds = std::max(counts.sampling_seconds, shared.seconds[self][sampling_phase]);
+    counts.exchange_seconds = std::max(counts.exchange_seconds, shared.seconds[self][exchange_phase]);
+    counts.merge_seconds = std::max(counts.merge_seconds, shared.seconds[self][merge_phase]);
+    std::size_t share = 0;
+    for(std::size_t from = 0; from < processes; ++from){
+      share += shared.counts[from][self];
+      if(from != self)
+        counts.bytes_exchanged += shared.counts[from][self] * sizeof(T);
+    }
+    counts.largest_share = std::max(counts.largest_share, share);
+  }
+  pthread_barrier_destroy(&shared.barrier);
+  ::munmap(mapping, where.bytes);
+  return counts;
+}
+
+}
+}
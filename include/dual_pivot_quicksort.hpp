@@ -0,0 +1,258 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+
+/*******************************************************************************
+@brief Dual-pivot quicksort, after Vladimir Yaroslavskiy's, as in Java 7.
+
+Each step takes two pivots, the second and fourth of five elements spread
+around the middle of the range, and splits the range into three in a single
+scan: elements less than the first pivot, elements between the two, and
+elements greater than the second.  A step with two pivots does about the work
+of a single-pivot step, so with a three way split there are fewer levels, and
+fewer scans of the data in all, than with introsort's two way split.  The
+recursion is limited as introsort's is, at 2 log2(n) steps, beyond which the
+range is heapsorted.
+
+When the pivots are equal, the middle holds only elements equal to them and is
+left as it is.  When it is large, elements equal to either pivot are first
+moved out to its ends, so that many duplicates can't keep it from shrinking.
+Short ranges are left for one insertion sort at the end, as with introsort,
+or sorted with sorting networks according to --small-sort.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <bits/predefined_ops.h>
+#include <iterator>
+#include <utility>
+
+#include "heapsort.hpp"
+#include "introsort.hpp"
+#include "simd_network.hpp"
+
+
+namespace SCP{
+
+/// Moves *__great to __less, *__less to __k and *__k to __great.
+template<
+  typename _RandomAccessIterator>
+inline
+void
+rotate_three(
+  _RandomAccessIterator __k,
+  _RandomAccessIterator __less,
+  _RandomAccessIterator __great
+){
+  typename std::iterator_traits<_RandomAccessIterator>::value_type
+    __tmp = std::move(*__k);
+  *__k = std::move(*__less);
+  *__less = std::move(*__great);
+  *__great = std::move(__tmp);
+}
+
+
+/// This is a helper function for the sort routine.
+template<
+  typename _RandomAccessIterator,
+  typename _Size,
+  typename _Compare>
+void
+dual_pivot_loop(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Size __depth_limit,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  auto __less_val = __gnu_cxx::__ops::__iter_comp_val(__comp);
+  auto __val_less = __gnu_cxx::__ops::__val_comp_iter(__comp);
+  while (__last - __first > int(_S_threshold)){
+    if (__depth_limit == 0){
+      heapsort_impl(__first, __last, __comp);
+      return;
+    }
+    --__depth_limit;
+
+    // Sort five elements around the middle, about a seventh apart, and take
+    // the second and fourth as the pivots, at the ends of the range.
+    const auto __len = __last - __first;
+    const auto __seventh = (__len >> 3) + (__len >> 6) + 1;
+    _RandomAccessIterator __e[5];
+    __e[2] = __first + __len / 2;
+    __e[1] = __e[2] - __seventh;
+    __e[0] = __e[1] - __seventh;
+    __e[3] = __e[2] + __seventh;
+    __e[4] = __e[3] + __seventh;
+    for (int __i = 1; __i < 5; ++__i)
+      for (int __j = __i; __j > 0 && __comp(__e[__j], __e[__j - 1]); --__j)
+        std::iter_swap(__e[__j], __e[__j - 1]);
+    std::iter_swap(__e[1], __first);
+    std::iter_swap(__e[3], __last - 1);
+    // The pivots are compared against from copies, which the compiler can
+    // keep in registers while the scan writes to the range.
+    const _ValueType __p1 = *__first;
+    const _ValueType __p2 = *(__last - 1);
+    const bool __distinct = __less_val(__first, __p2);
+
+    // Invariant: [__first + 1, __less) < p1 <= [__less, __k) <= p2
+    // < (__great, __last - 1).
+    _RandomAccessIterator __less = __first + 1;
+    _RandomAccessIterator __great = __last - 2;
+    while (__less <= __great && __less_val(__less, __p1))
+      ++__less;
+    while (__great >= __less && __val_less(__p2, __great))
+      --__great;
+    for (_RandomAccessIterator __k = __less; __k <= __great; ++__k){
+      if (__less_val(__k, __p1)){
+        std::iter_swap(__k, __less);
+        ++__less;
+      }else if (__val_less(__p2, __k)){
+        while (__val_less(__p2, __great))
+          if (__great-- == __k)
+            goto __partitioned;
+        if (__less_val(__great, __p1)){
+          rotate_three(__k, __less, __great);
+          ++__less;
+        }else{
+          std::iter_swap(__k, __great);
+        }
+        --__great;
+      }
+    }
+  __partitioned:
+    // Put the pivots between the parts.
+    --__less;
+    ++__great;
+    std::iter_swap(__first, __less);
+    std::iter_swap(__last - 1, __great);
+    const _RandomAccessIterator __pivot2 = __great;
+    dual_pivot_loop(__first, __less, __depth_limit, __comp);
+
+    ++__less;
+    --__great;
+    if (__distinct){
+      if (__less < __e[0] && __e[4] < __great){
+        // The middle is most of the range, so it may be mostly made of
+        // duplicates of the pivots: move those to its ends.
+        while (!__val_less(__p1, __less))
+          ++__less;
+        while (!__less_val(__great, __p2))
+          --__great;
+        for (_RandomAccessIterator __k = __less; __k <= __great; ++__k){
+          if (!__val_less(__p1, __k)){
+            std::iter_swap(__k, __less);
+            ++__less;
+          }else if (!__less_val(__k, __p2)){
+            while (!__less_val(__great, __p2))
+              if (__great-- == __k)
+                goto __squeezed;
+            if (!__val_less(__p1, __great)){
+              rotate_three(__k, __less, __great);
+              ++__less;
+            }else{
+              std::iter_swap(__k, __great);
+            }
+            --__great;
+          }
+        }
+      }
+    __squeezed:
+      dual_pivot_loop(__less, __great + 1, __depth_limit, __comp);
+    }
+    __first = __pivot2 + 1;
+  }
+  if (network_leaves<_RandomAccessIterator, _Compare>())
+    sort_leaf(__first, __last, __comp);
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+dual_pivot_sort_impl(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first != __last){
+    dual_pivot_loop(__first, __last, std::__lg(__last - __first) * 2, __comp);
+    if (!network_leaves<_RandomAccessIterator, _Compare>())
+      final_insertion_sort(__first, __last, __comp);
+  }
+}
+
+
+/**
+*  @brief Sort the elements of a sequence.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  Sorts the elements in the range @p [__first,__last) in ascending order.
+*  The relative ordering of equivalent elements is not preserved.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+dual_pivot_quicksort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  dual_pivot_sort_impl(__first, __last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+/**
+*  @brief Sort the elements of a sequence using a predicate for comparison.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __comp    A comparison functor.
+*  @return  Nothing.
+*
+*  Sorts the elements in the range @p [__first,__last) in ascending order,
+*  such that @p __comp(*(i+1),*i) is false for every iterator @e i in the
+*  range @p [__first,__last-1).  The relative ordering of equivalent elements
+*  is not preserved.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+dual_pivot_quicksort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  dual_pivot_sort_impl(__first, __last,
+                       __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+};
@@ -0,0 +1,538 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+/*******************************************************************************
+@brief External merge sort, for data that doesn't fit in memory.
+
+Run generation reads the input a chunk at a time, sorts each chunk with the
+chosen sort and appends it to a temporary file as one run.  Half of the memory
+budget holds the chunk being filled and sorted, the other half the previous
+one while it is written out in the background, so writing a run overlaps with
+sorting the next.  The sort's own scratch space is not counted.  Buffers are
+left uninitialized, so memory that is never read into is never touched.
+
+The merge reads each run back a block at a time, with two blocks per run: one
+is merged while the next is read in the background, and the output is written
+through two blocks the same way.  As many runs are merged at once as the budget
+has room for blocks of at least min_block_bytes, up to max_multiway_runs.  With
+more runs than that, extra passes merge them a group at a time first, each one
+reading and writing all of the data.
+
+All the runs of a pass share one file, each at its own offset, so only a few
+files are open however many runs there are.  A file is closed once no run is
+left in it.
+
+Each round of the merge picks the run whose block in memory ends with the
+smallest element and merges everything up to that element out of every block
+with a loser tree.  That uses up the picked block, and nothing still on disk
+can be smaller.  Runs before the picked one also give up elements equal to it,
+runs after it don't, which keeps the merge stable.
+
+Temporary files go in $TMPDIR, or /tmp, and are unlinked as soon as they are
+created, so they don't outlive the process.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "multiway_merge.hpp"
+
+
+namespace SCP{
+namespace external{
+
+/// Smallest block worth reading a run in during the merge, which limits how
+/// many runs are merged at once.
+inline constexpr std::size_t min_block_bytes = std::size_t(1) << 20;
+
+
+/// What external_sort() did, and how long it took.
+struct stats{
+  std::size_t runs = 0;
+  std::size_t merge_passes = 0;
+  double run_generation_seconds = 0;
+  double merge_seconds = 0;
+  std::size_t bytes_read = 0;
+  std::size_t bytes_written = 0;
+
+  void
+  report(
+    std::ostream &out
+  ) const {
+    out << "runs: " << runs << std::endl;
+    out << "merge passes: " << merge_passes << std::endl;
+    out << "run generation seconds: " << run_generation_seconds << std::endl;
+    out << "merge seconds: " << merge_seconds << std::endl;
+    out << "bytes read: " << bytes_read << std::endl;
+    out << "bytes written: " << bytes_written << std::endl;
+  }
+};
+
+
+/// A sorted run, 'length' elements starting 'offset' elements into a
+/// temporary file.
+struct run{
+  int fd;
+  std::size_t offset;
+  std::size_t length;
+};
+
+
+/// Creates a temporary file in $TMPDIR, or /tmp, and unlinks it.
+inline
+int
+open_temporary(
+){
+  const char *dir = std::getenv("TMPDIR");
+  std::string path = std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp")
+                   + "/SCP-XXXXXX";
+  const int fd = ::mkstemp(path.data());
+  if(fd < 0){
+    std::cout << "Can't create a temporary file in " << path << ": "
+              << std::strerror(errno) << std::endl;
+    std::exit(errno);
+  }
+  ::unlink(path.c_str());
+  return fd;
+}
+
+
+/// Appends [data, data + bytes) to fd.
+inline
+void
+write_fully(
+  int fd,
+  const void *data,
+  std::size_t bytes
+){
+  const char *position = static_cast<const char*>(data);
+  while(bytes > 0){
+    const ssize_t done = ::write(fd, position, bytes);
+    if(done < 0){
+      if(errno == EINTR)
+        continue;
+      std::cout << "Writing a temporary file failed: " << std::strerror(errno)
+                << std::endl;
+      std::exit(errno);
+    }
+    position += done;
+    bytes -= done;
+  }
+}
+
+
+/// Reads [offset, offset + bytes) of fd into data.
+inline
+void
+read_fully(
+  int fd,
+  void *data,
+  std::size_t bytes,
+  off_t offset
+){
+  char *position = static_cast<char*>(data);
+  while(bytes > 0){
+    const ssize_t done = ::pread(fd, position, bytes, offset);
+    if(done <= 0){
+      if(done < 0 && errno == EINTR)
+        continue;
+      std::cout << "Reading a temporary file failed: "
+                << (done < 0 ? std::strerror(errno) : "unexpected end of file")
+                << std::endl;
+      std::exit(done < 0 ? errno : EIO);
+    }
+    position += done;
+    bytes -= done;
+    offset += done;
+  }
+}
+
+
+/// Reads a run back a block at a time, the next block in the background while
+/// the current one is merged.
+template<
+  typename T>
+class run_reader{
+public:
+  run_reader(
+    const run &source,
+    std::size_t block,
+    stats &counts
+  ):
+    begin(nullptr),
+    end(nullptr),
+    fd(source.fd),
+    remaining(source.length),
+    offset(source.offset),
+    block(block),
+    next_length(0),
+    current(1),
+    counts(counts)
+  {
+    for(std::unique_ptr<T[]> &buffer : buffers)
+      buffer.reset(new T[std::min(block, source.length)]);
+    read_next();
+  }
+
+  /// Makes the next block current, once the current one is used up.  Returns
+  /// false at the end of the run.
+  bool
+  next(
+  ){
+    if(not pending.valid())
+      return false;
+    pending.get();
+    current ^= 1;
+    begin = buffers[current].get();
+    end = begin + next_length;
+    read_next();
+    return true;
+  }
+
+  /// The part of the current block not merged yet.
+  T *begin;
+  T *end;
+
+private:
+  void
+  read_next(
+  ){
+    if(remaining == 0)
+      return;
+    next_length = std::min(block, remaining);
+    pending = std::async(std::launch::async, read_fully, fd,
+                         buffers[current ^ 1].get(), next_length * sizeof(T),
+                         off_t(offset * sizeof(T)));
+    counts.bytes_read += next_length * sizeof(T);
+    remaining -= next_length;
+    offset += next_length;
+  }
+
+  int fd;
+  std::size_t remaining;
+  std::size_t offset;
+  std::size_t block;
+  std::size_t next_length;
+  int current;
+  std::unique_ptr<T[]> buffers[2];
+  std::future<void> pending;
+  stats &counts;
+};
+
+
+/// Appends to a file through two blocks, writing one in the background while
+/// the other fills up.
+template<
+  typename T>
+class run_writer{
+public:
+  run_writer(
+    int fd,
+    std::size_t block,
+    stats &counts
+  ):
+    fd(fd),
+    block(block),
+    fill(0),
+    current(0),
+    counts(counts)
+  {
+    for(std::unique_ptr<T[]> &buffer : buffers)
+      buffer.reset(new T[block]);
+  }
+
+  run_writer(const run_writer&) = delete;
+  run_writer& operator=(const run_writer&) = delete;
+
+  void
+  push(
+    const T &value
+  ){
+    buffers[current][fill] = value;
+    if(++fill == block)
+      flush();
+  }
+
+  /// Writes out what is left and waits for it.
+  void
+  finish(
+  ){
+    flush();
+    if(pending.valid())
+      pending.get();
+  }
+
+  /// Output iterator pushing onto a run_writer.
+  struct iterator{
+    typedef std::output_iterator_tag iterator_category;
+    typedef void value_type;
+    typedef void difference_type;
+    typedef void pointer;
+    typedef void reference;
+
+    run_writer *writer;
+
+    iterator& operator*(){ return *this; }
+    iterator& operator++(){ return *this; }
+    iterator& operator++(int){ return *this; }
+    iterator& operator=(const T &value){ writer->push(value); return *this; }
+  };
+
+  iterator
+  output(
+  ){
+    return iterator{this};
+  }
+
+private:
+  void
+  flush(
+  ){
+    if(fill == 0)
+      return;
+    if(pending.valid())
+      pending.get();
+    pending = std::async(std::launch::async, write_fully, fd,
+                         buffers[current].get(), fill * sizeof(T));
+    counts.bytes_written += fill * sizeof(T);
+    current ^= 1;
+    fill = 0;
+  }
+
+  int fd;
+  std::size_t block;
+  std::size_t fill;
+  int current;
+  std::unique_ptr<T[]> buffers[2];
+  std::future<void> pending;
+  stats &counts;
+};
+
+
+/// Closes the files that runs are in, except for those that a run in 'kept' is
+/// in too.
+inline
+void
+close_files(
+  const std::vector<run> &runs,
+  const std::vector<run> &kept
+){
+  std::vector<int> fds;
+  for(const run &r : runs)
+    fds.push_back(r.fd);
+  std::sort(fds.begin(), fds.end());
+  fds.erase(std::unique(fds.begin(), fds.end()), fds.end());
+  for(int fd : fds)
+    if(std::none_of(kept.begin(), kept.end(), [&](const run &r){ return r.fd == fd; }))
+      ::close(fd);
+}
+
+
+/// Merges the runs [runs, runs + k) into the file out_fd, reading and writing
+/// blocks of 'block' elements.
+template<
+  typename T>
+void
+merge_runs(
+  const run *runs,
+  std::size_t k,
+  int out_fd,
+  std::size_t block,
+  stats &counts
+){
+  std::less<T> comp;
+  std::vector<std::unique_ptr<run_reader<T>>> readers;
+  bool live[max_multiway_runs];
+  for(std::size_t i = 0; i < k; ++i){
+    readers.emplace_back(new run_reader<T>(runs[i], block, counts));
+    live[i] = readers[i]->next();
+  }
+  run_writer<T> writer(out_fd, block, counts);
+
+  T *begins[max_multiway_runs];
+  T *cuts[max_multiway_runs];
+  for(;;){
+    // the run whose block ends with the smallest element, the first on ties
+    std::size_t picked = k;
+    for(std::size_t i = 0; i < k; ++i)
+      if(live[i] and (picked == k or comp(readers[i]->end[-1], readers[picked]->end[-1])))
+        picked = i;
+    if(picked == k)
+      break;
+
+    const T bound = readers[picked]->end[-1];
+    for(std::size_t i = 0; i < k; ++i){
+      begins[i] = readers[i]->begin;
+      if(not live[i])
+        cuts[i] = begins[i];
+      else if(i <= picked)
+        cuts[i] = std::upper_bound(begins[i], readers[i]->end, bound, comp);
+      else
+        cuts[i] = std::lower_bound(begins[i], readers[i]->end, bound, comp);
+    }
+    loser_tree_merge_ranges(begins, cuts, k, writer.output(), comp);
+
+    for(std::size_t i = 0; i < k; ++i){
+      readers[i]->begin = cuts[i];
+      if(live[i] and cuts[i] == readers[i]->end)
+        live[i] = readers[i]->next();
+    }
+  }
+  writer.finish();
+}
+
+
+/**
+ * Sorts the elements given by 'source' into the file out_fd, holding at most
+ * about memory_budget bytes of them in memory at once.
+ *
+ * source(out, max) stores up to max elements at out and returns how many, 0
+ * at the end of the input.  sort(first, last) sorts a T* range in ascending
+ * order.
+ */
+template<
+  typename T,
+  typename Source,
+  typename Sort>
+stats
+external_sort(
+  Source &&source,
+  Sort &&sort,
+  int out_fd,
+  std::size_t memory_budget
+){
+  static_assert(std::is_trivially_copyable_v<T>,
+                "runs are written to disk as they are in memory");
+  typedef std::chrono::steady_clock clock;
+  stats counts;
+  std::vector<run> runs;
+
+  // RUN GENERATION
+  const auto generation_start = clock::now();
+  {
+    const std::size_t chunk = std::max<std::size_t>(1, memory_budget / 2 / sizeof(T));
+    std::unique_ptr<T[]> chunks[2];
+    std::future<void> writing;
+    int spill = -1;
+    std::size_t spilled = 0;
+    for(int current = 0;; current ^= 1){
+      // the second chunk is only allocated once the input doesn't fit in one
+      if(not chunks[current])
+        chunks[current].reset(new T[chunk]);
+      T *buffer = chunks[current].get();
+      std::size_t length = 0;
+      while(length < chunk){
+        const std::size_t got = source(buffer + length, chunk - length);
+        if(got == 0)
+          break;
+        length += got;
+      }
+      if(length == 0)
+        break;
+      sort(buffer, buffer + length);
+      ++counts.runs;
+
+      // everything fit in one chunk, so there's nothing to merge
+      if(runs.empty() and length < chunk){
+        write_fully(out_fd, buffer, length * sizeof(T));
+        counts.bytes_written += length * sizeof(T);
+        break;
+      }
+
+      // the other chunk has to be out before this one is written, and before
+      // it is refilled
+      if(writing.valid())
+        writing.get();
+      if(spill < 0)
+        spill = open_temporary();
+      runs.push_back(run{spill, spilled, length});
+      spilled += length;
+      writing = std::async(std::launch::async, write_fully, spill,
+                           buffer, length * sizeof(T));
+      counts.bytes_written += length * sizeof(T);
+      if(length < chunk)
+        break;
+    }
+    if(writing.valid())
+      writing.get();
+  }
+  const auto merge_start = clock::now();
+  counts.run_generation_seconds = std::chrono::duration<double>(merge_start - generation_start).count();
+
+  // MERGE
+  // each run being merged and the output get two blocks
+  const std::size_t fan_in = std::clamp<std::size_t>(
+    memory_budget / (2 * min_block_bytes), 3, max_multiway_runs + 1) - 1;
+  auto block_for = [&](std::size_t k){
+    return std::max<std::size_t>(1, memory_budget / (2 * (k + 1)) / sizeof(T));
+  };
+  while(runs.size() > fan_in){
+    std::vector<run> merged;
+    const int pass = open_temporary();
+    std::size_t written = 0;
+    for(std::size_t i = 0; i < runs.size(); i += fan_in){
+      const std::size_t k = std::min(fan_in, runs.size() - i);
+      if(k == 1){
+        merged.push_back(runs[i]);
+        continue;
+      }
+      run output{pass, written, 0};
+      merge_runs<T>(runs.data() + i, k, pass, block_for(k), counts);
+      for(std::size_t j = i; j < i + k; ++j)
+        output.length += runs[j].length;
+      written += output.length;
+      merged.push_back(output);
+    }
+    close_files(runs, merged);
+    runs.swap(merged);
+    ++counts.merge_passes;
+  }
+  if(not runs.empty()){
+    merge_runs<T>(runs.data(), runs.size(), out_fd, block_for(runs.size()), counts);
+    ++counts.merge_passes;
+  }
+  close_files(runs, {});
+  counts.merge_seconds = std::chrono::duration<double>(clock::now() - merge_start).count();
+
+  return counts;
+}
+
+}
+}
@@ -0,0 +1,197 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief Bottom-up heapsort, used by the introsorts once their depth limit runs
+out and available as a sort of its own.
+
+Removing the top of a heap leaves a hole at the root, to be filled with the
+last leaf.  The textbook sift-down compares both children against each other
+and against that leaf at every level, two comparisons per level, even though
+the leaf almost always ends up near the bottom again.  Floyd's bottom-up
+variant walks the hole down to a leaf comparing only the two children, then
+sifts the leaf back up from there, which usually takes one or two comparisons.
+
+The walk down picks the larger child by adding the comparison result to the
+index, so there is no data-dependent branch on that choice either.
+
+The comparators are the iterator comparators of <bits/predefined_ops.h>, as in
+introsort.hpp.
+*******************************************************************************/
+
+#pragma once
+
+#include <bits/predefined_ops.h>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+
+namespace SCP{
+
+/// Fills the hole at __hole in the heap [__first, __first + __len) with
+/// __value, keeping the heap property below __hole.
+template<
+  typename _RandomAccessIterator,
+  typename _Distance,
+  typename _Tp,
+  typename _Compare>
+void
+bottom_up_adjust_heap(
+  _RandomAccessIterator __first,
+  _Distance __hole,
+  _Distance __len,
+  _Tp __value,
+  _Compare __comp
+){
+  const _Distance __top = __hole;
+
+  // Walk the hole down to a leaf, moving the larger child up each time.
+  _Distance __child = 2 * __hole + 1;
+  while (__child + 1 < __len){
+    if (4 * __child + 10 < __len){
+      __builtin_prefetch(std::addressof(*(__first + (4 * __child + 3))));
+      __builtin_prefetch(std::addressof(*(__first + (4 * __child + 10))));
+    }
+    __child += __comp(__first + __child, __first + (__child + 1));
+    *(__first + __hole) = std::move(*(__first + __child));
+    __hole = __child;
+    __child = 2 * __hole + 1;
+  }
+  if (__child < __len){
+    *(__first + __hole) = std::move(*(__first + __child));
+    __hole = __child;
+  }
+
+  // Sift __value back up from the leaf.
+  __decltype(__gnu_cxx::__ops::__iter_comp_val(std::move(__comp)))
+    __cmp(std::move(__comp));
+  _Distance __parent = (__hole - 1) / 2;
+  while (__hole > __top && __cmp(__first + __parent, __value)){
+    *(__first + __hole) = std::move(*(__first + __parent));
+    __hole = __parent;
+    __parent = (__hole - 1) / 2;
+  }
+  *(__first + __hole) = std::move(__value);
+}
+
+
+/// This is a helper function for the heapsort routine.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+bottom_up_make_heap(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::difference_type
+    _Distance;
+  const _Distance __len = __last - __first;
+  for (_Distance __parent = __len / 2; __parent > 0; ){
+    --__parent;
+    bottom_up_adjust_heap(__first, __parent, __len,
+                          std::move(*(__first + __parent)), __comp);
+  }
+}
+
+
+/// This is a helper function for the heapsort routine.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+bottom_up_sort_heap(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::difference_type
+    _Distance;
+  while (__last - __first > 1){
+    --__last;
+    auto __value = std::move(*__last);
+    *__last = std::move(*__first);
+    bottom_up_adjust_heap(__first, _Distance(0), _Distance(__last - __first),
+                          std::move(__value), __comp);
+  }
+}
+
+
+/// This is a helper function for the sort routines.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+heapsort_impl(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  bottom_up_make_heap(__first, __last, __comp);
+  bottom_up_sort_heap(__first, __last, __comp);
+}
+
+
+/**
+*  @brief Sort the elements of a sequence with a bottom-up heapsort.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  O(n log n) in the worst case and in place, but not stable.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+heapsort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  heapsort_impl(__first, __last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+/**
+*  @brief Sort the elements of a sequence with a bottom-up heapsort, using a
+*  predicate for comparison.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __comp    A comparison functor.
+*  @return  Nothing.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+heapsort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  heapsort_impl(__first, __last, __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+};
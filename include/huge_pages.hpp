@@ -0,0 +1,220 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+/*******************************************************************************
+@brief Page size control for the test data and the timsorts' merge buffers, for
+--pages.
+
+At a million elements and up, the data and the merge buffers span thousands
+of 4 KiB pages, more than the data TLB holds, so a sort that jumps around
+them, as galloping does, misses in the TLB as well as in the caches.  A 2 MiB
+page covers 512 times as much.
+
+allocator hands out memory of at least huge_page_bytes straight from mmap(2),
+sized up to a whole number of huge pages, and with the page size given by
+'pages':
+  system       Through operator new, as std::allocator would, leaving the
+               page size to the kernel's transparent huge page policy.
+  small        madvise(MADV_NOHUGEPAGE), so 4 KiB pages whatever the policy.
+  transparent  Aligned to huge_page_bytes and madvise(MADV_HUGEPAGE), so
+               transparent huge pages unless they are disabled altogether.
+  hugetlb      MAP_HUGETLB, pages from the pool reserved in
+               /proc/sys/vm/nr_hugepages.  Fails if the pool runs out.
+Anything smaller goes through operator new whatever the setting, as a page of
+either size would hold it, and so that small buffers don't cost a system call
+each.
+
+The test data of the 'vector' container is a huge_pages::vector, and the
+merge buffers of gfx_timsort and tvs_timsort, and of the powersorts, which
+share their merges, are allocated through allocator, so --pages applies to
+both.  With 'system', the default, they allocate exactly as before.
+
+Mapped memory doesn't go through operator new, so --scratch-bytes counts it
+through 'accounting' instead.
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+
+
+namespace SCP{
+namespace huge_pages{
+
+enum class page_size { system, small, transparent, hugetlb };
+
+/// Set from --pages, before anything is allocated through allocator, as what
+/// it frees is unmapped or deleted by the setting.
+inline page_size pages = page_size::system;
+
+/// Called with the bytes mapped, or minus those unmapped, if set.
+inline void (*accounting)(std::ptrdiff_t bytes) = nullptr;
+
+enum : std::size_t { huge_page_bytes = std::size_t(2) << 20 };
+
+
+/// Whether an allocation of __bytes is mapped rather than from operator new.
+inline
+bool
+mapped(
+  std::size_t __bytes
+){
+  return pages != page_size::system && __bytes >= huge_page_bytes;
+}
+
+
+inline
+std::size_t
+mapped_length(
+  std::size_t __bytes
+){
+  return (__bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes;
+}
+
+
+inline
+void *
+allocate(
+  std::size_t __bytes
+){
+  if(!mapped(__bytes))
+    return ::operator new(__bytes);
+
+  const std::size_t __length = mapped_length(__bytes);
+  char *__block;
+  if(pages == page_size::hugetlb){
+    void *__map = mmap(nullptr, __length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(__map == MAP_FAILED)
+      throw std::bad_alloc();
+    __block = static_cast<char *>(__map);
+  }else{
+    // map a huge page more than needed, and trim it to a boundary
+    void *__map = mmap(nullptr, __length + huge_page_bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(__map == MAP_FAILED)
+      throw std::bad_alloc();
+    char *const __start = static_cast<char *>(__map);
+    __block = reinterpret_cast<char *>(
+      (reinterpret_cast<std::uintptr_t>(__start) + huge_page_bytes - 1)
+      / huge_page_bytes * huge_page_bytes);
+    if(__block != __start)
+      munmap(__start, __block - __start);
+    munmap(__block + __length, __start + huge_page_bytes - __block);
+    // a failure only leaves the kernel's choice of page size
+    madvise(__block, __length,
+            pages == page_size::transparent ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+  }
+  if(accounting != nullptr)
+    accounting(std::ptrdiff_t(__length));
+  return __block;
+}
+
+
+inline
+void
+deallocate(
+  void *__block,
+  std::size_t __bytes
+) noexcept {
+  if(!mapped(__bytes)){
+    ::operator delete(__block);
+    return;
+  }
+  const std::size_t __length = mapped_length(__bytes);
+  munmap(__block, __length);
+  if(accounting != nullptr)
+    accounting(-std::ptrdiff_t(__length));
+}
+
+
+/// Allocates through allocate() and deallocate(), for standard containers.
+template<
+  typename _Tp>
+struct allocator{
+  typedef _Tp value_type;
+
+  allocator() noexcept = default;
+
+  template<
+    typename _Up>
+  allocator(
+    const allocator<_Up> &
+  ) noexcept {}
+
+  _Tp *
+  allocate(
+    std::size_t __n
+  ){
+    return static_cast<_Tp *>(huge_pages::allocate(__n * sizeof(_Tp)));
+  }
+
+  void
+  deallocate(
+    _Tp *__p,
+    std::size_t __n
+  ) noexcept {
+    huge_pages::deallocate(__p, __n * sizeof(_Tp));
+  }
+};
+
+template<
+  typename _Tp,
+  typename _Up>
+bool
+operator==(
+  const allocator<_Tp> &,
+  const allocator<_Up> &
+){
+  return true;
+}
+
+template<
+  typename _Tp,
+  typename _Up>
+bool
+operator!=(
+  const allocator<_Tp> &,
+  const allocator<_Up> &
+){
+  return false;
+}
+
+
+/// A std::vector allocating through allocator.  A class of its own rather
+/// than an alias, so that it still matches the container<T> of the test
+/// driver's templates.
+template<
+  typename _Tp>
+class vector : public std::vector<_Tp, allocator<_Tp> >{
+public:
+  using std::vector<_Tp, allocator<_Tp> >::vector;
+};
+
+};
+};
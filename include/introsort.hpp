@@ -82,6 +82,10 @@ with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
 #include <bits/stl_tempbuf.h>  // for _Temporary_buffer
 #include <bits/predefined_ops.h>
 
+#include "heapsort.hpp"
+#include "simd_network.hpp"
+#include "static_network.hpp"
+
 //#if __cplusplus >= 201103L
 //#include <bits/uniform_int_dist.h>
 //#endif
@@ -112,6 +116,43 @@ final_insertion_sort(
   }
 }
 
+/// Whether the leaves left by introsort_loop() are sorted there with a SIMD
+/// or static network, in which case final_insertion_sort() is skipped.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+bool
+network_leaves(
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  if constexpr (std::is_same<_Compare, __gnu_cxx::__ops::_Iter_less_iter>::value)
+    if (simd::use_network<_ValueType, std::less<_ValueType> >())
+      return true;
+  return static_network::use_network<_ValueType>();
+}
+
+/// Sorts a leaf of at most _S_threshold elements when network_leaves().
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+sort_leaf(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if constexpr (std::is_same<_Compare, __gnu_cxx::__ops::_Iter_less_iter>::value)
+    if (simd::network_sort(__first, __last))
+      return;
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  if constexpr (static_network::network_sortable_v<_ValueType>)
+    static_network::sort_small<_S_threshold>(__first, __last, __comp);
+}
+
 /// This is a helper function...
 template<
   typename _RandomAccessIterator,
@@ -182,7 +223,7 @@ SCP_partial_sort(
   _RandomAccessIterator __last,
   _Compare __comp
 ){
-  std::__heap_select(__first, __middle, __last, __comp);
+  heap_select(__first, __middle, __last, __comp);
   std::__sort_heap(__first, __middle, __comp);
 }
 
@@ -201,7 +242,7 @@ introsort_loop(
 ){
   while (__last - __first > int(_S_threshold)){
     if (__depth_limit == 0){
-      SCP_partial_sort(__first, __last, __last, __comp);
+      heapsort_impl(__first, __last, __comp);
       return;
     }
     --__depth_limit;
@@ -209,6 +250,8 @@ introsort_loop(
     introsort_loop(__cut, __last, __depth_limit, __comp);
     __last = __cut;
   }
+  if (network_leaves<_RandomAccessIterator, _Compare>())
+    sort_leaf(__first, __last, __comp);
 }
 
 
@@ -224,7 +267,8 @@ sort_impl(
 ){
   if (__first != __last){
     introsort_loop(__first, __last, std::__lg(__last - __first) * 2, __comp);
-    final_insertion_sort(__first, __last, __comp);
+    if (!network_leaves<_RandomAccessIterator, _Compare>())
+      final_insertion_sort(__first, __last, __comp);
   }
 }
 
@@ -283,4 +327,108 @@ introsort(
   sort_impl(__first, __last, __gnu_cxx::__ops::__iter_comp_iter(__comp));
 }
 
+
+/**
+*  @brief Sort the elements of a sequence using a predicate for comparison.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __comp    A comparison functor.
+*  @return  Nothing.
+*
+*  Ranges of up to static_network::max_size arithmetic or pointer elements
+*  are sorted with the network for their length, whatever --small-sort says,
+*  and anything else with introsort().
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+static_network_sort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  if constexpr (static_network::network_sortable_v<_ValueType>)
+    if (__last - __first <= int(static_network::max_size)){
+      static_network::sort_small<static_network::max_size>(
+        __first, __last, __gnu_cxx::__ops::__iter_comp_iter(__comp));
+      return;
+    }
+  introsort(__first, __last, __comp);
+}
+
+
+template<
+  typename _RandomAccessIterator>
+inline
+void
+static_network_sort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  static_network_sort(__first, __last, std::less<_ValueType>());
+}
+
+
+/**
+*  @brief Sort each of the arrays of @p __length elements laid out one after
+*  the other in a sequence, the last possibly shorter, using a predicate for
+*  comparison.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __length  The length of each array.
+*  @param  __comp    A comparison functor.
+*  @return  Nothing.
+*
+*  The same as static_network_sort() on each array, but the network for
+*  @p __length is only looked up once.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+static_network_sort_batch(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  std::size_t __length,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  if constexpr (static_network::network_sortable_v<_ValueType>)
+    if (__length <= std::size_t(static_network::max_size)){
+      auto __iter_comp = __gnu_cxx::__ops::__iter_comp_iter(__comp);
+      const auto __kernel = static_network::kernel<
+        static_network::max_size, _RandomAccessIterator, decltype(__iter_comp)>(__length);
+      for (; std::size_t(__last - __first) > __length; __first += __length)
+        __kernel(__first, __iter_comp);
+      static_network::sort_small<static_network::max_size>(__first, __last, __iter_comp);
+      return;
+    }
+  for (; std::size_t(__last - __first) > __length; __first += __length)
+    introsort(__first, __first + __length, __comp);
+  introsort(__first, __last, __comp);
+}
+
+
+template<
+  typename _RandomAccessIterator>
+inline
+void
+static_network_sort_batch(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  std::size_t __length
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  static_network_sort_batch(__first, __last, __length, std::less<_ValueType>());
+}
+
 };
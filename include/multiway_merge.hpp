@@ -0,0 +1,272 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+/*******************************************************************************
+@brief Merging of many adjacent sorted runs in a single pass, used for the
+final collapse of the timsorts.
+
+Collapsing k runs two at a time moves every element through the merge buffer
+about log2(k) times.  A loser tree does it once: each leaf is the head of a
+run, each inner node remembers the loser of the match played there, and the
+overall winner sits above the root.  Once the winner is written out, only the
+matches on the path from its leaf to the root are replayed, so each element
+costs log2(k) comparisons and a single move out and back.
+
+Ties go to the run further left, so the merge is stable.
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace SCP{
+
+/**
+ * How the timsorts merge the runs left on their stack at the end.
+ *   binary    Two at a time, from the top of the stack, as the original.
+ *   multiway  All at once with a loser tree, at most max_multiway_runs of
+ *             them; above that the top runs are merged in pairs first.  Only
+ *             when that takes no more comparisons, see
+ *             multiway_merge_pays_off(), otherwise as 'binary'.
+ */
+enum class final_merge_type { binary, multiway };
+
+/// Most runs merged in one multiway pass.
+enum { max_multiway_runs = 32 };
+
+
+/// What the nodes of a loser tree hold to stand for the head of a run: a copy
+/// of the element for small trivially copyable types, so replaying a match
+/// doesn't wait on a load, otherwise the iterator.
+template<
+  typename _RandomAccessIterator,
+  typename _Tp = typename std::iterator_traits<_RandomAccessIterator>::value_type,
+  bool = std::is_trivially_copyable_v<_Tp> and sizeof(_Tp) <= 2 * sizeof(void*)>
+struct loser_tree_key{
+  typedef _Tp type;
+  static type get(_RandomAccessIterator __it){ return *__it; }
+  static const _Tp& ref(const type &__key){ return __key; }
+};
+
+template<
+  typename _RandomAccessIterator,
+  typename _Tp>
+struct loser_tree_key<_RandomAccessIterator, _Tp, false>{
+  typedef _RandomAccessIterator type;
+  static type get(_RandomAccessIterator __it){ return __it; }
+  static decltype(auto) ref(const type &__key){ return *__key; }
+};
+
+
+/// Records, for each in-order position of a leaf of a loser tree laid out as
+/// a heap over __k leaves, the node the leaf sits at.
+inline void
+loser_tree_leaves(
+  std::size_t __node,
+  std::size_t __k,
+  std::size_t *__leaf,
+  std::size_t &__rank
+){
+  if(__node >= __k){
+    __leaf[__rank++] = __node;
+  }else{
+    loser_tree_leaves(2 * __node, __k, __leaf, __rank);
+    loser_tree_leaves(2 * __node + 1, __k, __leaf, __rank);
+  }
+}
+
+
+/// Merges the sorted ranges [__begins[i], __ends[i]), for i in [0, __runs),
+/// into __out, taking equal elements from the lower i first.  __runs must be
+/// at most max_multiway_runs.
+template<
+  typename _RandomAccessIterator,
+  typename _OutputIterator,
+  typename _Compare>
+_OutputIterator
+loser_tree_merge_ranges(
+  const _RandomAccessIterator *__begins,
+  const _RandomAccessIterator *__ends,
+  std::size_t __runs,
+  _OutputIterator __out,
+  _Compare __comp
+){
+  typedef loser_tree_key<_RandomAccessIterator> _Key;
+  typedef typename _Key::type _KeyType;
+
+  // heads and ends of the runs not yet exhausted, in their original order
+  _RandomAccessIterator __cur[max_multiway_runs];
+  _RandomAccessIterator __end[max_multiway_runs];
+  std::size_t __k = 0;
+  for(std::size_t __i = 0; __i < __runs; ++__i){
+    if(__begins[__i] != __ends[__i]){
+      __cur[__k] = __begins[__i];
+      __end[__k] = __ends[__i];
+      ++__k;
+    }
+  }
+
+  // The tree is laid out as a heap over __k leaves, which works for any __k.
+  // Runs go to the leaves in order, so the runs below the left child of a
+  // node all come before those below the right child, and on a tie the side
+  // the challenger came up from decides, without a branch.  A run stays in
+  // the tree until it runs out; then the tree is rebuilt without it, so the
+  // replay never has to check for the end of a run.
+  std::size_t __leaf[max_multiway_runs];
+  std::size_t __node_run[max_multiway_runs];
+  _KeyType __head[max_multiway_runs];
+  std::size_t __winner[2 * max_multiway_runs];
+  while(__k > 1){
+    std::size_t __rank = 0;
+    loser_tree_leaves(1, __k, __leaf, __rank);
+
+    // play the first round bottom up; the left one wins ties
+    for(std::size_t __i = 0; __i < __k; ++__i){
+      __winner[__leaf[__i]] = __i;
+      __head[__i] = _Key::get(__cur[__i]);
+    }
+    for(std::size_t __node = __k - 1; __node > 0; --__node){
+      const std::size_t __a = __winner[2 * __node];
+      const std::size_t __b = __winner[2 * __node + 1];
+      const bool __b_wins = __comp(_Key::ref(__head[__b]), _Key::ref(__head[__a]));
+      __winner[__node] = __b_wins ? __b : __a;
+      __node_run[__node] = __b_wins ? __a : __b;
+    }
+
+    std::size_t __w = __winner[1];
+    for(;;){
+      *__out = std::move(*__cur[__w]);
+      ++__out;
+      if(++__cur[__w] == __end[__w])
+        break;
+      __head[__w] = _Key::get(__cur[__w]);
+      // replay the matches from the winner's leaf up.  The runs are picked
+      // with masks rather than conditionals, which compilers like to turn
+      // back into branches.
+      for(std::size_t __child = __leaf[__w]; __child > 1; __child >>= 1){
+        const std::size_t __node = __child >> 1;
+        const std::size_t __l = __node_run[__node];
+        // compare in the order of the runs, then flip the result if the
+        // challenger is the left one
+        const std::size_t __right = __child & 1;
+        const std::size_t __swap = (__w ^ __l) & (std::size_t(0) - __right);
+        const bool __l_wins = __comp(_Key::ref(__head[__l ^ __swap]),
+                                     _Key::ref(__head[__w ^ __swap])) != bool(__right);
+        const std::size_t __change = (__w ^ __l) & (std::size_t(0) - __l_wins);
+        __node_run[__node] = __l ^ __change;
+        __w ^= __change;
+      }
+    }
+
+    // drop the exhausted run and start over with the rest
+    for(std::size_t __i = __w + 1; __i < __k; ++__i){
+      __cur[__i - 1] = __cur[__i];
+      __end[__i - 1] = __end[__i];
+    }
+    --__k;
+  }
+  if(__k == 1)
+    __out = std::move(__cur[0], __end[0], __out);
+  return __out;
+}
+
+
+/// Merges the adjacent sorted runs [__first + __bounds[i], __first +
+/// __bounds[i + 1]), for i in [0, __runs), into __out.  __runs must be at
+/// most max_multiway_runs.
+template<
+  typename _RandomAccessIterator,
+  typename _OutputIterator,
+  typename _Compare>
+_OutputIterator
+loser_tree_merge(
+  _RandomAccessIterator __first,
+  const std::size_t *__bounds,
+  std::size_t __runs,
+  _OutputIterator __out,
+  _Compare __comp
+){
+  _RandomAccessIterator __begins[max_multiway_runs];
+  _RandomAccessIterator __ends[max_multiway_runs];
+  for(std::size_t __i = 0; __i < __runs; ++__i){
+    __begins[__i] = __first + __bounds[__i];
+    __ends[__i] = __first + __bounds[__i + 1];
+  }
+  return loser_tree_merge_ranges(__begins, __ends, __runs, __out, __comp);
+}
+
+
+/// Whether merging the adjacent runs described by __bounds, as for
+/// loser_tree_merge(), in one pass takes no more comparisons than collapsing
+/// them two at a time from the last one.  Each element goes through log2(__runs)
+/// matches in the loser tree, against one per binary merge it takes part in,
+/// so this only holds when the runs are of similar lengths.
+inline bool
+multiway_merge_pays_off(
+  const std::size_t *__bounds,
+  std::size_t __runs
+){
+  std::size_t __levels = 0;
+  while((std::size_t(1) << __levels) < __runs)
+    ++__levels;
+  std::size_t __binary = 0;
+  for(std::size_t __i = __runs - 1; __i > 0; --__i)
+    __binary += __bounds[__runs] - __bounds[__i - 1];
+  return __levels * (__bounds[__runs] - __bounds[0]) <= __binary;
+}
+
+
+/// Merges the adjacent sorted runs described by __bounds, as for
+/// loser_tree_merge(), in place, using __buffer as scratch space.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare,
+  typename _Tp,
+  typename _Alloc>
+void
+multiway_merge(
+  _RandomAccessIterator __first,
+  const std::size_t *__bounds,
+  std::size_t __runs,
+  _Compare __comp,
+  std::vector<_Tp, _Alloc> &__buffer
+){
+  __buffer.clear();
+  if constexpr(std::is_trivially_copyable_v<_Tp>
+           and std::is_default_constructible_v<_Tp>){
+    __buffer.resize(__bounds[__runs] - __bounds[0]);
+    loser_tree_merge(__first, __bounds, __runs, __buffer.data(), __comp);
+  }else{
+    __buffer.reserve(__bounds[__runs] - __bounds[0]);
+    loser_tree_merge(__first, __bounds, __runs, std::back_inserter(__buffer), __comp);
+  }
+  std::move(__buffer.begin(), __buffer.end(), __first + __bounds[0]);
+  __buffer.clear();
+}
+
+}
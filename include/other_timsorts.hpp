@@ -46,6 +46,13 @@
 #include <valarray>
 #include <vector>
 
+#include "huge_pages.hpp"
+#include "multiway_merge.hpp"
+#include "prefetch.hpp"
+#include "simd_merge.hpp"
+#include "simd_network.hpp"
+#include "static_network.hpp"
+
 
 #ifdef ENABLE_TIMSORT_LOG
 #include <iostream>
@@ -103,6 +110,59 @@ inline void timsort(RandomAccessIterator const first, RandomAccessIterator const
 template <typename RandomAccessIterator, typename LessFunction>
 inline void timsort(RandomAccessIterator const first, RandomAccessIterator const last, LessFunction compare);
 
+/**
+ * Same as timsort(first, last, c), but choosing which runs to merge with the
+ * Powersort policy instead of Tim Peters' run-stack invariants.
+ */
+template <typename RandomAccessIterator, typename LessFunction>
+inline void powersort(RandomAccessIterator const first, RandomAccessIterator const last, LessFunction compare);
+
+/**
+ * Same as calling timsort(first, last, c) on each of the arrays of length
+ * elements that [first, last) is cut into, the last possibly shorter, but
+ * sharing the merge buffer and run stack between them.
+ */
+template <typename RandomAccessIterator, typename LessFunction>
+inline void timsort_batch(RandomAccessIterator const first, RandomAccessIterator const last,
+                          typename std::iterator_traits<RandomAccessIterator>::difference_type length,
+                          LessFunction compare);
+
+/**
+ * The merge buffer and run stack of a TimSort, kept from one sort to the next
+ * so that sorting again doesn't allocate them anew.  reserve(len) sizes them
+ * for sorting len elements up front.
+ */
+template <typename RandomAccessIterator> class timsort_arena;
+
+/**
+ * Same as timsort(first, last, c), but with the buffers of arena, which keep
+ * what they grew to for the next sort.
+ */
+template <typename RandomAccessIterator, typename LessFunction>
+inline void timsort(RandomAccessIterator const first, RandomAccessIterator const last, LessFunction compare,
+                    timsort_arena<RandomAccessIterator> &arena);
+
+/**
+ * Same as powersort(first, last, c), but with the buffers of arena.
+ */
+template <typename RandomAccessIterator, typename LessFunction>
+inline void powersort(RandomAccessIterator const first, RandomAccessIterator const last, LessFunction compare,
+                      timsort_arena<RandomAccessIterator> &arena);
+
+/**
+ * How the runs left on the stack are merged at the end, see
+ * SCP::final_merge_type.  With 'multiway' and Tim Peters' policy, new runs are
+ * also merged max_multiway_runs at a time with the loser tree, and the run-stack
+ * invariants only apply to the runs that come out of it.
+ */
+inline SCP::final_merge_type final_merge = SCP::final_merge_type::binary;
+
+/**
+ * Set from --warm-scratch.  Sorts that aren't handed an arena then use the
+ * calling thread's, see thread_arena(), instead of buffers of their own.
+ */
+inline bool pooled_scratch = false;
+
 // ---------------------------------------
 // Implementation
 // ---------------------------------------
@@ -138,9 +198,63 @@ template <typename Value, typename LessFunction> class Compare {
     func_type less_;
 };
 
+template <typename RandomAccessIterator>
+class timsort_arena {
+    typedef RandomAccessIterator iter_t;
+    typedef typename std::iterator_traits<iter_t>::value_type value_t;
+    typedef typename std::iterator_traits<iter_t>::difference_type diff_t;
+
+    struct run {
+        iter_t base;
+        diff_t len;
+        int power; // of the boundary with the next run, for Powersort
+
+        run(iter_t const b, diff_t const l) : base(b), len(l), power(0) {
+        }
+    };
+
+    // temp storage for merges, in huge pages with --pages
+    std::vector<value_t, SCP::huge_pages::allocator<value_t> > tmp_;
+    std::vector<run> pending_;
+
+    template <typename, typename, bool> friend class TimSort;
+
+  public:
+    void reserve(diff_t const len) {
+        // a multiway merge goes through the buffer as a whole, a binary one
+        // only copies out the shorter run
+        tmp_.reserve(final_merge == SCP::final_merge_type::multiway ? len : len / 2);
+        // Fibonacci-like run lengths keep Tim Peters' stack below 1.5 runs
+        // per bit of the length, and the Powersort one below one; 'multiway'
+        // leaves up to max_multiway_runs more on top
+        pending_.reserve(std::numeric_limits<diff_t>::digits * 3 / 2 + SCP::max_multiway_runs);
+    }
+};
+
+/**
+ * The calling thread's arena for sorting through RandomAccessIterator, which
+ * sorts use when pooled_scratch is set.  Shared by timsort(), powersort() and
+ * timsort_batch() whatever the comparison, and kept until the thread exits.
+ */
+template <typename RandomAccessIterator>
+inline timsort_arena<RandomAccessIterator> &thread_arena() {
+    static thread_local timsort_arena<RandomAccessIterator> arena;
+    return arena;
+}
+
+/*
+ * With Powersort set, merges are chosen by the "power" of each run boundary
+ * (Munro and Wild, "Nearly-Optimal Mergesorts", ESA 2018) instead of the
+ * run-stack invariants: the depth at which the boundary between the midpoints
+ * of two adjacent runs would sit in a perfectly balanced merge tree over the
+ * whole range.  Before pushing a new run, runs on the stack are merged as long
+ * as the boundary below the top run is deeper than the one between the top run
+ * and the new one.
+ */
 template <
   typename RandomAccessIterator,
-  typename LessFunction>
+  typename LessFunction,
+  bool Powersort = false>
 class TimSort {
     typedef RandomAccessIterator iter_t;
     typedef typename std::iterator_traits<iter_t>::value_type value_t;
@@ -156,62 +270,123 @@ class TimSort {
 
     int minGallop_; // default to MIN_GALLOP
 
-    std::vector<value_t> tmp_; // temp storage for merges
-    typedef typename std::vector<value_t>::iterator tmp_iter_t;
+    typedef timsort_arena<iter_t> arena_t;
 
-    struct run {
-        iter_t base;
-        diff_t len;
+    // temp storage for merges, in huge pages with --pages
+    std::vector<value_t, SCP::huge_pages::allocator<value_t> > tmp_;
+    typedef typename std::vector<value_t, SCP::huge_pages::allocator<value_t> >::iterator tmp_iter_t;
 
-        run(iter_t const b, diff_t const l) : base(b), len(l) {
-        }
-    };
+    typedef typename arena_t::run run;
     std::vector<run> pending_;
+    std::size_t unmerged_; // runs pushed since the last multiway merge
 
-    static void sort(iter_t const lo, iter_t const hi, compare_t c) {
-        assert(lo <= hi);
+    arena_t *arena_; // lent tmp_ and pending_, which go back to it when done
 
-        diff_t nRemaining = (hi - lo);
-        if (nRemaining < 2) {
-            return; // nothing to do
+    // the arena handed in, or else the thread's one with pooled_scratch
+    static arena_t *chooseArena(arena_t *const arena) {
+        if (arena != nullptr || !pooled_scratch) {
+            return arena;
         }
+        return &thread_arena<iter_t>();
+    }
+
+    static void sort(iter_t const lo, iter_t const hi, compare_t c, arena_t *const arena) {
+        assert(lo <= hi);
 
+        diff_t const nRemaining = (hi - lo);
         if (nRemaining < MIN_MERGE) {
-            diff_t const initRunLen = countRunAndMakeAscending(lo, hi, c);
-            GFX_TIMSORT_LOG("initRunLen: " << initRunLen);
-            binarySort(lo, hi, lo + initRunLen, c);
+            sortShort(lo, hi, c);
             return;
         }
 
-        TimSort ts(c);
-        diff_t const minRun = minRunLength(nRemaining);
+        TimSort ts(c, chooseArena(arena));
+        ts.sortRuns(lo, hi, minRunLength(nRemaining));
+    } // sort()
+
+    /*
+     * Sorts the arrays of length elements laid out one after the other from
+     * lo, the last of them possibly shorter, with one TimSort.  Its buffers
+     * keep their capacity from one array to the next, and minrun is only
+     * computed once.
+     */
+    static void sortBatch(iter_t lo, iter_t const hi, diff_t const length, compare_t c) {
+        assert(lo <= hi && length > 0);
+
+        TimSort ts(c, chooseArena(nullptr));
+        diff_t const minRun = minRunLength(length);
+        for (; hi - lo >= length; lo += length) {
+            if (length < MIN_MERGE) {
+                sortShort(lo, lo + length, c);
+            } else {
+                ts.sortRuns(lo, lo + length, minRun);
+            }
+        }
+        if (hi - lo < MIN_MERGE) {
+            sortShort(lo, hi, c);
+        } else {
+            ts.sortRuns(lo, hi, minRunLength(hi - lo));
+        }
+    }
+
+    static void sortShort(iter_t const lo, iter_t const hi, compare_t c) {
+        if (hi - lo < 2) {
+            return; // nothing to do
+        }
+
+        diff_t const initRunLen = countRunAndMakeAscending(lo, hi, c);
+        GFX_TIMSORT_LOG("initRunLen: " << initRunLen);
+        binarySort(lo, hi, lo + initRunLen, c);
+    }
+
+    void sortRuns(iter_t const lo, iter_t const hi, diff_t const minRun) {
+        // a previous sortRuns() leaves its one run behind
+        pending_.clear();
+        unmerged_ = 0;
+        minGallop_ = MIN_GALLOP;
+
+        diff_t nRemaining = (hi - lo);
         iter_t cur = lo;
         do {
-            diff_t runLen = countRunAndMakeAscending(cur, hi, c);
+            diff_t runLen = countRunAndMakeAscending(cur, hi, comp_);
 
             if (runLen < minRun) {
                 diff_t const force = std::min(nRemaining, minRun);
-                binarySort(cur, cur + force, cur + runLen, c);
+                binarySort(cur, cur + force, cur + runLen, comp_);
                 runLen = force;
             }
 
-            ts.pushRun(cur, runLen);
-            ts.mergeCollapse();
+            if (Powersort) {
+                mergePowerCollapse(cur - lo, runLen, hi - lo);
+                pushRun(cur, runLen);
+            } else {
+                pushRun(cur, runLen);
+                mergeCollapse();
+            }
 
             cur += runLen;
             nRemaining -= runLen;
         } while (nRemaining != 0);
 
         assert(cur == hi);
-        ts.mergeForceCollapse();
-        assert(ts.pending_.size() == 1);
+        if (Powersort) {
+            mergeTopCollapse();
+        } else {
+            mergeForceCollapse();
+        }
+        assert(pending_.size() == 1);
 
-        GFX_TIMSORT_LOG("size: " << (hi - lo) << " tmp_.size(): " << ts.tmp_.size()
-                                 << " pending_.size(): " << ts.pending_.size());
-    } // sort()
+        GFX_TIMSORT_LOG("size: " << (hi - lo) << " tmp_.size(): " << tmp_.size()
+                                 << " pending_.size(): " << pending_.size());
+    }
 
     static void binarySort(iter_t const lo, iter_t const hi, iter_t start, compare_t compare) {
         assert(lo <= start && start <= hi);
+        if (std::is_same<LessFunction, std::less<value_t> >::value && SCP::simd::network_sort(lo, hi)) {
+            return;
+        }
+        if (SCP::static_network::stable_network_sort(lo, hi, compare.less_function())) {
+            return;
+        }
         if (start == lo) {
             ++start;
         }
@@ -260,14 +435,39 @@ class TimSort {
         return n + r;
     }
 
-    TimSort(compare_t c) : comp_(c), minGallop_(MIN_GALLOP) {
+    TimSort(compare_t c, arena_t *const arena) : comp_(c), minGallop_(MIN_GALLOP), unmerged_(0), arena_(arena) {
+        if (arena_ != nullptr) {
+            tmp_.swap(arena_->tmp_);
+            pending_.swap(arena_->pending_);
+        }
+    }
+
+    ~TimSort() {
+        if (arena_ != nullptr) {
+            tmp_.clear();
+            pending_.clear();
+            tmp_.swap(arena_->tmp_);
+            pending_.swap(arena_->pending_);
+        }
     }
 
+    TimSort(const TimSort &) = delete;
+    TimSort &operator=(const TimSort &) = delete;
+
     void pushRun(iter_t const runBase, diff_t const runLen) {
         pending_.push_back(run(runBase, runLen));
     }
 
     void mergeCollapse() {
+        if (final_merge == SCP::final_merge_type::multiway) {
+            // merge new runs max_multiway_runs at a time, then resolve the
+            // invariants on the runs that come out of that
+            if (++unmerged_ < SCP::max_multiway_runs) {
+                return;
+            }
+            mergeTopMultiway(unmerged_, false);
+            unmerged_ = 0;
+        }
         while (pending_.size() > 1) {
             diff_t n = pending_.size() - 2;
 
@@ -285,7 +485,52 @@ class TimSort {
         }
     }
 
+    // Power of the boundary between [s1, s1 + n1) and [s1 + n1, s1 + n1 + n2)
+    // in a range of n elements: the first bit in which the binary fractions
+    // of the runs' midpoints over n differ.
+    static int nodePower(diff_t const s1, diff_t const n1, diff_t const n2, diff_t const n) {
+        diff_t a = 2 * s1 + n1;
+        diff_t b = a + n1 + n2;
+        int power = 0;
+        for (;;) {
+            ++power;
+            if (a >= n) {
+                a -= n;
+                b -= n;
+            } else if (b >= n) {
+                break;
+            }
+            a <<= 1;
+            b <<= 1;
+        }
+        return power;
+    }
+
+    // Called before pushing the run [runStart, runStart + runLen).
+    void mergePowerCollapse(diff_t const runStart, diff_t const runLen, diff_t const n) {
+        if (pending_.empty()) {
+            return;
+        }
+        int const power = nodePower(runStart - pending_.back().len, pending_.back().len, runLen, n);
+        while (pending_.size() > 1 && pending_[pending_.size() - 2].power > power) {
+            mergeAt(pending_.size() - 2);
+        }
+        pending_.back().power = power;
+    }
+
+    void mergeTopCollapse() {
+        if (mergeMultiwayCollapse()) {
+            return;
+        }
+        while (pending_.size() > 1) {
+            mergeAt(pending_.size() - 2);
+        }
+    }
+
     void mergeForceCollapse() {
+        if (mergeMultiwayCollapse()) {
+            return;
+        }
         while (pending_.size() > 1) {
             diff_t n = pending_.size() - 2;
 
@@ -296,6 +541,39 @@ class TimSort {
         }
     }
 
+    // Merges all pending runs in one pass with a loser tree, if final_merge
+    // asks for it, there are at least three of them and that's cheaper.
+    bool mergeMultiwayCollapse() {
+        if (final_merge != SCP::final_merge_type::multiway) {
+            return false;
+        }
+        while (pending_.size() > SCP::max_multiway_runs) {
+            mergeAt(pending_.size() - 2);
+        }
+        return pending_.size() > 2 && mergeTopMultiway(pending_.size(), true);
+    }
+
+    // Merges the top 'runs' pending runs in one pass with a loser tree.  With
+    // whenCheaper set, only if that takes no more comparisons than merging
+    // them two at a time from the top.  Returns whether they were merged.
+    bool mergeTopMultiway(std::size_t const runs, bool const whenCheaper) {
+        std::size_t const first = pending_.size() - runs;
+        iter_t const base = pending_[first].base;
+        std::size_t bounds[SCP::max_multiway_runs + 1];
+        for (std::size_t i = 0; i < runs; ++i) {
+            bounds[i] = pending_[first + i].base - base;
+        }
+        bounds[runs] = bounds[runs - 1] + pending_.back().len;
+        if (whenCheaper && !SCP::multiway_merge_pays_off(bounds, runs)) {
+            return false;
+        }
+        SCP::multiway_merge(base, bounds, runs, comp_.less_function(), tmp_);
+
+        pending_[first].len = bounds[runs];
+        pending_.erase(pending_.begin() + first + 1, pending_.end());
+        return true;
+    }
+
     void mergeAt(diff_t const i) {
         diff_t const stackSize = pending_.size();
         assert(stackSize >= 2);
@@ -356,6 +634,9 @@ class TimSort {
                 if (ofs <= 0) { // int overflow
                     ofs = maxOfs;
                 }
+                if (SCP::prefetch::enabled) {
+                    SCP::prefetch::gallop_probes(base + hint, ofs, maxOfs, 1);
+                }
             }
             if (ofs > maxOfs) {
                 ofs = maxOfs;
@@ -372,6 +653,9 @@ class TimSort {
                 if (ofs <= 0) {
                     ofs = maxOfs;
                 }
+                if (SCP::prefetch::enabled) {
+                    SCP::prefetch::gallop_probes(base + hint, ofs, maxOfs, -1);
+                }
             }
             if (ofs > maxOfs) {
                 ofs = maxOfs;
@@ -401,6 +685,9 @@ class TimSort {
                 if (ofs <= 0) {
                     ofs = maxOfs;
                 }
+                if (SCP::prefetch::enabled) {
+                    SCP::prefetch::gallop_probes(base + hint, ofs, maxOfs, -1);
+                }
             }
             if (ofs > maxOfs) {
                 ofs = maxOfs;
@@ -418,6 +705,9 @@ class TimSort {
                 if (ofs <= 0) { // int overflow
                     ofs = maxOfs;
                 }
+                if (SCP::prefetch::enabled) {
+                    SCP::prefetch::gallop_probes(base + hint, ofs, maxOfs, 1);
+                }
             }
             if (ofs > maxOfs) {
                 ofs = maxOfs;
@@ -452,6 +742,7 @@ class TimSort {
         }
 
         int minGallop(minGallop_);
+        bool const prefetching = SCP::prefetch::enabled;
 
         // outer:
         while (true) {
@@ -463,6 +754,9 @@ class TimSort {
                 assert(len1 > 1 && len2 > 0);
 
                 if (comp_.lt(*cursor2, *cursor1)) {
+                    if (prefetching) {
+                        SCP::prefetch::ahead(cursor2, cursor2 + len2);
+                    }
                     *(dest++) = GFX_TIMSORT_MOVE(*(cursor2++));
                     ++count2;
                     count1 = 0;
@@ -471,6 +765,9 @@ class TimSort {
                         break;
                     }
                 } else {
+                    if (prefetching) {
+                        SCP::prefetch::ahead(cursor1, cursor1 + len1);
+                    }
                     *(dest++) = GFX_TIMSORT_MOVE(*(cursor1++));
                     ++count1;
                     count2 = 0;
@@ -571,6 +868,7 @@ class TimSort {
         }
 
         int minGallop(minGallop_);
+        bool const prefetching = SCP::prefetch::enabled;
 
         // outer:
         while (true) {
@@ -582,6 +880,9 @@ class TimSort {
                 assert(len1 > 0 && len2 > 1);
 
                 if (comp_.lt(*cursor2, *cursor1)) {
+                    if (prefetching) {
+                        SCP::prefetch::behind(cursor1, cursor1 - (len1 - 1));
+                    }
                     *(dest--) = GFX_TIMSORT_MOVE(*(cursor1--));
                     ++count1;
                     count2 = 0;
@@ -590,6 +891,9 @@ class TimSort {
                         break;
                     }
                 } else {
+                    if (prefetching) {
+                        SCP::prefetch::behind(cursor2, cursor2 - (len2 - 1));
+                    }
                     *(dest--) = GFX_TIMSORT_MOVE(*(cursor2--));
                     ++count2;
                     count1 = 0;
@@ -674,8 +978,15 @@ class TimSort {
         GFX_TIMSORT_MOVE_RANGE(begin, begin + len, std::back_inserter(tmp_));
     }
 
-    // the only interface is the friend timsort() function
+    // the only interface is the friend timsort() and powersort() functions
     template <typename IterT, typename LessT> friend void timsort(IterT first, IterT last, LessT c);
+    template <typename IterT, typename LessT> friend void powersort(IterT first, IterT last, LessT c);
+    template <typename IterT, typename LessT>
+    friend void timsort(IterT first, IterT last, LessT c, timsort_arena<IterT> &arena);
+    template <typename IterT, typename LessT>
+    friend void powersort(IterT first, IterT last, LessT c, timsort_arena<IterT> &arena);
+    template <typename IterT, typename LessT>
+    friend void timsort_batch(IterT first, IterT last, typename std::iterator_traits<IterT>::difference_type length, LessT c);
 };
 
 template <typename RandomAccessIterator>
@@ -694,7 +1005,75 @@ timsort(
   RandomAccessIterator const last,
   LessFunction compare
 ){
-  TimSort<RandomAccessIterator, LessFunction>::sort(first, last, compare);
+  TimSort<RandomAccessIterator, LessFunction>::sort(first, last, compare, nullptr);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename LessFunction>
+inline
+void
+timsort(
+  RandomAccessIterator const first,
+  RandomAccessIterator const last,
+  LessFunction compare,
+  timsort_arena<RandomAccessIterator> &arena
+){
+  TimSort<RandomAccessIterator, LessFunction>::sort(first, last, compare, &arena);
+}
+
+template <typename RandomAccessIterator>
+inline void timsort_batch(RandomAccessIterator const first, RandomAccessIterator const last,
+                          typename std::iterator_traits<RandomAccessIterator>::difference_type const length) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type value_type;
+    timsort_batch(first, last, length, std::less<value_type>());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename LessFunction>
+inline
+void
+timsort_batch(
+  RandomAccessIterator const first,
+  RandomAccessIterator const last,
+  typename std::iterator_traits<RandomAccessIterator>::difference_type const length,
+  LessFunction compare
+){
+  TimSort<RandomAccessIterator, LessFunction>::sortBatch(first, last, length, compare);
+}
+
+template <typename RandomAccessIterator>
+inline void powersort(RandomAccessIterator const first, RandomAccessIterator const last) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type value_type;
+    powersort(first, last, std::less<value_type>());
+}
+
+template <
+  typename RandomAccessIterator,
+  typename LessFunction>
+inline
+void
+powersort(
+  RandomAccessIterator const first,
+  RandomAccessIterator const last,
+  LessFunction compare
+){
+  TimSort<RandomAccessIterator, LessFunction, true>::sort(first, last, compare, nullptr);
+}
+
+template <
+  typename RandomAccessIterator,
+  typename LessFunction>
+inline
+void
+powersort(
+  RandomAccessIterator const first,
+  RandomAccessIterator const last,
+  LessFunction compare,
+  timsort_arena<RandomAccessIterator> &arena
+){
+  TimSort<RandomAccessIterator, LessFunction, true>::sort(first, last, compare, &arena);
 }
 
 } // namespace gfx
@@ -856,7 +1235,9 @@ struct is_vector_iterator
   using _value_type = iterator_value_type_t<It>;
   static constexpr const bool value =
        std::is_same_v<It, typename std::vector<_value_type>::iterator>
-    or std::is_same_v<It, typename std::vector<_value_type>::const_iterator>;
+    or std::is_same_v<It, typename std::vector<_value_type>::const_iterator>
+    or std::is_same_v<It, typename SCP::huge_pages::vector<_value_type>::iterator>
+    or std::is_same_v<It, typename SCP::huge_pages::vector<_value_type>::const_iterator>;
 };
 
 template <class It>
@@ -1080,6 +1461,14 @@ struct timsort_stack_buffer
   {
     destroy_merge_buffer();
   }
+
+  /** Empties the run stack and merge buffer for another sort. */
+  void reset() noexcept(nothrow_destructor)
+  {
+    destroy_merge_buffer();
+    top = buffer + (buffer_size - 1);
+    push(0);
+  }
   timsort_stack_buffer(const self_t&) = delete;
   timsort_stack_buffer(self_t&&) = delete;
   timsort_stack_buffer& operator=(self_t&&) = delete;
@@ -1486,9 +1875,61 @@ struct timsort_stack_buffer
 
 
 namespace tim {
+
+/**
+ * Loop used by the linear phase of gallop_merge().
+ *   gallop      The original loop, with a data-dependent branch on every
+ *               comparison.
+ *   branchless  Picks each element with a conditional move and advances both
+ *               ranges by the result of the comparison, unrolled by
+ *               TIMSORT_BRANCHLESS_UNROLL steps.  Galloping starts once
+ *               min_gallop elements in a row came from one range, counted in
+ *               whole blocks, so skewed merges still gallop.  Only used for
+ *               scalar types; others always use 'gallop'.
+ *   simd        Merges a vector at a time with SCP::simd's bitonic merge
+ *               kernels, handing over to galloping the same way.  Only used
+ *               for signed 32 and 64 bit integers in contiguous storage,
+ *               sorted in ascending order, on CPUs with AVX2; others always
+ *               use 'gallop'.
+ *
+ * Defining TIMSORT_MERGE_KERNEL as 'gallop', 'branchless' or 'simd' fixes the
+ * kernel at compile time, otherwise it can be changed at runtime.
+ */
+enum class merge_kernel_type { gallop, branchless, simd };
+
+#ifdef TIMSORT_MERGE_KERNEL
+inline constexpr merge_kernel_type merge_kernel = merge_kernel_type::TIMSORT_MERGE_KERNEL;
+#else
+inline merge_kernel_type merge_kernel = merge_kernel_type::gallop;
+#endif
+
+/**
+ * How the runs left on the stack are merged at the end, see
+ * SCP::final_merge_type.  With 'multiway' and Tim Peters' policy, new runs are
+ * also merged max_multiway_runs at a time with the loser tree, and the run-stack
+ * invariants only apply to the runs that come out of it.
+ */
+inline SCP::final_merge_type final_merge = SCP::final_merge_type::binary;
+
+/**
+ * Set from --warm-scratch.  Sorts that aren't handed an arena then use the
+ * calling thread's, see thread_arena(), instead of a merge buffer of their own.
+ */
+inline bool pooled_scratch = false;
+
+#ifndef TIMSORT_BRANCHLESS_UNROLL
+# define TIMSORT_BRANCHLESS_UNROLL 4
+#endif
+
 namespace internal {
 
 
+/**
+ * Number of elements merged between checks in the branchless merge kernel.
+ */
+inline constexpr const std::ptrdiff_t branchless_unroll = TIMSORT_BRANCHLESS_UNROLL;
+static_assert(branchless_unroll > 0, "TIMSORT_BRANCHLESS_UNROLL must be positive");
+
 /**
  * Number of consecutive elements for which galloping would be a win over
  * either linear or binary search.
@@ -1530,7 +1971,9 @@ inline It gallop_upper_bound(It begin, It end, const T& value, Comp comp)
 {
   std::size_t i = 0;
   std::size_t len = end - begin;
-  for(; i < len and not comp(value, begin[i]); i = 2 * i + 1) { /* LOOP */ }
+  for(; i < len and not comp(value, begin[i]); i = 2 * i + 1)
+    if(SCP::prefetch::enabled)
+      SCP::prefetch::gallop_probes(begin, 2 * i + 1, len, 1);
 
   if(len > i)
     len = i;
@@ -1611,6 +2054,15 @@ template <class It, class Comp>
 void finish_insertion_sort(It begin, It mid, It end, Comp comp)
 {
   using value_type = iterator_value_type_t<It>;
+  if constexpr(   std::is_same_v<Comp, std::less<>>
+               or std::is_same_v<Comp, std::less<value_type>>
+               or std::is_same_v<Comp, DefaultComparator>)
+  {
+    if(SCP::simd::network_sort(begin, end))
+      return;
+    if(SCP::static_network::stable_network_sort(begin, end, std::less<value_type>()))
+      return;
+  }
   if constexpr(std::is_scalar_v<value_type>
          and (   std::is_same_v<Comp, std::less<>>
               or std::is_same_v<Comp, std::less<value_type>>
@@ -1657,7 +2109,61 @@ namespace internal {
 
 template <
   class It,
-  class Comp>
+  class Comp,
+  bool Powersort>
+struct TimSort;
+
+} /* namespace internal */
+
+
+/*
+* @brief The merge buffer of a TimSort, kept from one sort to the next so that
+* sorting again doesn't allocate it anew.  reserve(len) sizes it for sorting
+* len elements up front.  The run stack lives in the TimSort itself.
+*/
+template <
+  class It>
+class timsort_arena{
+  using value_type = internal::iterator_value_type_t<It>;
+
+  /** In huge pages with --pages. */
+  std::vector<value_type, SCP::huge_pages::allocator<value_type> > heap_buffer;
+
+  template <class, class, bool> friend struct internal::TimSort;
+
+public:
+  void
+  reserve(
+    std::size_t len
+  ){
+    // a multiway merge goes through the buffer as a whole, a binary one only
+    // copies out the shorter run
+    heap_buffer.reserve(final_merge == SCP::final_merge_type::multiway ? len : len / 2);
+  }
+};
+
+
+/*
+* @brief The calling thread's arena for sorting through It, which sorts use when
+* pooled_scratch is set.  Shared by timsort(), powersort() and timsort_batch()
+* whatever the comparison, and kept until the thread exits.
+*/
+template <
+  class It>
+timsort_arena<It> &
+thread_arena(
+){
+  static thread_local timsort_arena<It> arena;
+  return arena;
+}
+
+
+namespace internal {
+
+template <
+  class It,
+  class Comp,
+  bool Powersort = false>
 struct TimSort{
 /**
 * @brief Perform a timsort on the range [begin_it, end_it).
@@ -1670,18 +2176,71 @@ struct TimSort{
   TimSort(
     It begin_it,
     It end_it,
-    Comp comp_func
+    Comp comp_func,
+    timsort_arena<It> *arena_ptr = nullptr
+  ):
+    TimSort(comp_func, arena_ptr)
+  {
+    sort(begin_it, end_it, compute_minrun<value_type>(end_it - begin_it));
+  }
+
+
+/*Set up the buffers without sorting anything yet, for _timsort_batch() to
+* sort one array after another with.  The merge buffer is borrowed from
+* arena_ptr, if given, until the TimSort is destroyed.
+*/
+  explicit
+  TimSort(
+    Comp comp_func,
+    timsort_arena<It> *arena_ptr = nullptr
   ):
     stack_buffer{},
     heap_buffer{},
-    start(begin_it),
-    stop(end_it),
-    position(begin_it),
+    start{},
+    stop{},
+    position{},
     comp(comp_func),
-    minrun(compute_minrun<value_type>(end_it - begin_it)),
-    min_gallop(default_min_gallop)
+    minrun(0),
+    min_gallop(default_min_gallop),
+    arena(arena_ptr)
   {
-    fill_run_stack();
+    if(arena != nullptr)
+      heap_buffer.swap(arena->heap_buffer);
+  }
+
+
+  ~TimSort(
+  ){
+    if(arena != nullptr){
+      heap_buffer.clear();
+      heap_buffer.swap(arena->heap_buffer);
+    }
+  }
+
+
+  TimSort(const TimSort&) = delete;
+  TimSort& operator=(const TimSort&) = delete;
+
+
+/*Sort [begin_it, end_it) with runs of at least run_length, reusing the stack
+* and heap buffers of the previous sort.
+*/
+  void
+  sort(
+    It begin_it,
+    It end_it,
+    std::size_t run_length
+  ){
+    stack_buffer.reset();
+    start = begin_it;
+    stop = end_it;
+    position = begin_it;
+    minrun = run_length;
+    min_gallop = default_min_gallop;
+    if constexpr(Powersort)
+      fill_run_stack_by_power();
+    else
+      fill_run_stack();
     collapse_run_stack();
   }
 
@@ -1692,6 +2251,10 @@ struct TimSort{
   void
   fill_run_stack(
   ){
+    if(final_merge == SCP::final_merge_type::multiway){
+      fill_run_stack_multiway();
+      return;
+    }
     // push the first two runs on to the run stack, unless there's only one run.
     push_next_run();
     if(not (position < stop)) return;
@@ -1703,17 +2266,122 @@ struct TimSort{
     }
   }
 
+/*Same as fill_run_stack(), but new runs are merged max_multiway_runs at a time
+* in one pass with a loser tree, and the invariants are only resolved on the
+* runs that come out of it.  Those are max_multiway_runs times longer, so there
+* are that many fewer binary merges above them.  The runs still pending at the
+* end are left to collapse_run_stack().
+*/
+  void
+  fill_run_stack_multiway(
+  ){
+    std::size_t pending = 0;
+    while(position < stop){
+      push_next_run();
+      ++pending;
+      if(pending == SCP::max_multiway_runs
+         or stack_buffer.offset_count() == stack_buffer.buffer_size){
+        if(pending > 1)
+          merge_top_runs(pending, false);
+        pending = 0;
+        if(stack_buffer.run_count() > 1)
+          resolve_invariants();
+      }
+    }
+  }
+
+/*Powersort merge policy (Munro and Wild, "Nearly-Optimal Mergesorts", ESA
+* 2018).  Each boundary between two adjacent runs gets a "power": the depth at
+* which it would sit in a perfectly balanced merge tree over the whole range,
+* taken from the first bit in which the binary fractions of the two runs'
+* midpoints differ.  After each new run is pushed, the runs below it are merged
+* for as long as the boundary below the second-to-last run is deeper than the
+* one between it and the new run.  This keeps the powers on the stack strictly
+* increasing, so the stack never holds more than one run per bit of the length.
+*/
+  void
+  fill_run_stack_by_power(
+  ){
+    const std::size_t n = stop - start;
+    push_next_run();
+    while(position < stop){
+      push_next_run();
+      const int power = node_power(get_offset<2>(), get_offset<1>(), get_offset<0>(), n);
+      while(stack_buffer.run_count() > 2 and run_power[stack_buffer.run_count() - 3] > power)
+        merge_AB();
+      run_power[stack_buffer.run_count() - 2] = power;
+    }
+  }
+
+/*
+* @brief Power of the boundary between the runs [begin, mid) and [mid, end) in
+* a range of n elements.
+*/
+  static
+  int
+  node_power(
+    std::size_t begin,
+    std::size_t mid,
+    std::size_t end,
+    std::size_t n
+  ){
+    // twice the midpoints of the two runs
+    std::size_t a = begin + mid;
+    std::size_t b = mid + end;
+    int power = 0;
+    for(;;){
+      ++power;
+      if(a >= n){
+        a -= n;
+        b -= n;
+      }else if(b >= n){
+        break;
+      }
+      a <<= 1;
+      b <<= 1;
+    }
+    return power;
+  }
+
 /*Grand finale.  Keep merging the top 2 runs on the stack until there is only
-* one left.
+* one left, or merge them all at once if final_merge says so.
 */
   inline
   void
   collapse_run_stack(
   ){
+    if(final_merge == SCP::final_merge_type::multiway){
+      while(stack_buffer.run_count() > SCP::max_multiway_runs)
+        merge_BC();
+      if(const std::size_t runs = stack_buffer.run_count();
+         runs > 2 and merge_top_runs(runs, true))
+        return;
+    }
     for(auto count = stack_buffer.run_count() - 1; count > 0; --count)
       merge_BC();
   }
 
+/*Merge the top 'runs' runs on the stack in one pass with a loser tree.  With
+* 'when_cheaper' set, only if that takes no more comparisons than merging them
+* two at a time from the top.  Returns whether they were merged.
+*/
+  bool
+  merge_top_runs(
+    std::size_t runs,
+    bool when_cheaper
+  ){
+    // offsets from the bottom of the runs up
+    std::size_t bounds[SCP::max_multiway_runs + 1];
+    for(std::size_t i = 0; i <= runs; ++i)
+      bounds[i] = stack_buffer[runs - i];
+    if(when_cheaper and not SCP::multiway_merge_pays_off(bounds, runs))
+      return false;
+    SCP::multiway_merge(start, bounds, runs, comp, heap_buffer);
+    for(auto count = runs - 1; count > 0; --count)
+      stack_buffer.template remove_run<1>();
+    return true;
+  }
+
 /*Get the next run of already-sorted elements.  If the length of the natural run
 * is less than minrun, force it to size with an insertion sort.
 */
@@ -2050,7 +2718,104 @@ struct TimSort{
 //     'dest' is a contiguous iterator or that both 'DestIt' and 'LeftIt' are
 //     reverse contiguous iterators and ensuring that values being sorted are
 //     trivially copyable.
+//   - Merges of integer keys in contiguous storage can instead use a SIMD
+//     kernel for the linear mode.  It works the same way, except that wins are
+//     counted a vector at a time.
+    constexpr bool ascending_comp =    std::is_same_v<Comp, std::less<>>
+                                    or std::is_same_v<Comp, std::less<value_type>>
+                                    or std::is_same_v<Comp, DefaultComparator>;
+    constexpr bool simd_forward =  SCP::simd::mergeable_v<value_type>
+                               and ascending_comp
+                               and std::is_same_v<Cmp, Comp>
+                               and can_forward_memcpy_v<LeftIt>
+                               and can_forward_memcpy_v<RightIt>
+                               and can_forward_memcpy_v<DestIt>;
+    constexpr bool simd_backward =  SCP::simd::mergeable_v<value_type>
+                                and ascending_comp
+                                and not std::is_same_v<Cmp, Comp>
+                                and can_reverse_memcpy_v<LeftIt>
+                                and can_reverse_memcpy_v<RightIt>
+                                and can_reverse_memcpy_v<DestIt>;
     for(std::size_t num_galloped=0, lcount=0, rcount=0 ; ;){
+      // SIMD LINEAR SEARCH MODE
+      // merge a vector at a time until one range has been winning for
+      // 'min_gallop' elements, or there's less than a vector left.  Reverse
+      // iterators are handed to the kernel as ranges running down through
+      // memory.
+      if constexpr(simd_forward or simd_backward){
+        using Key = std::conditional_t<sizeof(value_type) == 4, std::int32_t, std::int64_t>;
+        const auto kernels = SCP::simd::merge_kernels<Key>();
+        if(merge_kernel == merge_kernel_type::simd and kernels.forward != nullptr){
+          SCP::simd::merge_stop stop;
+          std::ptrdiff_t lmerged, rmerged;
+          if constexpr(simd_forward){
+            const Key *l = reinterpret_cast<const Key*>(get_memcpy_iterator(lbegin));
+            const Key *r = reinterpret_cast<const Key*>(get_memcpy_iterator(rbegin));
+            Key *d = reinterpret_cast<Key*>(get_memcpy_iterator(dest));
+            const Key *l_start = l, *r_start = r;
+            stop = kernels.forward(l, l + (lend - lbegin), r, r + (rend - rbegin), d, min_gallop);
+            lmerged = l - l_start;
+            rmerged = r - r_start;
+          }else{
+            const Key *l_end = reinterpret_cast<const Key*>(get_memcpy_iterator(lbegin)) + 1;
+            const Key *r_end = reinterpret_cast<const Key*>(get_memcpy_iterator(rbegin)) + 1;
+            Key *d_end = reinterpret_cast<Key*>(get_memcpy_iterator(dest)) + 1;
+            const Key *l_start = l_end, *r_start = r_end;
+            stop = kernels.backward(l_end - (lend - lbegin), l_end, r_end - (rend - rbegin), r_end, d_end, min_gallop);
+            lmerged = l_start - l_end;
+            rmerged = r_start - r_end;
+          }
+          lbegin += lmerged;
+          rbegin += rmerged;
+          dest += lmerged + rmerged;
+          if(not (rbegin < rend)){
+            move_or_memcpy(lbegin, lend, dest);
+            return;
+          }
+          num_galloped = 0;
+          if(stop == SCP::simd::merge_b_winning)
+            goto gallop_right;
+          if(stop == SCP::simd::merge_a_winning)
+            goto gallop_left;
+        }
+      }
+      // BRANCHLESS LINEAR SEARCH MODE
+      // same as the linear mode below, but without branching on the result of
+      // each comparison.  Blocks of 'branchless_unroll' elements are merged
+      // without checks whenever the right range can't run out in one.
+      if constexpr(std::is_scalar_v<value_type>){
+        if(merge_kernel == merge_kernel_type::branchless){
+          auto step = [&](){
+            const bool take_right = cmp(*rbegin, *lbegin);
+            *dest = take_right ? *rbegin : *lbegin;
+            ++dest;
+            rbegin += take_right;
+            lbegin += not take_right;
+          };
+          // rather than counting wins one by one, count the blocks that were
+          // taken entirely from one range.
+          for(lcount=0, rcount=0, num_galloped=0;;){
+            if(rend - rbegin > branchless_unroll){
+              const auto rstart = rbegin;
+              for(std::ptrdiff_t i = 0; i < branchless_unroll; ++i)
+                step();
+              const auto taken = rbegin - rstart;
+              rcount = taken == branchless_unroll ? rcount + taken : 0;
+              lcount = taken == 0 ? lcount + branchless_unroll : 0;
+              if(rcount >= min_gallop)
+                goto gallop_right;
+              if(lcount >= min_gallop)
+                goto gallop_left;
+            }else{
+              step();
+              if(not (rbegin < rend)){
+                move_or_memcpy(lbegin, lend, dest);
+                return;
+              }
+            }
+          }
+        }
+      }
       // LINEAR SEARCH MODE
       // do a naive merge until evidence shows that galloping may be faster.
 
@@ -2059,6 +2824,8 @@ struct TimSort{
       // left range and we should count that towards lcount here.
       for(lcount=(num_galloped > 0), rcount=0, num_galloped=0;;){
         if(cmp(*rbegin, *lbegin)){
+          if(SCP::prefetch::enabled)
+            SCP::prefetch::ahead(rbegin, rend);
           // move from the right-hand-side
           *dest = std::move(*rbegin);
           ++dest;
@@ -2072,6 +2839,8 @@ struct TimSort{
             goto gallop_right; // continue this run in galloping mode
           lcount = 0;
         }else{
+          if(SCP::prefetch::enabled)
+            SCP::prefetch::ahead(lbegin, lend);
           // move from the left-hand side
           *dest = std::move(*lbegin);
           ++dest;
@@ -2095,8 +2864,11 @@ struct TimSort{
           gallop_left: // when jumping here from the linear merge loop, num_galloped is set to zero
         lcount = lend - lbegin;
         // gallop through the left range
-        while((num_galloped < lcount) and not cmp(*rbegin, lbegin[num_galloped]))
+        while((num_galloped < lcount) and not cmp(*rbegin, lbegin[num_galloped])){
           num_galloped = 2 * num_galloped + 1;
+          if(SCP::prefetch::enabled)
+            SCP::prefetch::gallop_probes(lbegin, num_galloped, lcount, 1);
+        }
         if(lcount > num_galloped)
           lcount = num_galloped;
         // do a binary search in the narrowed-down region
@@ -2110,8 +2882,11 @@ struct TimSort{
           gallop_right: // when jumping here from the linear merge loop, num_galloped is set to zero
         rcount = rend - rbegin;
         // gallop through the right range
-        while((num_galloped < rcount) and cmp(rbegin[num_galloped], *lbegin))
+        while((num_galloped < rcount) and cmp(rbegin[num_galloped], *lbegin)){
           num_galloped = 2 * num_galloped + 1;
+          if(SCP::prefetch::enabled)
+            SCP::prefetch::gallop_probes(rbegin, num_galloped, rcount, 1);
+        }
         if(rcount > num_galloped)
            rcount = num_galloped;
         // do a binary search in the narrowed-down region
@@ -2141,12 +2916,13 @@ struct TimSort{
 * merge buffer when possible.
 */
   timsort_stack_buffer<std::size_t, value_type> stack_buffer;
-  /** Fallback heap-allocated array used for merge buffer. */
-  std::vector<value_type> heap_buffer;
+  /** Fallback heap-allocated array used for merge buffer, in huge pages with
+   * --pages. */
+  std::vector<value_type, SCP::huge_pages::allocator<value_type> > heap_buffer;
   /** 'begin' iterator to the range being sorted. */
-  const It start;
+  It start;
   /** 'end' iterator to the range being sorted. */
-  const It stop;
+  It stop;
 /*Iterator to keep track of how far we've scanned into the range to be sorted.
 * [start, position) contains already-found runs while [position, stop) is still
 * untouched.  When position == end, the run stack is collapsed.
@@ -2155,28 +2931,80 @@ struct TimSort{
   /** Comparator used to sort the range. */
   Comp comp;
   /** Minimum length of a run */
-  const std::size_t minrun;
+  std::size_t minrun;
   /**
    * Minimum number of consecutive elements for which one side of the
    * merge must "win" in a row before switching from galloping mode to
    * linear mode.
    */
   std::size_t min_gallop = default_min_gallop;
+  /** Arena heap_buffer was borrowed from, and goes back to, if any. */
+  timsort_arena<It> *arena;
+/*Powers of the boundaries between adjacent runs on the stack, bottom first,
+* for the Powersort merge policy.  They strictly increase up the stack, so
+* there is at most one per bit of the range's length.
+*/
+  int run_power[Powersort ? std::numeric_limits<std::size_t>::digits + 1 : 1];
 
   static constexpr const std::size_t default_min_gallop = gallop_win_dist;
 };
 
 
+/*
+* @brief The arena handed in, or else the thread's one with pooled_scratch.
+*/
+template <
+  class It>
+timsort_arena<It> *
+choose_arena(
+  timsort_arena<It> *arena
+){
+  if(arena != nullptr || !pooled_scratch)
+    return arena;
+  return &thread_arena<It>();
+}
+
+
 template <
   class It,
-  class Comp>
+  class Comp,
+  bool Powersort = false>
 static
 void
-_timsort(It begin, It end, Comp comp){
+_timsort(It begin, It end, Comp comp, timsort_arena<It> *arena = nullptr){
   using value_type = iterator_value_type_t<It>;
   std::size_t len = end - begin;
   if(len > max_minrun<value_type>())
-    TimSort<It, Comp>(begin, end, comp);
+    TimSort<It, Comp, Powersort>(begin, end, comp, choose_arena(arena));
+  else
+    finish_insertion_sort(begin, begin + (end > begin), end, comp);
+}
+
+
+/*
+* @brief _timsort() on each of the arrays of 'length' elements laid out one
+* after the other in [begin, end), the last possibly shorter, with one TimSort
+* and minrun computed once.
+*/
+template <
+  class It,
+  class Comp>
+static
+void
+_timsort_batch(It begin, It end, std::size_t length, Comp comp){
+  using value_type = iterator_value_type_t<It>;
+  if(length <= max_minrun<value_type>()){
+    for(; std::size_t(end - begin) > length; begin += length)
+      finish_insertion_sort(begin, begin + 1, begin + length, comp);
+    finish_insertion_sort(begin, begin + (end > begin), end, comp);
+    return;
+  }
+  TimSort<It, Comp> sorter(comp, choose_arena<It>(nullptr));
+  const std::size_t minrun = compute_minrun<value_type>(length);
+  for(; std::size_t(end - begin) > length; begin += length)
+    sorter.sort(begin, begin + length, minrun);
+  if(std::size_t len = end - begin; len > max_minrun<value_type>())
+    sorter.sort(begin, end, compute_minrun<value_type>(len));
   else
     finish_insertion_sort(begin, begin + (end > begin), end, comp);
 }
@@ -2207,6 +3035,100 @@ timsort(
   timsort(begin, end, tim::internal::DefaultComparator{});
 }
 
+
+/*
+* @brief Same as tim::timsort(), but with the merge buffer of arena, which keeps
+* what it grew to for the next sort.
+*/
+template <
+  class It,
+  class Comp>
+void
+timsort(
+  It begin,
+  It end,
+  Comp comp,
+  timsort_arena<It> &arena
+){
+  internal::_timsort(begin, end, comp, &arena);
+}
+
+
+/*
+* @brief Same as tim::timsort() on each of the arrays of 'length' elements that
+* [begin, end) is cut into, the last possibly shorter, but sharing the run
+* stack and merge buffer between them.
+*/
+template <
+  class It,
+  class Comp>
+void
+timsort_batch(
+  It begin,
+  It end,
+  std::size_t length,
+  Comp comp
+){
+  internal::_timsort_batch(begin, end, length, comp);
+}
+
+
+template <
+  class It>
+void
+timsort_batch(
+  It begin,
+  It end,
+  std::size_t length
+){
+  timsort_batch(begin, end, length, tim::internal::DefaultComparator{});
+}
+
+
+/*
+* @brief Same as tim::timsort(), but merging runs with the Powersort policy
+* instead of Tim Peters' run-stack invariants.
+*/
+template <
+  class It,
+  class Comp>
+void
+powersort(
+  It begin,
+  It end,
+  Comp comp
+){
+  internal::_timsort<It, Comp, true>(begin, end, comp);
+}
+
+
+template <
+  class It>
+void
+powersort(
+  It begin,
+  It end
+){
+  powersort(begin, end, tim::internal::DefaultComparator{});
+}
+
+
+/*
+* @brief Same as tim::powersort(), but with the merge buffer of arena.
+*/
+template <
+  class It,
+  class Comp>
+void
+powersort(
+  It begin,
+  It end,
+  Comp comp,
+  timsort_arena<It> &arena
+){
+  internal::_timsort<It, Comp, true>(begin, end, comp, &arena);
+}
+
 } /* namespace tim */
 
 
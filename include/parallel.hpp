@@ -0,0 +1,189 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief Small threading helpers shared by the parallel sorts.
+
+Sorts are handed out as plain function pointers by get_sort_func_ptr(), so the
+thread count can't be passed as an argument.  Instead it is set once from the
+command line in SCP::parallel::thread_count before any sort runs.
+*******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace SCP{
+namespace parallel{
+
+/// Number of threads the parallel sorts may use.  0 means one per hardware
+/// thread.
+inline std::size_t thread_count = 0;
+
+
+inline
+std::size_t
+get_thread_count(
+){
+  if(thread_count != 0) return thread_count;
+  std::size_t hardware = std::thread::hardware_concurrency();
+  return hardware != 0 ? hardware : 1;
+}
+
+
+/// Runs fn(thread_id) for every thread_id in [0, num_threads) concurrently and
+/// waits for all of them.  The calling thread does the work of thread 0.
+template<
+  typename Function>
+void
+run_team(
+  std::size_t num_threads,
+  Function fn
+){
+  std::vector<std::thread> team;
+  team.reserve(num_threads - 1);
+  for(std::size_t id = 1; id < num_threads; id++)
+    team.emplace_back(fn, id);
+  fn(std::size_t(0));
+  for(std::thread &member : team)
+    member.join();
+}
+
+
+/*******************************************************************************
+A pool of workers, each with its own deque of tasks.  A worker pushes and pops
+tasks at the back of its own deque, so it keeps working on the most recently
+split, cache-warm subproblem, while idle workers steal from the front of other
+deques, taking the oldest and therefore usually largest tasks.
+
+The deques are guarded by a lock each rather than being lock-free.  Tasks are
+expected to be coarse (thousands of elements), which keeps contention on them
+negligible.
+*******************************************************************************/
+template<
+  typename Task>
+class work_stealing_pool{
+public:
+
+  work_stealing_pool(
+    std::size_t num_workers
+  ) : queues(num_workers), pending(0) {
+    for(std::unique_ptr<worker_queue> &queue : queues)
+      queue.reset(new worker_queue());
+  }
+
+
+  std::size_t
+  size(
+  ) const {
+    return queues.size();
+  }
+
+
+  /// Makes a task available.  May be called by the task processing function
+  /// of the given worker, or before run() to seed the pool.
+  void
+  push(
+    std::size_t worker,
+    Task task
+  ){
+    pending.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(queues[worker]->lock);
+    queues[worker]->tasks.push_back(std::move(task));
+  }
+
+
+  /// Calls process(worker, task) for every task, including the ones pushed
+  /// while processing, and returns once all of them are done.
+  template<
+    typename Function>
+  void
+  run(
+    Function process
+  ){
+    run_team(queues.size(), [&](std::size_t worker){
+      Task task;
+      while(true){
+        if(pop(worker, task) || steal(worker, task)){
+          process(worker, task);
+          pending.fetch_sub(1, std::memory_order_acq_rel);
+        }else if(pending.load(std::memory_order_acquire) == 0){
+          return;
+        }else{
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+private:
+
+  struct alignas(64) worker_queue{
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+
+  bool
+  pop(
+    std::size_t worker,
+    Task &task
+  ){
+    std::lock_guard<std::mutex> guard(queues[worker]->lock);
+    if(queues[worker]->tasks.empty()) return false;
+    task = std::move(queues[worker]->tasks.back());
+    queues[worker]->tasks.pop_back();
+    return true;
+  }
+
+
+  bool
+  steal(
+    std::size_t thief,
+    Task &task
+  ){
+    for(std::size_t i = 1; i < queues.size(); i++){
+      worker_queue &victim = *queues[(thief + i) % queues.size()];
+      std::lock_guard<std::mutex> guard(victim.lock);
+      if(victim.tasks.empty()) continue;
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+
+  std::vector<std::unique_ptr<worker_queue> > queues;
+  // Tasks pushed but not yet fully processed.  A task's children are pushed
+  // before it is counted as done, so this only reaches 0 at the very end.
+  std::atomic<std::size_t> pending;
+};
+
+};
+};
@@ -0,0 +1,154 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief SCP::introsort run on a work-stealing pool.
+
+Each task is a subrange together with the depth limit it has left.  A task keeps
+partitioning its range the same way SCP::introsort_loop() does, but instead of
+recursing on the right half it pushes it as a new task whenever it is larger
+than the grain size, where an idle worker can steal it.  Subranges at or below
+the grain size are sorted sequentially with SCP::introsort_loop() and finished
+with SCP::final_insertion_sort().  The depth limit travels with each task, so
+the heapsort fallback applies exactly as it does in the sequential version.
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+#include "introsort.hpp"
+#include "parallel.hpp"
+
+
+namespace SCP{
+
+/// Subranges at or below this many elements are not split into further tasks.
+enum { _S_parallel_grain = 1 << 13 };
+
+
+/// A subrange left to sort, and how many partition steps it may still take
+/// before falling back to heapsort.
+template<
+  typename _RandomAccessIterator>
+struct introsort_task{
+  _RandomAccessIterator __first;
+  _RandomAccessIterator __last;
+  long __depth_limit;
+};
+
+
+/// This is a helper function for the parallel sort routine.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+parallel_introsort_loop(
+  parallel::work_stealing_pool<introsort_task<_RandomAccessIterator> > &__pool,
+  std::size_t __worker,
+  introsort_task<_RandomAccessIterator> __task,
+  _Compare __comp
+){
+  _RandomAccessIterator __first = __task.__first;
+  _RandomAccessIterator __last = __task.__last;
+  long __depth_limit = __task.__depth_limit;
+
+  while (__last - __first > int(_S_parallel_grain)){
+    if (__depth_limit == 0){
+      heapsort_impl(__first, __last, __comp);
+      return;
+    }
+    --__depth_limit;
+    _RandomAccessIterator __cut = unguarded_partition_pivot(__first, __last, __comp);
+    __pool.push(__worker, {__cut, __last, __depth_limit});
+    __last = __cut;
+  }
+
+  introsort_loop(__first, __last, __depth_limit, __comp);
+  if (!network_leaves<_RandomAccessIterator, _Compare>())
+    final_insertion_sort(__first, __last, __comp);
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+parallel_sort_impl(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first == __last)
+    return;
+
+  parallel::work_stealing_pool<introsort_task<_RandomAccessIterator> >
+    __pool(parallel::get_thread_count());
+  __pool.push(0, {__first, __last, long(std::__lg(__last - __first) * 2)});
+  __pool.run([&](std::size_t __worker, introsort_task<_RandomAccessIterator> __task){
+    parallel_introsort_loop(__pool, __worker, __task, __comp);
+  });
+}
+
+
+/**
+*  @brief Sort the elements of a sequence in parallel.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  Same result as SCP::introsort(), using up to SCP::parallel::thread_count
+*  threads.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+parallel_introsort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  parallel_sort_impl(__first, __last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+/**
+*  @brief Sort the elements of a sequence in parallel using a predicate for
+*  comparison.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __comp    A comparison functor.
+*  @return  Nothing.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+parallel_introsort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  parallel_sort_impl(__first, __last, __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+};
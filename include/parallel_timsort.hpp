@@ -0,0 +1,369 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief A stable, parallel timsort.
+
+The range is cut into one chunk per thread and each thread finds the natural
+runs in its chunk, reversing strictly descending runs and extending short runs
+to minrun with a binary insertion sort, just like the sequential timsorts.  Run
+boundaries that fall on a chunk edge are then dropped wherever the two runs
+already connect in order, so presorted data spanning chunks stays one run.
+
+The runs are merged pairwise in rounds, ping-ponging between the input and a
+buffer of the same size.  Each round splits the total output evenly between the
+threads, regardless of how big the individual run pairs are, by co-ranking
+(merge path): for an output position k of a pair it finds how many of the first
+k merged elements came from the left run with a binary search.  Every thread
+stays busy in every round, including the last one which is a single merge.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+
+
+namespace SCP{
+namespace ptim{
+
+enum{
+  // Same role as gfx::TimSort::MIN_MERGE.
+  min_merge = 32,
+  // Chunks smaller than this aren't worth a thread.
+  min_chunk_size = 1 << 14
+};
+
+
+inline
+std::size_t
+min_run_length(
+  std::size_t n
+){
+  std::size_t r = 0;
+  while(n >= min_merge){
+    r |= (n & 1);
+    n >>= 1;
+  }
+  return n + r;
+}
+
+
+/// Binary insertion sort of [lo, hi) where [lo, start) is already sorted.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+void
+binary_insertion_sort(
+  RandomAccessIterator lo,
+  RandomAccessIterator hi,
+  RandomAccessIterator start,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if(start == lo) ++start;
+  for(; start < hi; ++start){
+    T pivot = std::move(*start);
+    RandomAccessIterator pos = std::upper_bound(lo, start, pivot, comp);
+    std::move_backward(pos, start, start + 1);
+    *pos = std::move(pivot);
+  }
+}
+
+
+/// Length of the run starting at lo, made ascending if it was strictly
+/// descending.  Requires lo < hi.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+std::size_t
+count_run_and_make_ascending(
+  RandomAccessIterator lo,
+  RandomAccessIterator hi,
+  Compare comp
+){
+  RandomAccessIterator run_hi = lo + 1;
+  if(run_hi == hi) return 1;
+
+  if(comp(*(run_hi++), *lo)){
+    while(run_hi < hi && comp(*run_hi, *(run_hi - 1))) ++run_hi;
+    std::reverse(lo, run_hi);
+  }else{
+    while(run_hi < hi && !comp(*run_hi, *(run_hi - 1))) ++run_hi;
+  }
+  return run_hi - lo;
+}
+
+
+/// Appends the end offsets (relative to 'base') of the runs in [lo, hi) to
+/// 'ends', forcing runs shorter than min_run up to that length.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+void
+find_runs(
+  RandomAccessIterator base,
+  RandomAccessIterator lo,
+  RandomAccessIterator hi,
+  std::size_t min_run,
+  Compare comp,
+  std::vector<std::size_t> &ends
+){
+  while(lo < hi){
+    std::size_t remaining = hi - lo;
+    std::size_t run_length = count_run_and_make_ascending(lo, hi, comp);
+    if(run_length < min_run){
+      std::size_t force = std::min(remaining, min_run);
+      binary_insertion_sort(lo, lo + force, lo + run_length, comp);
+      run_length = force;
+    }
+    lo += run_length;
+    ends.push_back(lo - base);
+  }
+}
+
+
+/// Number of elements among the first k of the stable merge of left[0, nl)
+/// and right[0, nr) which come from the left.
+template<
+  typename LeftIterator,
+  typename RightIterator,
+  typename Compare>
+std::size_t
+co_rank(
+  std::size_t k,
+  LeftIterator left,
+  std::size_t nl,
+  RightIterator right,
+  std::size_t nr,
+  Compare comp
+){
+  std::size_t lo = k > nr ? k - nr : 0;
+  std::size_t hi = std::min(k, nl);
+  // Find the largest i with left[i - 1] not after right[k - i].
+  while(lo < hi){
+    std::size_t i = lo + (hi - lo + 1) / 2;
+    std::size_t j = k - i;
+    if(j == nr || !comp(right[j], left[i - 1]))
+      lo = i;
+    else
+      hi = i - 1;
+  }
+  return lo;
+}
+
+
+/// Plain stable merge, moving the elements into 'out'.
+template<
+  typename LeftIterator,
+  typename RightIterator,
+  typename OutputIterator,
+  typename Compare>
+OutputIterator
+move_merge(
+  LeftIterator lbegin,
+  LeftIterator lend,
+  RightIterator rbegin,
+  RightIterator rend,
+  OutputIterator out,
+  Compare comp
+){
+  while(lbegin != lend && rbegin != rend){
+    if(comp(*rbegin, *lbegin)){
+      *out = std::move(*rbegin);
+      ++rbegin;
+    }else{
+      *out = std::move(*lbegin);
+      ++lbegin;
+    }
+    ++out;
+  }
+  out = std::move(lbegin, lend, out);
+  return std::move(rbegin, rend, out);
+}
+
+
+/// One round of pairwise merges from 'in' to 'out' using all threads.  'ends'
+/// holds the end offsets of the runs and is updated to those of the merged
+/// runs.
+template<
+  typename InputIterator,
+  typename OutputIterator,
+  typename Compare>
+void
+merge_round(
+  InputIterator in,
+  OutputIterator out,
+  std::size_t length,
+  std::vector<std::size_t> &ends,
+  std::size_t num_threads,
+  Compare comp
+){
+  std::vector<std::size_t> merged_ends;
+  merged_ends.reserve(ends.size() / 2 + 1);
+  for(std::size_t i = 1; i < ends.size(); i += 2)
+    merged_ends.push_back(ends[i]);
+  if(ends.size() % 2 != 0)
+    merged_ends.push_back(ends.back());
+
+  parallel::run_team(num_threads, [&](std::size_t id){
+    std::size_t lo = length * id / num_threads;
+    std::size_t hi = length * (id + 1) / num_threads;
+
+    // Locate the first merged run overlapping [lo, hi).
+    std::size_t pair = std::upper_bound(merged_ends.begin(), merged_ends.end(), lo)
+                     - merged_ends.begin();
+    for(; pair < merged_ends.size() && lo < hi; pair++){
+      std::size_t pair_begin = pair == 0 ? 0 : merged_ends[pair - 1];
+      std::size_t pair_end = merged_ends[pair];
+      std::size_t mid = 2 * pair + 1 < ends.size() ? ends[2 * pair] : pair_end;
+
+      InputIterator left = in + pair_begin;
+      InputIterator right = in + mid;
+      std::size_t nl = mid - pair_begin;
+      std::size_t nr = pair_end - mid;
+
+      std::size_t k_begin = lo - pair_begin;
+      std::size_t k_end = std::min(hi, pair_end) - pair_begin;
+      std::size_t i_begin = co_rank(k_begin, left, nl, right, nr, comp);
+      std::size_t i_end = co_rank(k_end, left, nl, right, nr, comp);
+
+      move_merge(left + i_begin, left + i_end,
+                 right + (k_begin - i_begin), right + (k_end - i_end),
+                 out + lo, comp);
+      lo = std::min(hi, pair_end);
+    }
+  });
+
+  ends.swap(merged_ends);
+}
+
+
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+void
+sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  std::size_t length = last - first;
+  if(length < 2) return;
+
+  std::size_t num_threads = std::min(parallel::get_thread_count(),
+                                     std::max<std::size_t>(1, length / min_chunk_size));
+  std::size_t min_run = min_run_length(length);
+
+  // Find runs in every chunk in parallel.
+  std::vector<std::vector<std::size_t> > chunk_ends(num_threads);
+  parallel::run_team(num_threads, [&](std::size_t id){
+    RandomAccessIterator lo = first + length * id / num_threads;
+    RandomAccessIterator hi = first + length * (id + 1) / num_threads;
+    find_runs(first, lo, hi, min_run, comp, chunk_ends[id]);
+  });
+
+  // Stitch chunk edges: a boundary is only kept if the runs on either side of
+  // it are out of order.
+  std::vector<std::size_t> ends;
+  for(std::size_t id = 0; id < num_threads; id++){
+    for(std::size_t end : chunk_ends[id]){
+      bool chunk_edge = end == chunk_ends[id].back() && id + 1 < num_threads;
+      if(chunk_edge && !comp(first[end], first[end - 1]))
+        continue;
+      ends.push_back(end);
+    }
+  }
+  if(ends.size() == 1) return;
+
+  std::vector<T> buffer(length);
+  bool in_buffer = false;
+  while(ends.size() > 1){
+    if(in_buffer)
+      merge_round(buffer.begin(), first, length, ends, num_threads, comp);
+    else
+      merge_round(first, buffer.begin(), length, ends, num_threads, comp);
+    in_buffer = !in_buffer;
+  }
+
+  if(in_buffer){
+    parallel::run_team(num_threads, [&](std::size_t id){
+      std::size_t lo = length * id / num_threads;
+      std::size_t hi = length * (id + 1) / num_threads;
+      std::move(buffer.begin() + lo, buffer.begin() + hi, first + lo);
+    });
+  }
+}
+
+};
+
+
+/**
+*  @brief Stable parallel sort of a sequence using a predicate for comparison.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @param  comp    A comparison functor.
+*  @return  Nothing.
+*
+*  Uses up to SCP::parallel::thread_count threads and a buffer of
+*  @p last - @p first elements.
+*/
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+parallel_timsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  ptim::sort(first, last, comp);
+}
+
+
+/**
+*  @brief Stable parallel sort of a sequence.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @return  Nothing.
+*/
+template<
+  typename RandomAccessIterator>
+inline
+void
+parallel_timsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  ptim::sort(first, last, std::less<T>());
+}
+
+};
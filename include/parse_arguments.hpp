@@ -23,6 +23,7 @@ with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <argp.h>
+#include <climits>
 #include <iostream>
 #include <cstring>
 
@@ -35,10 +36,23 @@ enum sort_type{
   undefined_sort,
   std_sort,
   std_stable_sort,
+  block_merge_sort,
   introsort,
+  heapsort,
+  simd_introsort,
+  dual_pivot_quicksort,
+  static_network,
+  parallel_introsort,
   sequential_timsort,
+  parallel_timsort,
+  parallel_samplesort,
   gfx_timsort,
   tvs_timsort,
+  gfx_powersort,
+  tvs_powersort,
+  pdqsort,
+  radix_sort,
+  auto_,
   null
 };
 
@@ -53,6 +67,62 @@ enum sort_test_type{
 };
 
 
+enum small_sort_type{
+  undefined_small_sort,
+  insertion_small_sort,
+  network_small_sort,
+  static_network_small_sort
+};
+
+
+enum page_kind{
+  undefined_pages,
+  small_pages,
+  transparent_huge_pages,
+  hugetlbfs_pages
+};
+
+
+enum merge_kernel_type{
+  undefined_merge_kernel,
+  gallop_merge_kernel,
+  branchless_merge_kernel,
+  simd_merge_kernel
+};
+
+
+enum final_merge_kind{
+  undefined_final_merge,
+  binary_final_merge,
+  multiway_final_merge
+};
+
+
+enum run_mode{
+  undefined_mode,
+  sort_mode,
+  partial_mode,
+  select_mode,
+  append_mode,
+  append_merge_mode,
+  project_mode,
+  decorate_mode,
+  distributed_mode,
+  small_arrays_mode
+};
+
+
+enum select_type{
+  undefined_select,
+  heap_select,
+  introselect,
+  floyd_rivest,
+  simd_quickselect,
+  sort_truncate,
+  null_select
+};
+
+
 enum container_type{
   undefined_container,
   deque_,
@@ -67,6 +137,28 @@ struct config{
   sort_test_type chosen_test = undefined_test;
   container_type chosen_container = undefined_container;
   ssize_t test_length = 0;
+  ssize_t thread_count = 0;
+  small_sort_type chosen_small_sort = undefined_small_sort;
+  merge_kernel_type chosen_merge_kernel = undefined_merge_kernel;
+  final_merge_kind chosen_final_merge = undefined_final_merge;
+  page_kind chosen_pages = undefined_pages;
+  ssize_t memory_budget = 0;
+  run_mode chosen_mode = undefined_mode;
+  select_type chosen_select = undefined_select;
+  ssize_t select_k = 0;
+  ssize_t append_batch = 0;
+  ssize_t append_rounds = 0;
+  ssize_t key_cost = 0;
+  ssize_t process_count = 0;
+  ssize_t array_length = 0;
+  bool batch_entry = false;
+  bool prefetch = false;
+  bool segmented = false;
+  bool warm_scratch = false;
+  bool verify = false;
+  bool enable_perf_counters = false;
+  bool count_comparisons = false;
+  bool report_scratch = false;
   //bool enable_iterator_metrics = false;
 };
 
@@ -89,8 +181,30 @@ const char *doc = "This is the 'sort-performance-comparison' tool, developed to
 static struct argp_option options[] = {
   {"test", 't', "STRING", 0, "Perform one of the following specified tests: sorted, reverse_sorted, random_order, median_of_three_killer, stdin.  This must be specified once.", 0},
   {"length", 'l', "INT", 0, "Specify the size of the data to test with a sort.  This argument is required for 'sorted', 'reverse-sorted', 'random_order', and 'median_of_three_killer'.  It is optional for 'stdin'.  This may only be specified once, and must be a positive integer value.", 0},
-  {"sort-type", 's', "STRING", 0, "Specify the sort to use on the input data.  Currently supported sorts are 'std_sort', 'std_stable_sort', 'introsort', 'sequential_timsort', 'gfx_timsort', 'tvs_timsort', and 'null'.  The 'null' option is intended to be an option to allow measurement of the overhead of setting up incurred by the program in order to allow more accurate evaluation and comparison of the other sort functions.", 0},
-  {"container", 'c', "STRING", 0, "Specify the underlying container type from the Standard Template Library to use.  Be aware that not every sort can use every container type, so you must be aware of the different underlying differences.  For most cases, this should be set to 'vector'.", 0},
+  {"sort-type", 's', "STRING", 0, "Specify the sort to use on the input data.  Currently supported sorts are 'std_sort', 'std_stable_sort', 'block_merge_sort', 'introsort', 'heapsort', 'simd_introsort', 'dual_pivot_quicksort', 'static_network', 'parallel_introsort', 'sequential_timsort', 'parallel_timsort', 'parallel_samplesort', 'gfx_timsort', 'tvs_timsort', 'gfx_powersort', 'tvs_powersort', 'pdqsort', 'radix_sort', 'auto', and 'null'.  'auto' samples the input first and picks introsort, tvs_timsort or radix_sort from what it finds, see auto_sort.hpp.  'block_merge_sort' is stable like 'std_stable_sort', but needs no buffer proportional to the length, see --scratch-bytes.  'dual_pivot_quicksort' splits each range in three around two pivots instead of in two, see dual_pivot_quicksort.hpp.  'static_network' sorts up to 32 integers, floating point numbers or pointers with the sorting network for their number, see static_network.hpp, and anything else with introsort.  The 'null' option is intended to be an option to allow measurement of the overhead of setting up incurred by the program in order to allow more accurate evaluation and comparison of the other sort functions.", 0},
+  {"threads", 'j', "INT", 0, "Specify the number of threads the parallel sorts may use.  Defaults to one per hardware thread.  This may only be specified once, and must be a positive integer value.  Sequential sorts ignore it.", 0},
+  {"small-sort", 'b', "STRING", 0, "Specify how introsort, simd_introsort, dual_pivot_quicksort, parallel_introsort and the gfx and tvs timsorts and powersorts sort short ranges: 'insertion' (the default) uses each sort's own insertion sort, 'network' uses SIMD sorting networks where the CPU supports them (AVX2 or SSE4.2) and the elements are 32 or 64 bit integers, and 'static_network' uses sorting networks unrolled at compile time for up to 32 integers, floating point numbers or pointers.  The timsorts are stable, so they only use 'static_network' for integers and pointers in ascending order, whose equal elements can't be told apart.  This may only be specified once.", 0},
+  {"pages", 'h', "STRING", 0, "Specify the page size of the test data of the 'vector' container and of the merge buffers of gfx_timsort, tvs_timsort, gfx_powersort and tvs_powersort, for allocations of 2 MiB and up: '4k' maps them with transparent huge pages turned off, '2m' maps them aligned to 2 MiB with transparent huge pages asked for, and 'hugetlbfs' maps them from the huge pages reserved in /proc/sys/vm/nr_hugepages, failing when none are left.  By default they are allocated as usual, and the page size is left to the system's transparent huge page setting.  See huge_pages.hpp, and the dTLB-load-misses of --perf-counters.  This may only be specified once.", 0},
+  {"merge-kernel", 'g', "STRING", 0, "Specify the loop tvs_timsort and tvs_powersort merge with until galloping pays off: 'gallop' (the default) branches on every comparison, 'branchless' selects elements with conditional moves, 'simd' merges a vector of keys at a time on CPUs with AVX2.  'branchless' only has an effect on scalar elements and 'simd' on 32 or 64 bit signed integers in a vector, sorted in ascending order.  This can't be used if the kernel was fixed at compile time with TIMSORT_MERGE_KERNEL.  This may only be specified once.", 0},
+  {"final-merge", 'f', "STRING", 0, "Specify how gfx_timsort, tvs_timsort, gfx_powersort and tvs_powersort merge the runs left at the end: 'binary' (the default) merges them two at a time, 'multiway' merges up to 32 of them in one pass with a loser tree.  With 'multiway', the timsorts also put off merging until 32 runs are pending.  This may only be specified once.", 0},
+  {"memory-budget", 'm', "BYTES", 0, "Sort externally, holding at most about this many bytes of data in memory: sorted runs of half the budget are written to temporary files in $TMPDIR (or /tmp) and merged back, reading a block of each at a time.  The chosen sort sorts the runs, and the memory it needs on top of that isn't counted.  A suffix of 'K', 'M' or 'G' multiplies by 1024, 1024^2 or 1024^3.  Reports the number of runs and merge passes, the time spent generating runs and merging, and the bytes read and written.  Only for the 'vector' container and not with --count-comparisons.  This may only be specified once.", 0},
+  {"mode", 'o', "STRING", 0, "Specify what to benchmark: 'sort' (the default) sorts the whole input with the sort given by --sort-type, 'partial' sorts only the smallest K elements into the front of it, as std::partial_sort, and 'select' only puts the Kth smallest element in its sorted position, as std::nth_element.  The latter two use the algorithm given by --select-type.  'append' and 'append_merge' start from --length elements, sorted, then --rounds times append --batch more and sort again: 'append' sorts the whole container with --sort-type, while 'append_merge' uses it to sort only the batch, which it then merges in, see append_sort.hpp.  Both print the seconds spent sorting, excluding setting up the first --length elements.  'project' and 'decorate' sort by a key that takes --key-cost rounds of hashing to compute from each element: 'project' hands --sort-type elements that compute both keys in every comparison, while 'decorate' computes each key once into an array of (key, index) pairs for --sort-type to sort, then puts the elements in that order, see decorate_sort.hpp.  'distributed' sorts with --processes forked processes, as if they were the nodes of a cluster: each sorts its share with --sort-type, they pick splitters from regular samples, exchange the parts of their shares through queues in shared memory, and each merges what it received.  It prints the seconds each of these phases took and the bytes exchanged.  'distributed' is only for the 'vector' container and not with --count-comparisons.  'small_arrays' sorts the input as independent arrays of --array-length elements, the last one possibly shorter, one after the other with --sort-type.  It prints the number of arrays, the nanoseconds per array and arrays per second, and then the distribution of the nanoseconds each array takes from sorting a copy of the input again, timing each array.  This may only be specified once.", 0},
+  {"k", 'k', "INT", 0, "Specify K for --mode partial, where it is required, and --mode select, where it defaults to the median, (length + 1) / 2.  Must be a positive integer no larger than the length.  This may only be specified once.", 0},
+  {"batch", 'a', "INT", 0, "Specify how many elements --mode append and --mode append_merge append each round, where it is required.  Must be a positive integer.  This may only be specified once.", 0},
+  {"rounds", 'r', "INT", 0, "Specify how many times --mode append and --mode append_merge append a batch and sort, where it is required.  Must be a positive integer.  This may only be specified once.", 0},
+  {"key-cost", 'y', "INT", 0, "Specify how many rounds of a 64 bit hash computing a key takes in --mode project and --mode decorate, where it is required.  Must be a positive integer.  This may only be specified once.", 0},
+  {"processes", 'd', "INT", 0, "Specify the number of processes for --mode distributed.  Defaults to one per hardware thread, and can't be more than 32.  This may only be specified once, and must be a positive integer value.", 0},
+  {"array-length", 'u', "INT", 0, "Specify the length of each array for --mode small_arrays, where it is required.  Must be a positive integer.  This may only be specified once.", 0},
+  {"batch-entry", 'w', 0, 0, "For --mode small_arrays, hand all of the arrays to the sort's batch entry point at once instead of calling it on each, letting it set up once: 'static_network' looks up the network once, and 'gfx_timsort' and 'tvs_timsort' keep their buffers and minrun.  Other sorts have none.  The latency distribution still comes from calling the sort on each array.", 0},
+  {"select-type", 'e', "STRING", 0, "Specify the algorithm for --mode partial and --mode select: 'heap_select' keeps a heap of the K smallest, 'introselect' is quickselect with a heapsort fallback, as std::nth_element, 'floyd_rivest' picks its pivots from a sample, 'simd_quickselect' is introselect with the vectorized partition of 'simd_introsort', and 'sort_truncate' sorts everything with introsort.  After selecting, 'partial' sorts the front with introsort, or simd_introsort for 'simd_quickselect', and with the heap for 'heap_select'.  'null' does nothing, for measuring overhead as with --sort-type.  This may only be specified once.", 0},
+  {"verify", 'v', 0, 0, "Check the result after the run: that the data is sorted, or for --mode partial that the first K elements are sorted and no greater than the rest, or for --mode select that the Kth is in place; and in every mode that the data is a permutation of the input.  For the stable sorts it also checks, with --mode sort and --mode small_arrays, that equal doubles keep their order.  With --memory-budget the output file is read back a block at a time before it is removed.  Prints 'verified', or exits with an error.", 0},
+  {"perf-counters", 'p', 0, 0, "Print the cycle, instruction, branch, branch-miss, cache reference, cache miss and data TLB load miss counts of the sort itself, excluding data preparation.  Counters the system doesn't provide are reported as unavailable.", 0},
+  {"scratch-bytes", 'x', 0, 0, "Print the most heap memory the sort had allocated at once, in bytes, on top of what was allocated before it started, such as the data.  Memory allocated with extended alignment isn't counted, memory mapped for --pages is.", 0},
+  {"prefetch", 'q', 0, 0, "Prefetch in the merges of gfx_timsort, tvs_timsort, gfx_powersort and tvs_powersort: the next probes of each gallop, and the runs ahead of where the linear phase is reading, see prefetch.hpp.  Off by default, for comparing with --perf-counters.", 0},
+  {"segmented", 'z', 0, 0, "Sort a 'deque' through plain pointers: its blocks are moved one after the other into a buffer, which is sorted with --sort-type through pointers and moved back, see segmented_sort.hpp.  Prints the number of blocks and the seconds spent gathering, sorting and scattering; the buffer is counted by --scratch-bytes.  A 'vector' is a single block, sorted in place with --sort-type through pointers.  Only for --mode sort.", 0},
+  {"warm-scratch", 'i', 0, 0, "Have gfx_timsort, tvs_timsort, gfx_powersort and tvs_powersort keep their merge buffers, and gfx_timsort its run stack, from one sort to the next in an arena per thread, instead of allocating them in every sort.  In --mode sort, without --segmented, the sort first runs on a copy of the input, then on the input itself, and the seconds each took are printed as the first call and the warm call; the other reports only cover the warm call.  In --mode small_arrays the arrays share the arenas.  Other sorts run the same either way.  Only for --mode sort and --mode small_arrays, in memory.", 0},
+  {"count-comparisons", 'n', 0, 0, "Sort through a comparator that counts its calls, and print the count.  SIMD kernels are bypassed, as they only apply to the default comparison.  Not supported for 'sequential_timsort'.", 0},
+  {"container", 'c', "STRING", 0, "Specify the underlying container type from the Standard Template Library to use.  Be aware that not every sort can use every container type, so you must be aware of the different underlying differences.  For most cases, this should be set to 'vector'.  A 'deque' can also be sorted a block at a time, see --segmented.", 0},
 // {"enable-interator-metrics", 'i', "STRING", OPTION_ARG_OPTIONAL, "Default: disabled.  Track various metrics related to iterator operations to better understand what kind of operations a sort is doing, and allow direct comparison of the performance of various operations between sorts.  This can be turned on with 'enable' or 'true', and explicitly disabled with 'disable' or 'false'.", 0},
   { 0 , 0, 0, 0, 0, 0}
 };
@@ -159,6 +273,342 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state){
         }
       }
       break;
+    case 'j':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'threads' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->thread_count){
+          cout << "Can't set the number of threads multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->thread_count = strtol(arg, &sanityCheck, 10);
+        notPositiveMsg = std::string("Specified number of threads is not a positive integer.");
+        if(arg+strlen(arg) != sanityCheck || args->thread_count <= 0){
+          cout << notPositiveMsg << endl;
+          exit(EINVAL);
+        }
+        if(ERANGE == errno){
+          cout << "Specified number of threads is too large." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'b':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'small sort' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(args->chosen_small_sort != undefined_small_sort){
+          cout << "Can't set the small sort multiple times" << endl;
+          exit(EINVAL);
+        }
+        if(!strcmp("insertion", arg)){
+          args->chosen_small_sort = insertion_small_sort;
+        }else if(!strcmp("network", arg)){
+          args->chosen_small_sort = network_small_sort;
+        }else if(!strcmp("static_network", arg)){
+          args->chosen_small_sort = static_network_small_sort;
+        }else{
+          cout << "Specified small sort is not supported." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'h':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'pages' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(args->chosen_pages != undefined_pages){
+          cout << "Can't set the page size multiple times" << endl;
+          exit(EINVAL);
+        }
+        if(!strcmp("4k", arg)){
+          args->chosen_pages = small_pages;
+        }else if(!strcmp("2m", arg)){
+          args->chosen_pages = transparent_huge_pages;
+        }else if(!strcmp("hugetlbfs", arg)){
+          args->chosen_pages = hugetlbfs_pages;
+        }else{
+          cout << "Specified page size is not supported." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'g':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'merge kernel' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(args->chosen_merge_kernel != undefined_merge_kernel){
+          cout << "Can't set the merge kernel multiple times" << endl;
+          exit(EINVAL);
+        }
+        if(!strcmp("gallop", arg)){
+          args->chosen_merge_kernel = gallop_merge_kernel;
+        }else if(!strcmp("branchless", arg)){
+          args->chosen_merge_kernel = branchless_merge_kernel;
+        }else if(!strcmp("simd", arg)){
+          args->chosen_merge_kernel = simd_merge_kernel;
+        }else{
+          cout << "Specified merge kernel is not supported." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'f':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'final merge' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(args->chosen_final_merge != undefined_final_merge){
+          cout << "Can't set the final merge multiple times" << endl;
+          exit(EINVAL);
+        }
+        if(!strcmp("binary", arg)){
+          args->chosen_final_merge = binary_final_merge;
+        }else if(!strcmp("multiway", arg)){
+          args->chosen_final_merge = multiway_final_merge;
+        }else{
+          cout << "Specified final merge is not supported." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'm':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'memory budget' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->memory_budget){
+          cout << "Can't set the memory budget multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->memory_budget = strtol(arg, &sanityCheck, 10);
+        notPositiveMsg = std::string("Specified memory budget is not a positive number of bytes.");
+        ssize_t multiplier = 1;
+        if(*sanityCheck != '\0' && sanityCheck[1] == '\0'){
+          switch(*sanityCheck){
+            case 'K': case 'k': multiplier = ssize_t(1) << 10; ++sanityCheck; break;
+            case 'M': case 'm': multiplier = ssize_t(1) << 20; ++sanityCheck; break;
+            case 'G': case 'g': multiplier = ssize_t(1) << 30; ++sanityCheck; break;
+          }
+        }
+        if(arg+strlen(arg) != sanityCheck || args->memory_budget <= 0){
+          cout << notPositiveMsg << endl;
+          exit(EINVAL);
+        }
+        if(ERANGE == errno || args->memory_budget > SSIZE_MAX / multiplier){
+          cout << "Specified memory budget is too large." << endl;
+          exit(EINVAL);
+        }
+        args->memory_budget *= multiplier;
+      }
+      break;
+    case 'o':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'mode' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(undefined_mode != args->chosen_mode){
+          cout << "Can't set the mode multiple times" << endl;
+          exit(EINVAL);
+        }
+        if(!strcmp("sort", arg)){
+          args->chosen_mode = sort_mode;
+        }else if(!strcmp("partial", arg)){
+          args->chosen_mode = partial_mode;
+        }else if(!strcmp("select", arg)){
+          args->chosen_mode = select_mode;
+        }else if(!strcmp("append", arg)){
+          args->chosen_mode = append_mode;
+        }else if(!strcmp("append_merge", arg)){
+          args->chosen_mode = append_merge_mode;
+        }else if(!strcmp("project", arg)){
+          args->chosen_mode = project_mode;
+        }else if(!strcmp("decorate", arg)){
+          args->chosen_mode = decorate_mode;
+        }else if(!strcmp("distributed", arg)){
+          args->chosen_mode = distributed_mode;
+        }else if(!strcmp("small_arrays", arg)){
+          args->chosen_mode = small_arrays_mode;
+        }else{
+          cout << "Specified mode is not supported." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'k':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'k' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->select_k){
+          cout << "Can't set k multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->select_k = strtol(arg, &sanityCheck, 10);
+        if(arg+strlen(arg) != sanityCheck || ERANGE == errno || args->select_k <= 0){
+          cout << "Specified k is not a positive integer." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'a':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'batch' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->append_batch){
+          cout << "Can't set the batch multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->append_batch = strtol(arg, &sanityCheck, 10);
+        if(arg+strlen(arg) != sanityCheck || ERANGE == errno || args->append_batch <= 0){
+          cout << "Specified batch is not a positive integer." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'r':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'rounds' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->append_rounds){
+          cout << "Can't set the rounds multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->append_rounds = strtol(arg, &sanityCheck, 10);
+        if(arg+strlen(arg) != sanityCheck || ERANGE == errno || args->append_rounds <= 0){
+          cout << "Specified number of rounds is not a positive integer." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'y':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'key cost' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->key_cost){
+          cout << "Can't set the key cost multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->key_cost = strtol(arg, &sanityCheck, 10);
+        if(arg+strlen(arg) != sanityCheck || ERANGE == errno || args->key_cost <= 0){
+          cout << "Specified key cost is not a positive integer." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'd':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'processes' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->process_count){
+          cout << "Can't set the number of processes multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->process_count = strtol(arg, &sanityCheck, 10);
+        if(arg+strlen(arg) != sanityCheck || ERANGE == errno
+           || args->process_count <= 0 || args->process_count > 32){
+          cout << "Specified number of processes is not an integer from 1 to 32." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'w':
+      args->batch_entry = true;
+      break;
+    case 'q':
+      args->prefetch = true;
+      break;
+    case 'z':
+      args->segmented = true;
+      break;
+    case 'i':
+      args->warm_scratch = true;
+      break;
+    case 'u':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'array length' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(0 != args->array_length){
+          cout << "Can't set the array length multiple times" << endl;
+          exit(EINVAL);
+        }
+        errno = 0;
+        args->array_length = strtol(arg, &sanityCheck, 10);
+        if(arg+strlen(arg) != sanityCheck || ERANGE == errno || args->array_length <= 0){
+          cout << "Specified array length is not a positive integer." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'e':
+      {
+        if(nullptr == arg){
+          cout << "No argument given for 'select type' parameter" << endl;
+          exit(EINVAL);
+        }
+        if(undefined_select != args->chosen_select){
+          cout << "Can't set the select type multiple times" << endl;
+          exit(EINVAL);
+        }
+        if(!strcmp("heap_select", arg)){
+          args->chosen_select = heap_select;
+        }else if(!strcmp("introselect", arg)){
+          args->chosen_select = introselect;
+        }else if(!strcmp("floyd_rivest", arg)){
+          args->chosen_select = floyd_rivest;
+        }else if(!strcmp("simd_quickselect", arg)){
+          args->chosen_select = simd_quickselect;
+        }else if(!strcmp("sort_truncate", arg)){
+          args->chosen_select = sort_truncate;
+        }else if(!strcmp("null", arg)){
+          args->chosen_select = null_select;
+        }else{
+          cout << "Specified select type is not supported." << endl;
+          exit(EINVAL);
+        }
+      }
+      break;
+    case 'v':
+      args->verify = true;
+      break;
+    case 'p':
+      args->enable_perf_counters = true;
+      break;
+    case 'n':
+      args->count_comparisons = true;
+      break;
+    case 'x':
+      args->report_scratch = true;
+      break;
     case 's':
       {
         if(nullptr == arg){
@@ -174,14 +624,40 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state){
           args->chosen_sort = std_sort;
         }else if(!strcmp("std_stable_sort", arg)){
           args->chosen_sort = std_stable_sort;
+        }else if(!strcmp("block_merge_sort", arg)){
+          args->chosen_sort = block_merge_sort;
         }else if(!strcmp("introsort", arg)){
           args->chosen_sort = introsort;
+        }else if(!strcmp("heapsort", arg)){
+          args->chosen_sort = heapsort;
+        }else if(!strcmp("simd_introsort", arg)){
+          args->chosen_sort = simd_introsort;
+        }else if(!strcmp("dual_pivot_quicksort", arg)){
+          args->chosen_sort = dual_pivot_quicksort;
+        }else if(!strcmp("static_network", arg)){
+          args->chosen_sort = static_network;
+        }else if(!strcmp("parallel_introsort", arg)){
+          args->chosen_sort = parallel_introsort;
         }else if(!strcmp("sequential_timsort", arg)){
           args->chosen_sort = sequential_timsort;
+        }else if(!strcmp("parallel_timsort", arg)){
+          args->chosen_sort = parallel_timsort;
+        }else if(!strcmp("parallel_samplesort", arg)){
+          args->chosen_sort = parallel_samplesort;
         }else if(!strcmp("gfx_timsort", arg)){
           args->chosen_sort = gfx_timsort;
         }else if(!strcmp("tvs_timsort", arg)){
           args->chosen_sort = tvs_timsort;
+        }else if(!strcmp("gfx_powersort", arg)){
+          args->chosen_sort = gfx_powersort;
+        }else if(!strcmp("tvs_powersort", arg)){
+          args->chosen_sort = tvs_powersort;
+        }else if(!strcmp("pdqsort", arg)){
+          args->chosen_sort = pdqsort;
+        }else if(!strcmp("radix_sort", arg)){
+          args->chosen_sort = radix_sort;
+        }else if(!strcmp("auto", arg)){
+          args->chosen_sort = auto_;
         }else if(!strcmp("null", arg)){
           args->chosen_sort = null;
         }else{
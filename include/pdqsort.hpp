@@ -0,0 +1,654 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+
+The following segments were ported from pdqsort by Orson Peters, which is under
+the zlib license reproduced below, and altered.  The zlib license allows them to
+be redistributed under the Affero General Public License version 3.
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+// pdqsort.h - Pattern-defeating quicksort.
+//
+// Copyright (c) 2021 Orson Peters
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software in a
+//    product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+
+/*******************************************************************************
+@brief Pattern-defeating quicksort, an altered port of Orson Peters' pdqsort.
+It is an introsort at heart, but it differs from SCP::introsort in the following
+ways:
+
+ * Partitioning of arithmetic keys is done in blocks, first recording the
+   offsets of misplaced elements into small buffers without branching on the
+   comparison results, then swapping them in bulk (BlockQuicksort).
+ * Large ranges use Tukey's ninther for pivot selection.
+ * When a partition step didn't need to move anything, a bounded insertion sort
+   is tried on both halves, which makes sorted and nearly sorted input linear.
+ * Highly unbalanced partitions shuffle a few elements around to break up
+   patterns, and only too many of those fall back to heapsort.
+ * Runs of elements equal to the pivot are gathered on the left and skipped.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+
+namespace SCP{
+namespace pdq{
+
+enum{
+  // Below this size insertion sort is used.
+  insertion_sort_threshold = 24,
+  // Above this size the ninther is used for pivot selection.
+  ninther_threshold = 128,
+  // Number of moves a partial insertion sort may do before it gives up.
+  partial_insertion_sort_limit = 8,
+  // Number of elements classified at once in the branchless partition.  Must
+  // fit in an unsigned char.
+  block_size = 64,
+  cacheline_size = 64
+};
+
+
+template<
+  typename T>
+inline
+int
+log2(
+  T n
+){
+  int log = 0;
+  while(n >>= 1)
+    ++log;
+  return log;
+}
+
+
+/// Plain insertion sort on [begin, end).
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+insertion_sort(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if(begin == end) return;
+
+  for(RandomAccessIterator cur = begin + 1; cur != end; ++cur){
+    RandomAccessIterator sift = cur;
+    RandomAccessIterator sift_1 = cur - 1;
+
+    if(comp(*sift, *sift_1)){
+      T tmp = std::move(*sift);
+      do{
+        *sift-- = std::move(*sift_1);
+      }while(sift != begin && comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+    }
+  }
+}
+
+
+/// Insertion sort on [begin, end), assuming *(begin - 1) is a lower bound for
+/// every element in the range.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+unguarded_insertion_sort(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if(begin == end) return;
+
+  for(RandomAccessIterator cur = begin + 1; cur != end; ++cur){
+    RandomAccessIterator sift = cur;
+    RandomAccessIterator sift_1 = cur - 1;
+
+    if(comp(*sift, *sift_1)){
+      T tmp = std::move(*sift);
+      do{
+        *sift-- = std::move(*sift_1);
+      }while(comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+    }
+  }
+}
+
+
+/// Insertion sort which gives up, returning false, once more than
+/// partial_insertion_sort_limit elements had to be moved.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+bool
+partial_insertion_sort(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if(begin == end) return true;
+
+  std::size_t limit = 0;
+  for(RandomAccessIterator cur = begin + 1; cur != end; ++cur){
+    RandomAccessIterator sift = cur;
+    RandomAccessIterator sift_1 = cur - 1;
+
+    if(comp(*sift, *sift_1)){
+      T tmp = std::move(*sift);
+      do{
+        *sift-- = std::move(*sift_1);
+      }while(sift != begin && comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+      limit += cur - sift;
+    }
+
+    if(limit > partial_insertion_sort_limit) return false;
+  }
+
+  return true;
+}
+
+
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+sort2(
+  RandomAccessIterator a,
+  RandomAccessIterator b,
+  Compare comp
+){
+  if(comp(*b, *a)) std::iter_swap(a, b);
+}
+
+
+/// Sorts the elements *a, *b and *c.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+sort3(
+  RandomAccessIterator a,
+  RandomAccessIterator b,
+  RandomAccessIterator c,
+  Compare comp
+){
+  sort2(a, b, comp);
+  sort2(b, c, comp);
+  sort2(a, b, comp);
+}
+
+
+template<
+  typename T>
+inline
+T*
+align_cacheline(
+  T* p
+){
+  std::uintptr_t ip = reinterpret_cast<std::uintptr_t>(p);
+  ip = (ip + cacheline_size - 1) & -std::uintptr_t(cacheline_size);
+  return reinterpret_cast<T*>(ip);
+}
+
+
+/// Swaps the elements recorded in the two offset buffers.  If both buffers
+/// hold the same number of offsets a plain swap is required, otherwise a
+/// cyclic permutation saves about a third of the moves.
+template<
+  typename RandomAccessIterator>
+inline
+void
+swap_offsets(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  unsigned char* offsets_l,
+  unsigned char* offsets_r,
+  std::size_t num,
+  bool use_swaps
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if(use_swaps){
+    for(std::size_t i = 0; i < num; ++i)
+      std::iter_swap(first + offsets_l[i], last - offsets_r[i]);
+  }else if(num > 0){
+    RandomAccessIterator l = first + offsets_l[0];
+    RandomAccessIterator r = last - offsets_r[0];
+    T tmp(std::move(*l));
+    *l = std::move(*r);
+    for(std::size_t i = 1; i < num; ++i){
+      l = first + offsets_l[i];
+      *r = std::move(*l);
+      r = last - offsets_r[i];
+      *l = std::move(*r);
+    }
+    *r = std::move(tmp);
+  }
+}
+
+
+/// Partitions [begin, end) around the pivot *begin.  Elements equal to the
+/// pivot go to the right.  Returns the pivot position and whether the range was
+/// already correctly partitioned.  Requires a median of 3 (or better) pivot so
+/// that the scans are guarded.
+///
+/// Instead of swapping as soon as a misplaced pair is found, up to block_size
+/// elements from each end are classified and the offsets of misplaced ones are
+/// written out unconditionally, advancing the buffer end by the comparison
+/// result.  This trades a data dependent branch for a data dependency.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+std::pair<RandomAccessIterator, bool>
+partition_right_branchless(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  T pivot(std::move(*begin));
+  RandomAccessIterator first = begin;
+  RandomAccessIterator last = end;
+
+  // Find the first element greater than or equal to the pivot.
+  while(comp(*++first, pivot));
+
+  // Find the first element strictly smaller than the pivot.  Only guard this
+  // search if there was no element before *first.
+  if(first - 1 == begin) while(first < last && !comp(*--last, pivot));
+  else                   while(                !comp(*--last, pivot));
+
+  bool already_partitioned = first >= last;
+  if(!already_partitioned){
+    std::iter_swap(first, last);
+    ++first;
+
+    unsigned char offsets_l_storage[block_size + cacheline_size];
+    unsigned char offsets_r_storage[block_size + cacheline_size];
+    unsigned char* offsets_l = align_cacheline(offsets_l_storage);
+    unsigned char* offsets_r = align_cacheline(offsets_r_storage);
+
+    RandomAccessIterator offsets_l_base = first;
+    RandomAccessIterator offsets_r_base = last;
+    std::size_t num_l, num_r, start_l, start_r;
+    num_l = num_r = start_l = start_r = 0;
+
+    while(first < last){
+      // Fill up offset blocks with elements that are on the wrong side.  When
+      // fewer than two blocks remain, split the remainder between the sides.
+      std::size_t num_unknown = last - first;
+      std::size_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+      std::size_t right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+
+      if(left_split >= block_size){
+        for(std::size_t i = 0; i < block_size;){
+          offsets_l[num_l] = i++; num_l += !comp(*first, pivot); ++first;
+          offsets_l[num_l] = i++; num_l += !comp(*first, pivot); ++first;
+          offsets_l[num_l] = i++; num_l += !comp(*first, pivot); ++first;
+          offsets_l[num_l] = i++; num_l += !comp(*first, pivot); ++first;
+        }
+      }else{
+        for(std::size_t i = 0; i < left_split;){
+          offsets_l[num_l] = i++; num_l += !comp(*first, pivot); ++first;
+        }
+      }
+
+      if(right_split >= block_size){
+        for(std::size_t i = 0; i < block_size;){
+          offsets_r[num_r] = ++i; num_r += comp(*--last, pivot);
+          offsets_r[num_r] = ++i; num_r += comp(*--last, pivot);
+          offsets_r[num_r] = ++i; num_r += comp(*--last, pivot);
+          offsets_r[num_r] = ++i; num_r += comp(*--last, pivot);
+        }
+      }else{
+        for(std::size_t i = 0; i < right_split;){
+          offsets_r[num_r] = ++i; num_r += comp(*--last, pivot);
+        }
+      }
+
+      // Swap elements and update block sizes and first/last boundaries.
+      std::size_t num = std::min(num_l, num_r);
+      swap_offsets(offsets_l_base, offsets_r_base,
+                   offsets_l + start_l, offsets_r + start_r,
+                   num, num_l == num_r);
+      num_l -= num; num_r -= num;
+      start_l += num; start_r += num;
+
+      if(num_l == 0){
+        start_l = 0;
+        offsets_l_base = first;
+      }
+
+      if(num_r == 0){
+        start_r = 0;
+        offsets_r_base = last;
+      }
+    }
+
+    // One of the offset buffers may still hold elements; swap them to the
+    // boundary.
+    if(num_l){
+      offsets_l += start_l;
+      while(num_l--) std::iter_swap(offsets_l_base + offsets_l[num_l], --last);
+      first = last;
+    }
+    if(num_r){
+      offsets_r += start_r;
+      while(num_r--) std::iter_swap(offsets_r_base - offsets_r[num_r], first), ++first;
+      last = first;
+    }
+  }
+
+  // Put the pivot in the right place.
+  RandomAccessIterator pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+
+  return std::make_pair(pivot_pos, already_partitioned);
+}
+
+
+/// Same contract as partition_right_branchless(), but using the classic
+/// swapping Hoare loop.  Used for types where a comparison may be expensive or
+/// have side effects, which would make classifying every element a loss.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+std::pair<RandomAccessIterator, bool>
+partition_right(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  T pivot(std::move(*begin));
+  RandomAccessIterator first = begin;
+  RandomAccessIterator last = end;
+
+  while(comp(*++first, pivot));
+
+  if(first - 1 == begin) while(first < last && !comp(*--last, pivot));
+  else                   while(                !comp(*--last, pivot));
+
+  bool already_partitioned = first >= last;
+
+  while(first < last){
+    std::iter_swap(first, last);
+    while(comp(*++first, pivot));
+    while(!comp(*--last, pivot));
+  }
+
+  RandomAccessIterator pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+
+  return std::make_pair(pivot_pos, already_partitioned);
+}
+
+
+/// Partitions [begin, end) around *begin with elements equal to the pivot on
+/// the left.  Only called when the pivot equals the element preceding the
+/// range, so everything left of the returned position equals the pivot and
+/// needs no further sorting.
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+RandomAccessIterator
+partition_left(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  T pivot(std::move(*begin));
+  RandomAccessIterator first = begin;
+  RandomAccessIterator last = end;
+
+  while(comp(pivot, *--last));
+
+  if(last + 1 == end) while(first < last && !comp(pivot, *++first));
+  else                while(                !comp(pivot, *++first));
+
+  while(first < last){
+    std::iter_swap(first, last);
+    while(comp(pivot, *--last));
+    while(!comp(pivot, *++first));
+  }
+
+  RandomAccessIterator pivot_pos = last;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+
+  return pivot_pos;
+}
+
+
+/// Main loop.  Recurses on the left partition and loops on the right, the same
+/// shape as SCP::introsort_loop().  'bad_allowed' plays the role of the depth
+/// limit, except that it is only spent on highly unbalanced partitions.
+template<
+  bool Branchless,
+  typename RandomAccessIterator,
+  typename Compare>
+void
+pdqsort_loop(
+  RandomAccessIterator begin,
+  RandomAccessIterator end,
+  Compare comp,
+  int bad_allowed,
+  bool leftmost = true
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type
+    diff_t;
+
+  while(true){
+    diff_t size = end - begin;
+
+    if(size < insertion_sort_threshold){
+      if(leftmost) insertion_sort(begin, end, comp);
+      else unguarded_insertion_sort(begin, end, comp);
+      return;
+    }
+
+    // Choose the pivot as the median of 3 or the pseudomedian of 9, and move
+    // it to *begin.
+    diff_t s2 = size / 2;
+    if(size > ninther_threshold){
+      sort3(begin, begin + s2, end - 1, comp);
+      sort3(begin + 1, begin + (s2 - 1), end - 2, comp);
+      sort3(begin + 2, begin + (s2 + 1), end - 3, comp);
+      sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), comp);
+      std::iter_swap(begin, begin + s2);
+    }else{
+      sort3(begin + s2, begin, end - 1, comp);
+    }
+
+    // If *(begin - 1) is the end of the right partition of a previous step it
+    // is an upper bound for the left side.  If it also isn't smaller than the
+    // pivot, the pivot is a repeated element: put every copy of it on the left
+    // and continue past them.
+    if(!leftmost && !comp(*(begin - 1), *begin)){
+      begin = partition_left(begin, end, comp) + 1;
+      continue;
+    }
+
+    std::pair<RandomAccessIterator, bool> part_result =
+      Branchless ? partition_right_branchless(begin, end, comp)
+                 : partition_right(begin, end, comp);
+    RandomAccessIterator pivot_pos = part_result.first;
+    bool already_partitioned = part_result.second;
+
+    diff_t l_size = pivot_pos - begin;
+    diff_t r_size = end - (pivot_pos + 1);
+    bool highly_unbalanced = l_size < size / 8 || r_size < size / 8;
+
+    if(highly_unbalanced){
+      // Too many bad partitions; guarantee O(n log n).
+      if(--bad_allowed == 0){
+        std::make_heap(begin, end, comp);
+        std::sort_heap(begin, end, comp);
+        return;
+      }
+
+      // Break up any pattern the pivot selection may be falling for by moving
+      // a few elements to new positions.
+      if(l_size >= insertion_sort_threshold){
+        std::iter_swap(begin, begin + l_size / 4);
+        std::iter_swap(pivot_pos - 1, pivot_pos - l_size / 4);
+
+        if(l_size > ninther_threshold){
+          std::iter_swap(begin + 1, begin + (l_size / 4 + 1));
+          std::iter_swap(begin + 2, begin + (l_size / 4 + 2));
+          std::iter_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+          std::iter_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+        }
+      }
+
+      if(r_size >= insertion_sort_threshold){
+        std::iter_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+        std::iter_swap(end - 1, end - r_size / 4);
+
+        if(r_size > ninther_threshold){
+          std::iter_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+          std::iter_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+          std::iter_swap(end - 2, end - (1 + r_size / 4));
+          std::iter_swap(end - 3, end - (2 + r_size / 4));
+        }
+      }
+    }else{
+      // A balanced partition that didn't move anything hints at sorted input.
+      // Try to finish both halves with a bounded insertion sort.
+      if(already_partitioned
+      && partial_insertion_sort(begin, pivot_pos, comp)
+      && partial_insertion_sort(pivot_pos + 1, end, comp))
+        return;
+    }
+
+    pdqsort_loop<Branchless>(begin, pivot_pos, comp, bad_allowed, leftmost);
+    begin = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+
+
+/// Whether the branchless partition is worthwhile: comparisons must be cheap
+/// and free of side effects.
+template<
+  typename T,
+  typename Compare>
+struct use_branchless : std::integral_constant<bool,
+  std::is_arithmetic<T>::value
+  && (std::is_same<Compare, std::less<T> >::value
+   || std::is_same<Compare, std::less<> >::value
+   || std::is_same<Compare, std::greater<T> >::value
+   || std::is_same<Compare, std::greater<> >::value)>
+{};
+
+};
+
+
+/**
+*  @brief Sort the elements of a sequence using a predicate for comparison.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @param  comp    A comparison functor.
+*  @return  Nothing.
+*
+*  Pattern-defeating quicksort.  Not stable.  The branchless block partition is
+*  used when the value type is arithmetic and @p comp is std::less or
+*  std::greater, otherwise the classic partition is used.
+*/
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+pdqsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if(first == last) return;
+  pdq::pdqsort_loop<pdq::use_branchless<T, Compare>::value>(
+    first, last, comp, pdq::log2(last - first));
+}
+
+
+/**
+*  @brief Sort the elements of a sequence.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @return  Nothing.
+*/
+template<
+  typename RandomAccessIterator>
+inline
+void
+pdqsort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  pdqsort(first, last, std::less<T>());
+}
+
+
+};
@@ -0,0 +1,165 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+/*******************************************************************************
+@brief Hardware counter deltas around a single sort.
+
+Each counter is opened on its own with perf_event_open(2) rather than as a
+group, since a group can't be read back once it is inherited by the threads
+the parallel sorts start.  Only user space is counted.  When a counter can't be
+opened (no PMU, perf_event_paranoid too strict, not Linux) it is reported as
+unavailable instead of failing the run.
+*******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace SCP{
+
+class perf_counters{
+public:
+  perf_counters(
+  ){
+#ifdef __linux__
+    for(std::size_t i = 0; i < num_counters; i++)
+      fds[i] = open_counter(events[i].type, events[i].config);
+#endif
+  }
+
+
+  ~perf_counters(
+  ){
+#ifdef __linux__
+    for(int fd : fds)
+      if(fd >= 0) close(fd);
+#endif
+  }
+
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+
+  void
+  start(
+  ){
+#ifdef __linux__
+    for(int fd : fds){
+      if(fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+
+  void
+  stop(
+  ){
+#ifdef __linux__
+    for(std::size_t i = 0; i < num_counters; i++){
+      if(fds[i] < 0) continue;
+      ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      if(ssize_t(sizeof(values[i])) != read(fds[i], &values[i], sizeof(values[i])))
+        values[i] = 0;
+    }
+#endif
+  }
+
+
+  /// Prints one 'name: value' line per counter, in the order perf(1) uses.
+  void
+  report(
+    std::ostream &out
+  ) const {
+    for(std::size_t i = 0; i < num_counters; i++){
+      out << events[i].name << ": ";
+      if(fds[i] < 0) out << "unavailable";
+      else           out << values[i];
+      out << std::endl;
+    }
+  }
+
+
+private:
+  struct event{
+    const char *name;
+    std::uint32_t type;
+    std::uint64_t config;
+  };
+
+#ifdef __linux__
+  static constexpr event events[] = {
+    {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branches",      PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"dTLB-load-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+                                             | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                             | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}
+  };
+#else
+  static constexpr event events[] = {
+    {"cycles", 0, 0}, {"instructions", 0, 0}, {"branches", 0, 0}, {"branch-misses", 0, 0},
+    {"cache-references", 0, 0}, {"cache-misses", 0, 0}, {"dTLB-load-misses", 0, 0}
+  };
+#endif
+  static constexpr std::size_t num_counters = sizeof(events) / sizeof(events[0]);
+
+  int fds[num_counters] = {-1, -1, -1, -1, -1, -1, -1};
+  std::uint64_t values[num_counters] = {};
+
+
+#ifdef __linux__
+  static int
+  open_counter(
+    std::uint32_t type,
+    std::uint64_t config
+  ){
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+};
+
+}
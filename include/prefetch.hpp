@@ -0,0 +1,132 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+
+/*******************************************************************************
+@brief Software prefetching for the merges of the gfx and tvs timsorts, switched
+on at runtime with --prefetch.
+
+Galloping probes offsets 1, 3, 7, 15 and so on from where it starts, so on large
+runs each probe is a cache miss the hardware prefetchers can't predict.  After
+each probe that doesn't end the search, gallop_probes() asks for the next two,
+so their misses overlap with the current one instead of following it.
+
+The linear phase of a merge reads both runs in order, which the hardware
+prefetchers handle on their own as long as they recognize the streams.
+ahead() and behind() prefetch stream_distance elements past a cursor in the
+direction it moves, so the streams are requested even when they aren't.
+
+Only positions inside the range being read are prefetched, so that no iterator
+is moved out of its range.
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
+
+namespace SCP{
+namespace prefetch{
+
+/// Set from --prefetch.  The merges only prefetch when this is set.
+inline bool enabled = false;
+
+
+/// How many elements ahead of a cursor the linear phase prefetches: 512 bytes,
+/// eight cache lines on most CPUs.
+template<
+  typename T>
+inline constexpr std::ptrdiff_t stream_distance =
+  sizeof(T) < 512 ? std::ptrdiff_t(512 / sizeof(T)) : 1;
+
+
+/// Asks for the cache line holding *it, to be read.
+template<
+  typename Iterator>
+inline
+void
+element(
+  Iterator it
+){
+  __builtin_prefetch(std::addressof(*it), 0, 3);
+}
+
+
+/// Prefetches stream_distance past cursor, moving up to end, if that is
+/// before end.
+template<
+  typename Iterator>
+inline
+void
+ahead(
+  Iterator cursor,
+  Iterator end
+){
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  if(end - cursor > stream_distance<T>)
+    element(cursor + stream_distance<T>);
+}
+
+
+/// Prefetches stream_distance before cursor, moving down to first, if that is
+/// at or after first.
+template<
+  typename Iterator>
+inline
+void
+behind(
+  Iterator cursor,
+  Iterator first
+){
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  if(cursor - first >= stream_distance<T>)
+    element(cursor - stream_distance<T>);
+}
+
+
+/// For an exponential search from base that is about to probe offset ofs, of
+/// the form 2^k - 1, prefetches the next two probes below limit.  A negative
+/// direction searches down from base.
+template<
+  typename Iterator>
+inline
+void
+gallop_probes(
+  Iterator base,
+  std::ptrdiff_t ofs,
+  std::ptrdiff_t limit,
+  std::ptrdiff_t direction
+){
+  for(int i = 0; i < 2; i++){
+    ofs = 2 * ofs + 1;
+    if(ofs >= limit)
+      return;
+    element(base + direction * ofs);
+  }
+}
+
+};
+};
@@ -0,0 +1,149 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+/*******************************************************************************
+@brief Least significant digit radix sort for integer keys.
+
+Each pass distributes the keys by one byte, starting from the least
+significant, into a buffer of the same size; since each pass is stable the
+order set by the lower bytes survives the higher ones.  The counts for every
+byte are taken in a single read of the input up front, and a pass whose byte
+is the same in every key is skipped, so the number of passes follows the key
+range actually present rather than the width of the type.  The sign bit of
+signed keys is flipped so negative keys sort below positive ones.
+
+There is no comparison, so it can't be used with a comparator, and it is not
+in place: the buffer costs as much memory as the input.  Elements other than
+integers are sorted by an unsigned key if an overload of radix_key() for them
+is found by argument dependent lookup, as for the pairs of decorate_sort.hpp.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+
+namespace SCP{
+
+/// Maps an integer to an unsigned key of the same width whose order as an
+/// unsigned number is the order of the integer.
+template<
+  typename _Tp,
+  typename = typename std::enable_if<std::is_integral<_Tp>::value>::type>
+inline
+typename std::make_unsigned<_Tp>::type
+radix_key(
+  _Tp __value
+){
+  typedef typename std::make_unsigned<_Tp>::type _Key;
+  constexpr _Key __flip = std::is_signed<_Tp>::value
+                        ? _Key(_Key(1) << (8 * sizeof(_Tp) - 1)) : _Key(0);
+  return _Key(_Key(__value) ^ __flip);
+}
+
+
+/// Scatters [__first, __last) into __out by byte __digit of the key, using
+/// the bucket offsets in __offset.
+template<
+  typename _InputIterator,
+  typename _OutputIterator>
+inline
+void
+radix_scatter(
+  _InputIterator __first,
+  _InputIterator __last,
+  _OutputIterator __out,
+  std::size_t __digit,
+  std::size_t *__offset
+){
+  for(; __first != __last; ++__first){
+    const std::size_t __byte = (radix_key(*__first) >> (8 * __digit)) & 0xff;
+    __out[__offset[__byte]++] = std::move(*__first);
+  }
+}
+
+
+/**
+*  @brief Sort the integers of a sequence in ascending order.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  The sort is stable, and takes at most a pass over the data per byte of the
+*  key, fewer when the keys share their high bytes.
+*/
+template<
+  typename _RandomAccessIterator>
+void
+radix_sort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type _Tp;
+  typedef decltype(radix_key(*__first)) _Key;
+  static_assert(std::is_unsigned<_Key>::value,
+                "radix_sort only sorts integer keys");
+  enum { __digits = sizeof(_Key), __buckets = 256 };
+
+  const std::size_t __len = __last - __first;
+  if(__len < 2)
+    return;
+
+  std::size_t __count[__digits][__buckets] = {};
+  for(_RandomAccessIterator __it = __first; __it != __last; ++__it){
+    const auto __key = radix_key(*__it);
+    for(std::size_t __d = 0; __d < __digits; ++__d)
+      ++__count[__d][(__key >> (8 * __d)) & 0xff];
+  }
+
+  std::vector<_Tp> __buffer(__len);
+  bool __in_buffer = false;
+  for(std::size_t __d = 0; __d < __digits; ++__d){
+    std::size_t *__offset = __count[__d];
+    if(std::find(__offset, __offset + __buckets, __len) != __offset + __buckets)
+      continue;
+
+    std::size_t __sum = 0;
+    for(std::size_t __b = 0; __b < __buckets; ++__b){
+      const std::size_t __n = __offset[__b];
+      __offset[__b] = __sum;
+      __sum += __n;
+    }
+
+    if(__in_buffer)
+      radix_scatter(__buffer.begin(), __buffer.end(), __first, __d, __offset);
+    else
+      radix_scatter(__first, __last, __buffer.begin(), __d, __offset);
+    __in_buffer = !__in_buffer;
+  }
+
+  if(__in_buffer)
+    std::move(__buffer.begin(), __buffer.end(), __first);
+}
+
+};
@@ -0,0 +1,605 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief An in-place parallel super scalar samplesort, modeled after IPS4o by
+Axtmann, Witt, Ferizovic and Sanders.
+
+One partitioning step splits a range into up to 256 buckets:
+
+ * Sampling: an oversampled random sample is sorted and equally spaced
+   splitters are picked from it.  If the sample contains duplicate splitters,
+   an "equal bucket" is added after each splitter to catch elements equal to
+   it.  Equal buckets need no further sorting, which makes inputs with few
+   distinct keys cheap.
+ * Classification: the splitters are stored as an implicit binary search tree,
+   and an element's bucket is found by log2(k) steps of i = 2i + (s_i < x),
+   which compiles to conditional moves rather than branches.  Each thread
+   classifies its own stripe of the range into one block sized buffer per
+   bucket, writing full buffers back to the front of its stripe.
+ * Block permutation: the full blocks are then moved into the block aligned
+   area of their bucket by cycling blocks between bucket areas, using two
+   blocks of scratch space per thread.  Threads start on different buckets
+   and claim read/write positions with a lock per bucket.
+ * Cleanup: the partially filled buffers and the blocks which crossed a bucket
+   boundary are moved into the gaps at the bucket edges.
+
+After the first step the buckets are sorted as independent tasks on a
+work-stealing pool, each recursing sequentially with the same algorithm.
+Ranges below base_case_size are handed to SCP::pdqsort.
+
+The extra memory is O(k * block size) per thread, independent of the input
+size.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+#include "pdqsort.hpp"
+
+
+namespace SCP{
+namespace ssort{
+
+enum{
+  max_log_buckets = 8,
+  max_buckets = 1 << max_log_buckets,
+  // Twice max_buckets when equal buckets are used.
+  max_total_buckets = 2 * max_buckets,
+  block_bytes = 2048,
+  // Minimum number of elements per thread for the parallel step.
+  min_parallel_chunk = 1 << 16
+};
+
+
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+class samplesort_engine{
+public:
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type diff_t;
+
+  static constexpr diff_t block_size =
+    sizeof(T) >= std::size_t(block_bytes) ? 1 : diff_t(block_bytes / sizeof(T));
+  static constexpr diff_t base_case_size = 16 * block_size;
+
+
+  samplesort_engine(
+    Compare comp_,
+    std::size_t num_workers
+  ) : comp(comp_), locals(num_workers), steps(num_workers) {
+    for(std::size_t i = 0; i < num_workers; i++){
+      locals[i].reset(new local_data());
+      steps[i].reset(new step_data());
+    }
+  }
+
+
+  void
+  sort(
+    RandomAccessIterator begin,
+    RandomAccessIterator end
+  ){
+    diff_t length = end - begin;
+    std::size_t num_threads = std::min<std::size_t>(
+      locals.size(), std::max<diff_t>(1, length / min_parallel_chunk));
+
+    if(length <= base_case_size){
+      pdqsort(begin, end, comp);
+      return;
+    }
+    if(num_threads == 1){
+      sequential_sort(begin, end, 0, depth_limit(length));
+      return;
+    }
+
+    // One partitioning step using every thread, then the buckets are
+    // independent tasks.
+    step_data &step = *steps[0];
+    partition(begin, length, step, num_threads);
+
+    typedef std::pair<RandomAccessIterator, RandomAccessIterator> task_t;
+    parallel::work_stealing_pool<task_t> pool(locals.size());
+    for(std::size_t b = 0; b < step.num_buckets; b++){
+      if(step.equal_buckets && b % 2 == 1) continue;
+      if(step.bounds[b + 1] - step.bounds[b] < 2) continue;
+      pool.push(b % pool.size(), task_t(begin + step.bounds[b], begin + step.bounds[b + 1]));
+    }
+    int depth = depth_limit(length);
+    pool.run([&](std::size_t worker, task_t task){
+      sequential_sort(task.first, task.second, worker, depth);
+    });
+  }
+
+private:
+
+  /// Scratch space owned by one thread.
+  struct local_data{
+    local_data(
+    ) : buffers(max_total_buckets * block_size),
+        fill(max_total_buckets),
+        bucket_size(max_total_buckets),
+        swap(2 * block_size),
+        full_blocks(0) {}
+
+    // One block sized buffer per bucket, for classification.
+    std::vector<T> buffers;
+    std::vector<diff_t> fill;
+    std::vector<diff_t> bucket_size;
+    // Two blocks for the permutation.
+    std::vector<T> swap;
+    // Full blocks written to the front of this thread's stripe.
+    diff_t full_blocks;
+  };
+
+
+  /// Write and read positions in the block aligned area of a bucket.  Blocks
+  /// in [write, read] are still to be moved to their bucket.
+  struct alignas(64) bucket_state{
+    std::mutex lock;
+    diff_t write;
+    diff_t read;
+  };
+
+
+  /// State of one partitioning step, shared by the threads taking part.
+  struct step_data{
+    step_data(
+    ) : buckets(new bucket_state[max_total_buckets]),
+        overflow(block_size),
+        bounds(max_total_buckets + 1) {}
+
+    // Implicit search tree of splitters, 1-indexed.
+    std::vector<T> tree;
+    // The distinct splitters, sorted.
+    std::vector<T> splitters;
+    int log_buckets;
+    std::size_t num_buckets;
+    bool equal_buckets;
+
+    std::unique_ptr<bucket_state[]> buckets;
+    // Holds the one block which may be written past the end of the range.
+    std::vector<T> overflow;
+    std::ptrdiff_t overflow_bucket;
+    // Bucket b holds [bounds[b], bounds[b + 1]).
+    std::vector<diff_t> bounds;
+  };
+
+
+  static
+  int
+  depth_limit(
+    diff_t length
+  ){
+    int depth = 0;
+    while(length >>= 1) depth++;
+    return depth;
+  }
+
+
+  static
+  diff_t
+  align_up(
+    diff_t position
+  ){
+    return (position + block_size - 1) / block_size * block_size;
+  }
+
+
+  void
+  sequential_sort(
+    RandomAccessIterator begin,
+    RandomAccessIterator end,
+    std::size_t worker,
+    int depth
+  ){
+    diff_t length = end - begin;
+    if(length <= base_case_size || depth == 0){
+      pdqsort(begin, end, comp);
+      return;
+    }
+
+    step_data &step = *steps[worker];
+    partition(begin, length, step, 1, worker);
+
+    // The step data is reused by the recursion.
+    std::vector<diff_t> bounds(step.bounds.begin(), step.bounds.begin() + step.num_buckets + 1);
+    bool equal_buckets = step.equal_buckets;
+    for(std::size_t b = 0; b + 1 < bounds.size(); b++){
+      if(equal_buckets && b % 2 == 1) continue;
+      sequential_sort(begin + bounds[b], begin + bounds[b + 1], worker, depth - 1);
+    }
+  }
+
+
+  /// Picks the splitters for [begin, begin + length) and builds the search
+  /// tree.
+  void
+  build_splitters(
+    RandomAccessIterator begin,
+    diff_t length,
+    step_data &step
+  ){
+    int log_buckets = std::min<int>(max_log_buckets,
+                                    depth_limit(length / base_case_size) + 1);
+    diff_t wanted = diff_t(1) << log_buckets;
+    diff_t oversampling = std::max(1, int(0.2 * depth_limit(length)));
+    diff_t sample_size = std::min(length / 2, oversampling * wanted);
+
+    // Move a random sample to the front and sort it.
+    std::minstd_rand rng(length);
+    for(diff_t i = 0; i < sample_size; i++)
+      std::iter_swap(begin + i, begin + (i + rng() % (length - i)));
+    pdqsort(begin, begin + sample_size, comp);
+
+    step.splitters.clear();
+    step.equal_buckets = false;
+    for(diff_t j = 1; j < wanted; j++){
+      const T &candidate = begin[j * sample_size / wanted];
+      if(step.splitters.empty() || comp(step.splitters.back(), candidate))
+        step.splitters.push_back(candidate);
+      else
+        step.equal_buckets = true;
+    }
+    if(step.splitters.size() == 1)
+      step.equal_buckets = true;
+
+    // Round the bucket count up to a power of two, padding with the largest
+    // splitter.  The extra buckets stay empty.
+    std::size_t num_splitters = step.splitters.size();
+    step.log_buckets = 0;
+    while((std::size_t(1) << step.log_buckets) < num_splitters + 1)
+      step.log_buckets++;
+    std::size_t buckets = std::size_t(1) << step.log_buckets;
+
+    std::vector<T> padded(step.splitters);
+    padded.resize(buckets - 1, step.splitters.back());
+    step.tree.resize(buckets);
+    build_tree(step.tree, padded, 1, 0, padded.size());
+
+    step.num_buckets = step.equal_buckets ? 2 * buckets : buckets;
+  }
+
+
+  /// Lays out sorted[lo, hi) as the subtree rooted at 'node'.
+  static
+  void
+  build_tree(
+    std::vector<T> &tree,
+    const std::vector<T> &sorted,
+    std::size_t node,
+    std::size_t lo,
+    std::size_t hi
+  ){
+    std::size_t mid = lo + (hi - lo) / 2;
+    tree[node] = sorted[mid];
+    if(hi - lo > 1){
+      build_tree(tree, sorted, 2 * node, lo, mid);
+      build_tree(tree, sorted, 2 * node + 1, mid + 1, hi);
+    }
+  }
+
+
+  /// Bucket of x.  Equal buckets are the odd ones.
+  inline
+  std::size_t
+  classify(
+    const T &x,
+    const step_data &step
+  ) const {
+    std::size_t i = 1;
+    for(int level = 0; level < step.log_buckets; level++)
+      i = 2 * i + comp(step.tree[i], x);
+    std::size_t b = i - (std::size_t(1) << step.log_buckets);
+    if(step.equal_buckets){
+      std::size_t num_splitters = step.splitters.size();
+      bool in_range = b < num_splitters;
+      const T &upper = step.splitters[in_range ? b : num_splitters - 1];
+      b = 2 * b + (in_range & !comp(x, upper));
+    }
+    return b;
+  }
+
+
+  /// Classifies a stripe into the thread's buffers, flushing full buffers to
+  /// the front of the stripe.
+  void
+  classify_stripe(
+    RandomAccessIterator begin,
+    diff_t stripe_begin,
+    diff_t stripe_end,
+    const step_data &step,
+    local_data &local
+  ){
+    std::fill(local.fill.begin(), local.fill.begin() + step.num_buckets, 0);
+    std::fill(local.bucket_size.begin(), local.bucket_size.begin() + step.num_buckets, 0);
+
+    diff_t write = stripe_begin;
+    for(diff_t i = stripe_begin; i < stripe_end; i++){
+      std::size_t b = classify(begin[i], step);
+      if(local.fill[b] == block_size){
+        typename std::vector<T>::iterator buffer = local.buffers.begin() + b * block_size;
+        std::move(buffer, buffer + block_size, begin + write);
+        write += block_size;
+        local.bucket_size[b] += block_size;
+        local.fill[b] = 0;
+      }
+      local.buffers[b * block_size + local.fill[b]++] = std::move(begin[i]);
+    }
+
+    for(std::size_t b = 0; b < step.num_buckets; b++)
+      local.bucket_size[b] += local.fill[b];
+    local.full_blocks = (write - stripe_begin) / block_size;
+  }
+
+
+  /// Moves full blocks so that they all sit in the first F block slots of the
+  /// range, F being the total number of full blocks.  Only moves blocks from
+  /// the front of late stripes into the gaps at the back of early ones, so it
+  /// is bounded by the number of buckets times the number of threads.
+  diff_t
+  gather_full_blocks(
+    RandomAccessIterator begin,
+    diff_t length,
+    std::size_t num_threads,
+    std::size_t first_worker
+  ){
+    diff_t total_blocks = length / block_size;
+    diff_t full = 0;
+    for(std::size_t t = 0; t < num_threads; t++)
+      full += locals[first_worker + t]->full_blocks;
+
+    std::vector<diff_t> holes;
+    std::vector<diff_t> strays;
+    for(std::size_t t = 0; t < num_threads; t++){
+      diff_t first_block = total_blocks * t / num_threads;
+      diff_t last_block = total_blocks * (t + 1) / num_threads;
+      diff_t filled_end = first_block + locals[first_worker + t]->full_blocks;
+      for(diff_t block = first_block; block < filled_end; block++)
+        if(block >= full) strays.push_back(block);
+      for(diff_t block = filled_end; block < last_block && block < full; block++)
+        holes.push_back(block);
+    }
+
+    for(std::size_t i = 0; i < strays.size(); i++)
+      std::move(begin + strays[i] * block_size,
+                begin + (strays[i] + 1) * block_size,
+                begin + holes[i] * block_size);
+    return full;
+  }
+
+
+  /// Takes the block at the read position of a bucket into 'out'.
+  bool
+  read_block(
+    RandomAccessIterator begin,
+    bucket_state &bucket,
+    T *out
+  ){
+    std::lock_guard<std::mutex> guard(bucket.lock);
+    if(bucket.read < bucket.write) return false;
+    diff_t slot = bucket.read;
+    bucket.read -= block_size;
+    std::move(begin + slot, begin + (slot + block_size), out);
+    return true;
+  }
+
+
+  /// Moves every full block into the area of its bucket.  A thread takes a
+  /// block from its current primary bucket, then keeps swapping the block it
+  /// holds with the next unprocessed block of the holding block's bucket,
+  /// until it lands in an empty slot.
+  void
+  permute_blocks(
+    RandomAccessIterator begin,
+    diff_t length,
+    step_data &step,
+    local_data &local,
+    std::size_t id,
+    std::size_t num_threads
+  ){
+    T *held = local.swap.data();
+    T *other = local.swap.data() + block_size;
+
+    for(std::size_t i = 0; i < step.num_buckets; i++){
+      std::size_t primary = (id * step.num_buckets / num_threads + i) % step.num_buckets;
+      while(read_block(begin, step.buckets[primary], held)){
+        while(true){
+          std::size_t dest = classify(held[0], step);
+          bucket_state &bucket = step.buckets[dest];
+          std::lock_guard<std::mutex> guard(bucket.lock);
+          diff_t slot = bucket.write;
+          bucket.write += block_size;
+
+          if(slot <= bucket.read){
+            // The slot still holds an unprocessed block; exchange them.
+            std::move(begin + slot, begin + (slot + block_size), other);
+            std::move(held, held + block_size, begin + slot);
+            std::swap(held, other);
+            continue;
+          }
+
+          if(slot + block_size > length){
+            std::move(held, held + block_size, step.overflow.begin());
+            step.overflow_bucket = dest;
+          }else{
+            std::move(held, held + block_size, begin + slot);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+
+  /// Fills the gaps at the edges of every bucket from the blocks that spilled
+  /// over its end, the overflow block, and the threads' partial buffers.
+  void
+  cleanup(
+    RandomAccessIterator begin,
+    step_data &step,
+    std::size_t num_threads,
+    std::size_t first_worker
+  ){
+    for(std::size_t b = 0; b < step.num_buckets; b++){
+      diff_t start = step.bounds[b];
+      diff_t end = step.bounds[b + 1];
+      diff_t area = align_up(start);
+      diff_t written_end = step.buckets[b].write
+                         - (step.overflow_bucket == std::ptrdiff_t(b) ? block_size : 0);
+
+      // Empty slots are [start, head_end) followed by [written_end, end).
+      diff_t head_end = std::min(area, end);
+      diff_t position = start;
+      auto next_slot = [&](){
+        if(position == head_end) position = std::max(written_end, head_end);
+        return position++;
+      };
+
+      for(diff_t i = std::max(end, area); i < written_end; i++)
+        begin[next_slot()] = std::move(begin[i]);
+      if(step.overflow_bucket == std::ptrdiff_t(b))
+        for(diff_t i = 0; i < block_size; i++)
+          begin[next_slot()] = std::move(step.overflow[i]);
+      for(std::size_t t = 0; t < num_threads; t++){
+        local_data &local = *locals[first_worker + t];
+        for(diff_t i = 0; i < local.fill[b]; i++)
+          begin[next_slot()] = std::move(local.buffers[b * block_size + i]);
+      }
+    }
+  }
+
+
+  /// One partitioning step of [begin, begin + length) with num_threads
+  /// threads, using the scratch space of workers [first_worker,
+  /// first_worker + num_threads).  Leaves the bucket boundaries in
+  /// step.bounds.
+  void
+  partition(
+    RandomAccessIterator begin,
+    diff_t length,
+    step_data &step,
+    std::size_t num_threads,
+    std::size_t first_worker = 0
+  ){
+    build_splitters(begin, length, step);
+
+    diff_t total_blocks = length / block_size;
+    parallel::run_team(num_threads, [&](std::size_t id){
+      diff_t stripe_begin = total_blocks * id / num_threads * block_size;
+      diff_t stripe_end = id + 1 == num_threads ? length
+                        : total_blocks * (id + 1) / num_threads * block_size;
+      classify_stripe(begin, stripe_begin, stripe_end, step, *locals[first_worker + id]);
+    });
+
+    step.bounds[0] = 0;
+    for(std::size_t b = 0; b < step.num_buckets; b++){
+      diff_t size = 0;
+      for(std::size_t t = 0; t < num_threads; t++)
+        size += locals[first_worker + t]->bucket_size[b];
+      step.bounds[b + 1] = step.bounds[b] + size;
+    }
+
+    diff_t full_end = gather_full_blocks(begin, length, num_threads, first_worker) * block_size;
+    for(std::size_t b = 0; b < step.num_buckets; b++){
+      diff_t area_begin = align_up(step.bounds[b]);
+      diff_t area_end = std::min(align_up(step.bounds[b + 1]), full_end);
+      step.buckets[b].write = area_begin;
+      step.buckets[b].read = std::max(area_end, area_begin) - block_size;
+    }
+    step.overflow_bucket = -1;
+
+    parallel::run_team(num_threads, [&](std::size_t id){
+      permute_blocks(begin, length, step, *locals[first_worker + id], id, num_threads);
+    });
+
+    cleanup(begin, step, num_threads, first_worker);
+  }
+
+
+  Compare comp;
+  std::vector<std::unique_ptr<local_data> > locals;
+  std::vector<std::unique_ptr<step_data> > steps;
+};
+
+};
+
+
+/**
+*  @brief Sort the elements of a sequence in parallel using a predicate for
+*  comparison.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @param  comp    A comparison functor.
+*  @return  Nothing.
+*
+*  In-place samplesort using up to SCP::parallel::thread_count threads.  Not
+*  stable.
+*/
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+void
+parallel_samplesort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::difference_type diff_t;
+  diff_t length = last - first;
+  std::size_t workers = std::min<std::size_t>(
+    parallel::get_thread_count(),
+    std::max<diff_t>(1, length / ssort::min_parallel_chunk));
+  ssort::samplesort_engine<RandomAccessIterator, Compare>(comp, workers).sort(first, last);
+}
+
+
+/**
+*  @brief Sort the elements of a sequence in parallel.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @return  Nothing.
+*/
+template<
+  typename RandomAccessIterator>
+inline
+void
+parallel_samplesort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  parallel_samplesort(first, last, std::less<T>());
+}
+
+};
@@ -0,0 +1,131 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+/*******************************************************************************
+@brief Accounting of the heap memory a sort allocates, for --scratch-bytes.
+
+The replaceable global operator new and operator delete are replaced here with
+ones keeping a count of the bytes allocated while accounting is on, and the
+most that count reached.  The array, nothrow and sized forms of the standard
+library go through these two, so std::get_temporary_buffer(), as
+std::stable_sort uses, is counted as well as containers are.  The over-aligned
+forms aren't replaced, and go uncounted.  Each allocation carries a header
+holding its size, so what is freed is known whatever form frees it.
+
+Memory freed during accounting that was allocated before it began lowers the
+count, but not the peak, which is relative to what was allocated when
+accounting began.
+
+This defines the replacement functions, so it may only be included from one
+translation unit.
+*******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+
+namespace SCP{
+namespace scratch{
+
+inline std::atomic<bool> counting{false};
+inline std::atomic<std::ptrdiff_t> current{0};
+inline std::atomic<std::ptrdiff_t> peak{0};
+
+/// Room in front of each allocation for its size, keeping the alignment
+/// operator new guarantees.
+enum { header_bytes = alignof(std::max_align_t) };
+
+
+inline
+void
+start(
+){
+  current.store(0);
+  peak.store(0);
+  counting.store(true);
+}
+
+
+/// Stops accounting, returning the most bytes allocated at once since start().
+inline
+std::size_t
+stop(
+){
+  counting.store(false);
+  return peak.load();
+}
+
+
+inline
+void
+allocated(
+  std::ptrdiff_t bytes
+){
+  const std::ptrdiff_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  std::ptrdiff_t seen = peak.load(std::memory_order_relaxed);
+  while(now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {}
+}
+
+};
+};
+
+
+void *
+operator new(
+  std::size_t size
+){
+  char *block = static_cast<char *>(std::malloc(size + SCP::scratch::header_bytes));
+  if(block == nullptr)
+    throw std::bad_alloc();
+  *reinterpret_cast<std::size_t *>(block) = size;
+  if(SCP::scratch::counting.load(std::memory_order_relaxed))
+    SCP::scratch::allocated(std::ptrdiff_t(size));
+  return block + SCP::scratch::header_bytes;
+}
+
+
+void
+operator delete(
+  void *pointer
+) noexcept {
+  if(pointer == nullptr)
+    return;
+  char *block = static_cast<char *>(pointer) - SCP::scratch::header_bytes;
+  if(SCP::scratch::counting.load(std::memory_order_relaxed))
+    SCP::scratch::allocated(-std::ptrdiff_t(*reinterpret_cast<std::size_t *>(block)));
+  std::free(block);
+}
+
+
+void
+operator delete(
+  void *pointer,
+  std::size_t
+) noexcept {
+  operator delete(pointer);
+}
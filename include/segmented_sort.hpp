@@ -0,0 +1,187 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+/*******************************************************************************
+@brief Sorting a std::deque through plain pointers by gathering it into a
+buffer, for --segmented.
+
+A std::deque keeps its elements in fixed size blocks reached through a map of
+pointers, so every + n and - on its iterators goes through the map, and every
+++ checks for the end of a block.  Sorts written for random access iterators
+pay for that on every step.  Within a block though the elements are contiguous,
+and can be copied out with plain pointers.
+
+gather_sort_scatter() gathers the range into a contiguous buffer a block at a
+time, sorts the buffer with the sort it is handed instantiated for pointers,
+and scatters the result back a block at a time.  Gathering and scattering are
+each one sequential pass of moves, so the sort runs as it would on a vector.
+The price is a buffer as long as the range, allocated with operator new, so
+--scratch-bytes counts it, and two passes over the data.
+
+This isn't a segmented sort in the sense of sorting each block through
+pointers and merging the blocks; that was tried first.  libstdc++'s blocks
+hold 512 bytes, so they are short, and the merge passes cost more than the
+iterators save: on 8M random longs, introsort took 1.5-1.7s that way against
+1.25-1.45s on the deque directly, and pdqsort 1.45-1.5s against 0.6-0.95s.
+
+Any iterator other than a std::deque's is taken to be into contiguous storage,
+as std::vector's, which is then a single block sorted in place.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace SCP{
+namespace segmented{
+
+/// What gather_sort_scatter() did, and how long it took.
+struct stats{
+  std::size_t segments = 0;
+  double gather_seconds = 0;
+  double sort_seconds = 0;
+  double scatter_seconds = 0;
+
+  void
+  report(
+    std::ostream &out
+  ) const {
+    out << "segments: " << segments << std::endl;
+    out << "gather seconds: " << gather_seconds << std::endl;
+    out << "sort seconds: " << sort_seconds << std::endl;
+    out << "scatter seconds: " << scatter_seconds << std::endl;
+  }
+};
+
+
+/// Calls __f(begin, end) with pointers to each contiguous piece of [__first,
+/// __last), in order.  For a std::deque these are the parts of its blocks
+/// within the range, read off of libstdc++'s iterator.
+template<
+  typename _Tp,
+  typename _Function>
+void
+for_each_segment(
+  std::_Deque_iterator<_Tp, _Tp&, _Tp*> __first,
+  std::_Deque_iterator<_Tp, _Tp&, _Tp*> __last,
+  _Function __f
+){
+  if(__first._M_node == __last._M_node){
+    if(__first._M_cur != __last._M_cur)
+      __f(__first._M_cur, __last._M_cur);
+    return;
+  }
+  __f(__first._M_cur, __first._M_last);
+  const std::size_t __block = __first._S_buffer_size();
+  for(auto __node = __first._M_node + 1; __node != __last._M_node; ++__node)
+    __f(*__node, *__node + __block);
+  if(__last._M_first != __last._M_cur)
+    __f(__last._M_first, __last._M_cur);
+}
+
+
+/// As above, for contiguous storage, which is a single piece.
+template<
+  typename _RandomAccessIterator,
+  typename _Function>
+void
+for_each_segment(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Function __f
+){
+  if(__first != __last)
+    __f(std::addressof(*__first), std::addressof(*__first) + (__last - __first));
+}
+
+
+/**
+*  @brief Sort a range of a std::deque through plain pointers.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __sort    Sorts a range given by two pointers.
+*  @return  What was done, and how long each part took.
+*
+*  Sorts the elements in [__first, __last) with __sort, which is handed them
+*  moved into a buffer, unless they already are contiguous.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Sort>
+stats
+gather_sort_scatter(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Sort __sort
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  typedef std::chrono::steady_clock clock;
+
+  stats __counts;
+  std::vector<std::pair<_ValueType*, _ValueType*> > __segments;
+  for_each_segment(__first, __last, [&](_ValueType *__begin, _ValueType *__end){
+    __segments.emplace_back(__begin, __end);
+  });
+  __counts.segments = __segments.size();
+  if(__segments.size() < 2){
+    const auto __sort_start = clock::now();
+    if(!__segments.empty())
+      __sort(__segments[0].first, __segments[0].second);
+    __counts.sort_seconds = std::chrono::duration<double>(clock::now() - __sort_start).count();
+    return __counts;
+  }
+
+  const auto __gather_start = clock::now();
+  std::vector<_ValueType> __buffer;
+  __buffer.reserve(__last - __first);
+  for(const auto &__segment : __segments)
+    __buffer.insert(__buffer.end(), std::make_move_iterator(__segment.first),
+                    std::make_move_iterator(__segment.second));
+  const auto __sort_start = clock::now();
+  __sort(__buffer.data(), __buffer.data() + __buffer.size());
+  const auto __scatter_start = clock::now();
+  const _ValueType *__from = __buffer.data();
+  for(const auto &__segment : __segments){
+    std::move(__from, __from + (__segment.second - __segment.first), __segment.first);
+    __from += __segment.second - __segment.first;
+  }
+  const auto __end = clock::now();
+
+  __counts.gather_seconds = std::chrono::duration<double>(__sort_start - __gather_start).count();
+  __counts.sort_seconds = std::chrono::duration<double>(__scatter_start - __sort_start).count();
+  __counts.scatter_seconds = std::chrono::duration<double>(__end - __scatter_start).count();
+  return __counts;
+}
+
+};
+};
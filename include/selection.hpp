@@ -0,0 +1,347 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+/*******************************************************************************
+@brief Selection algorithms, for the partial and select modes: each puts the
+element that belongs at nth there, with nothing greater before it and nothing
+less after it.
+
+ * introselect: quickselect around the median of three, as introsort
+   partitions, falling back to heap_select() once it has taken 2 log2(n)
+   partitions, as std::nth_element.
+ * simd_quickselect: the same, but partitioning with the vectorized kernels of
+   simd_partition.hpp where they apply.
+ * floyd_rivest_select: before partitioning a range, selects a pivot close to
+   the nth element from a sample of about n^(2/3) elements around its expected
+   position, recursively.  The range then usually shrinks to a few sample sizes
+   in one step, so it takes about n + min(k, n - k) comparisons, where
+   quickselect takes over 2n.
+ * heap_select_nth: heap_select() of the nth + 1 smallest, whose largest is
+   then the nth.  O(n log k) for the kth smallest, so only a contender for
+   small k.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <bits/predefined_ops.h>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#include "introsort.hpp"
+#include "simd_partition.hpp"
+
+
+namespace SCP{
+
+/// This is a helper function for the select routines.
+template<
+  typename _RandomAccessIterator,
+  typename _Size,
+  typename _Compare>
+void
+introselect_loop(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last,
+  _Size __depth_limit,
+  _Compare __comp
+){
+  while (__last - __first > 3){
+    if (__depth_limit == 0){
+      heap_select(__first, __nth + 1, __last, __comp);
+      std::iter_swap(__first, __nth);
+      return;
+    }
+    --__depth_limit;
+    _RandomAccessIterator __cut = unguarded_partition_pivot(__first, __last, __comp);
+    if (__cut <= __nth)
+      __first = __cut;
+    else
+      __last = __cut;
+  }
+  std::__insertion_sort(__first, __last, __comp);
+}
+
+
+/// This is a helper function for the select routines.
+template<
+  typename _RandomAccessIterator,
+  typename _Size,
+  typename _Compare>
+void
+simd_quickselect_loop(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last,
+  _Size __depth_limit,
+  _Compare __comp
+){
+  while (__last - __first > 3){
+    if (__depth_limit == 0){
+      heap_select(__first, __nth + 1, __last, __comp);
+      std::iter_swap(__first, __nth);
+      return;
+    }
+    --__depth_limit;
+    _RandomAccessIterator __cut = simd_partition_pivot(__first, __last, __comp);
+    if (__cut == __nth)
+      return;
+    if (__cut < __nth)
+      __first = __cut + 1;
+    else
+      __last = __cut;
+  }
+  std::__insertion_sort(__first, __last, __comp);
+}
+
+
+/// This is a helper function for the select routines.  Selects within
+/// [__first + __left, __first + __right], both ends included, as in Floyd and
+/// Rivest's Algorithm 489.
+template<
+  typename _RandomAccessIterator,
+  typename _Distance,
+  typename _Compare>
+void
+floyd_rivest_loop(
+  _RandomAccessIterator __first,
+  _Distance __left,
+  _Distance __right,
+  _Distance __k,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  auto __less_val = __gnu_cxx::__ops::__iter_comp_val(__comp);
+  auto __val_less = __gnu_cxx::__ops::__val_comp_iter(__comp);
+
+  while (__right > __left){
+    if (__right - __left > 600){
+      // Narrow [__left, __right] to where the sample puts the kth element.
+      const double __n = __right - __left + 1;
+      const double __i = __k - __left + 1;
+      const double __z = std::log(__n);
+      const double __s = 0.5 * std::exp(2 * __z / 3);
+      const double __sd = 0.5 * std::sqrt(__z * __s * (__n - __s) / __n)
+                        * (__i < __n / 2 ? -1 : 1);
+      const _Distance __new_left = std::max(
+          __left, _Distance(__k - __i * __s / __n + __sd));
+      const _Distance __new_right = std::min(
+          __right, _Distance(__k + (__n - __i) * __s / __n + __sd));
+      floyd_rivest_loop(__first, __new_left, __new_right, __k, __comp);
+    }
+
+    const _ValueType __t = *(__first + __k);
+    _Distance __i = __left;
+    _Distance __j = __right;
+    std::iter_swap(__first + __left, __first + __k);
+    if (__val_less(__t, __first + __right))
+      std::iter_swap(__first + __right, __first + __left);
+    while (__i < __j){
+      std::iter_swap(__first + __i, __first + __j);
+      ++__i;
+      --__j;
+      while (__less_val(__first + __i, __t))
+        ++__i;
+      while (__val_less(__t, __first + __j))
+        --__j;
+    }
+    if (!__less_val(__first + __left, __t) && !__val_less(__t, __first + __left)){
+      std::iter_swap(__first + __left, __first + __j);
+    }else{
+      ++__j;
+      std::iter_swap(__first + __j, __first + __right);
+    }
+    if (__j <= __k)
+      __left = __j + 1;
+    if (__k <= __j)
+      __right = __j - 1;
+  }
+}
+
+
+/**
+*  @brief Put the element that belongs at __nth there, with a quickselect.
+*  @param  __first   An iterator.
+*  @param  __nth     Another iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  Afterwards *__nth is the element that would be there if [__first, __last)
+*  were sorted, no element before it is greater and no element after it is
+*  less.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+introselect(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last
+){
+  if (__first == __last || __nth == __last)
+    return;
+  introselect_loop(__first, __nth, __last, std::__lg(__last - __first) * 2,
+                   __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+introselect(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first == __last || __nth == __last)
+    return;
+  introselect_loop(__first, __nth, __last, std::__lg(__last - __first) * 2,
+                   __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+
+/**
+*  @brief As introselect(), with a vectorized partition.
+*
+*  A predicate always uses the scalar partition.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+simd_quickselect(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last
+){
+  if (__first == __last || __nth == __last)
+    return;
+  simd_quickselect_loop(__first, __nth, __last, std::__lg(__last - __first) * 2,
+                        __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+simd_quickselect(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first == __last || __nth == __last)
+    return;
+  simd_quickselect_loop(__first, __nth, __last, std::__lg(__last - __first) * 2,
+                        __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+
+/**
+*  @brief As introselect(), choosing pivots from a sample as Floyd and Rivest
+*  do.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+floyd_rivest_select(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last
+){
+  if (__first == __last || __nth == __last)
+    return;
+  floyd_rivest_loop(__first, decltype(__last - __first)(0),
+                    (__last - __first) - 1, __nth - __first,
+                    __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+floyd_rivest_select(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first == __last || __nth == __last)
+    return;
+  floyd_rivest_loop(__first, decltype(__last - __first)(0),
+                    (__last - __first) - 1, __nth - __first,
+                    __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+
+/**
+*  @brief As introselect(), by keeping a heap of the smallest elements.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+heap_select_nth(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last
+){
+  if (__first == __last || __nth == __last)
+    return;
+  heap_select(__first, __nth + 1, __last, __gnu_cxx::__ops::__iter_less_iter());
+  std::iter_swap(__first, __nth);
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+heap_select_nth(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __nth,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first == __last || __nth == __last)
+    return;
+  heap_select(__first, __nth + 1, __last,
+              __gnu_cxx::__ops::__iter_comp_iter(__comp));
+  std::iter_swap(__first, __nth);
+}
+
+};
@@ -0,0 +1,349 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+/*******************************************************************************
+@brief Vectorized merging of two sorted runs of 32 or 64 bit signed integers,
+used as the linear phase of the timsort merges.
+
+The classic bitonic merge of Inoue et al.: one vector of keys is held back in a
+register, and each step loads the next vector from whichever run has the
+smaller head.  Reversing one vector and taking the lane-wise min and max of the
+two gives two bitonic halves, and log2(lanes) compare-exchanges within each
+vector sort them.  The lower half is stored and the upper half is held back for
+the next step.
+
+Galloping is still better for skewed runs, so the merge also counts how many
+keys in a row came from one run, a whole vector at a time.  It stops once that
+reaches the caller's threshold, finishes the held back vector with a scalar
+merge and reports which run was winning, so the caller can gallop through it.
+
+The kernels need AVX2; on other CPUs merge_kernels<Key>() is empty and the
+caller keeps its scalar merge.  Integer keys that compare equal are identical,
+so the loss of stability doesn't show.
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "simd_network.hpp"
+
+
+namespace SCP{
+namespace simd{
+
+/// Keys the merge kernels handle: signed 32 and 64 bit integers.
+template<
+  typename T>
+inline constexpr bool mergeable_v =
+     network_sortable_v<T>
+  && std::is_signed<T>::value;
+
+
+/// Which run a merge kernel stopped for.
+enum merge_stop{
+  merge_ran_out,  // one of the runs has less than a vector left
+  merge_a_winning,
+  merge_b_winning
+};
+
+
+/// Merges ascending runs [a, a_end) and [b, b_end) from the front, writing to
+/// dest, until one has less than a vector left or gallop_after keys in a row
+/// come from one run.  Advances a, b and dest past what was merged.  dest may
+/// be the start of the gap in front of b.
+template<
+  typename Key>
+using merge_forward_kernel = merge_stop (*)(
+  const Key *&a, const Key *a_end,
+  const Key *&b, const Key *b_end,
+  Key *&dest,
+  std::ptrdiff_t gallop_after);
+
+
+/// As merge_forward_kernel, but from the back: a_end, b_end and dest_end
+/// move down, and dest_end may be the end of the gap behind b.
+template<
+  typename Key>
+using merge_backward_kernel = merge_stop (*)(
+  const Key *a, const Key *&a_end,
+  const Key *b, const Key *&b_end,
+  Key *&dest_end,
+  std::ptrdiff_t gallop_after);
+
+
+template<
+  typename Key>
+struct merge_kernel_pair{
+  merge_forward_kernel<Key> forward;
+  merge_backward_kernel<Key> backward;
+};
+
+
+/*******************************************************************************
+The merge loops, written against an Ops type for one instruction set and key
+width.  Ops provides:
+
+  lanes                       keys per vector.
+  merge(x, y, lo, hi)         merges the sorted vectors at x and y, storing the
+                              lower half at lo and the upper half at hi.  Both
+                              inputs are read before either output is written.
+
+As with bitonic_network(), only pointers cross into Ops.
+*******************************************************************************/
+template<
+  typename Ops>
+inline
+merge_stop
+vector_merge_forward(
+  const typename Ops::key_type *&a,
+  const typename Ops::key_type *a_end,
+  const typename Ops::key_type *&b,
+  const typename Ops::key_type *b_end,
+  typename Ops::key_type *&dest,
+  std::ptrdiff_t gallop_after
+){
+  typedef typename Ops::key_type Key;
+  const std::ptrdiff_t lanes = Ops::lanes;
+  if(a_end - a < 2 * lanes || b_end - b < lanes)
+    return merge_ran_out;
+
+  Key held[Ops::lanes];
+  for(std::ptrdiff_t i = 0; i < lanes; i++)
+    held[i] = a[i];
+  a += lanes;
+
+  merge_stop stop = merge_ran_out;
+  std::ptrdiff_t a_count = 0, b_count = 0;
+  while(a_end - a >= lanes && b_end - b >= lanes){
+    const bool from_b = *b < *a;
+    const Key *next = from_b ? b : a;
+    // The whole vector comes before the other run.
+    const bool swept = next[lanes - 1] < (from_b ? *a : *b);
+    a_count = !from_b && swept ? a_count + lanes : 0;
+    b_count =  from_b && swept ? b_count + lanes : 0;
+    a += from_b ? 0 : lanes;
+    b += from_b ? lanes : 0;
+    Ops::merge(held, next, dest, held);
+    dest += lanes;
+    if(b_count >= gallop_after){ stop = merge_b_winning; break; }
+    if(a_count >= gallop_after){ stop = merge_a_winning; break; }
+  }
+
+  // Whatever is held back still has to be merged with both runs.
+  for(std::ptrdiff_t i = 0; i < lanes; ){
+    if(a < a_end && *a < held[i] && (b == b_end || !(*b < *a)))
+      *dest++ = *a++;
+    else if(b < b_end && *b < held[i])
+      *dest++ = *b++;
+    else
+      *dest++ = held[i++];
+  }
+  return stop;
+}
+
+
+template<
+  typename Ops>
+inline
+merge_stop
+vector_merge_backward(
+  const typename Ops::key_type *a,
+  const typename Ops::key_type *&a_end,
+  const typename Ops::key_type *b,
+  const typename Ops::key_type *&b_end,
+  typename Ops::key_type *&dest_end,
+  std::ptrdiff_t gallop_after
+){
+  typedef typename Ops::key_type Key;
+  const std::ptrdiff_t lanes = Ops::lanes;
+  if(a_end - a < 2 * lanes || b_end - b < lanes)
+    return merge_ran_out;
+
+  Key held[Ops::lanes];
+  a_end -= lanes;
+  for(std::ptrdiff_t i = 0; i < lanes; i++)
+    held[i] = a_end[i];
+
+  merge_stop stop = merge_ran_out;
+  std::ptrdiff_t a_count = 0, b_count = 0;
+  while(a_end - a >= lanes && b_end - b >= lanes){
+    const bool from_b = a_end[-1] < b_end[-1];
+    const Key *next = (from_b ? b_end : a_end) - lanes;
+    const bool swept = (from_b ? a_end[-1] : b_end[-1]) < next[0];
+    a_count = !from_b && swept ? a_count + lanes : 0;
+    b_count =  from_b && swept ? b_count + lanes : 0;
+    a_end -= from_b ? 0 : lanes;
+    b_end -= from_b ? lanes : 0;
+    dest_end -= lanes;
+    Ops::merge(held, next, held, dest_end);
+    if(b_count >= gallop_after){ stop = merge_b_winning; break; }
+    if(a_count >= gallop_after){ stop = merge_a_winning; break; }
+  }
+
+  for(std::ptrdiff_t i = lanes; i > 0; ){
+    if(a < a_end && held[i - 1] < a_end[-1] && (b == b_end || !(a_end[-1] < b_end[-1])))
+      *--dest_end = *--a_end;
+    else if(b < b_end && held[i - 1] < b_end[-1])
+      *--dest_end = *--b_end;
+    else
+      *--dest_end = held[--i];
+  }
+  return stop;
+}
+
+
+#ifdef SCP_SIMD_X86
+
+#define SCP_AVX2 __attribute__((target("avx2")))
+
+
+struct avx2_merge_ops_32{
+  typedef std::int32_t key_type;
+  enum { lanes = 8 };
+
+  SCP_AVX2 static void
+  merge(
+    const key_type *x,
+    const key_type *y,
+    key_type *lo,
+    key_type *hi
+  ){
+    __m256i a = _mm256_loadu_si256((const __m256i*)x);
+    __m256i b = _mm256_loadu_si256((const __m256i*)y);
+    b = _mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    __m256i l = _mm256_min_epi32(a, b);
+    __m256i h = _mm256_max_epi32(a, b);
+    _mm256_storeu_si256((__m256i*)lo, clean(l));
+    _mm256_storeu_si256((__m256i*)hi, clean(h));
+  }
+
+  // Sorts a bitonic vector.
+  SCP_AVX2 static __m256i
+  clean(
+    __m256i v
+  ){
+    __m256i p = _mm256_permute4x64_epi64(v, 0x4E);
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xF0);
+    p = _mm256_shuffle_epi32(v, 0x4E);
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xCC);
+    p = _mm256_shuffle_epi32(v, 0xB1);
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xAA);
+    return v;
+  }
+};
+
+
+struct avx2_merge_ops_64{
+  typedef std::int64_t key_type;
+  enum { lanes = 4 };
+
+  SCP_AVX2 static void
+  merge(
+    const key_type *x,
+    const key_type *y,
+    key_type *lo,
+    key_type *hi
+  ){
+    __m256i a = _mm256_loadu_si256((const __m256i*)x);
+    __m256i b = _mm256_loadu_si256((const __m256i*)y);
+    b = _mm256_permute4x64_epi64(b, 0x1B);
+    __m256i a_greater = _mm256_cmpgt_epi64(a, b);
+    __m256i l = _mm256_blendv_epi8(a, b, a_greater);
+    __m256i h = _mm256_blendv_epi8(b, a, a_greater);
+    _mm256_storeu_si256((__m256i*)lo, clean(l));
+    _mm256_storeu_si256((__m256i*)hi, clean(h));
+  }
+
+  SCP_AVX2 static __m256i
+  clean(
+    __m256i v
+  ){
+    __m256i p = _mm256_permute4x64_epi64(v, 0x4E);
+    __m256i v_greater = _mm256_cmpgt_epi64(v, p);
+    __m256i mn = _mm256_blendv_epi8(v, p, v_greater);
+    __m256i mx = _mm256_blendv_epi8(p, v, v_greater);
+    v = _mm256_blend_epi32(mn, mx, 0xF0);
+    p = _mm256_permute4x64_epi64(v, 0xB1);
+    v_greater = _mm256_cmpgt_epi64(v, p);
+    mn = _mm256_blendv_epi8(v, p, v_greater);
+    mx = _mm256_blendv_epi8(p, v, v_greater);
+    return _mm256_blend_epi32(mn, mx, 0xCC);
+  }
+};
+
+
+#define SCP_MERGE_KERNELS(name, ops)                                           \
+SCP_AVX2 __attribute__((flatten)) inline merge_stop                            \
+name##_forward(const ops::key_type *&a, const ops::key_type *a_end,            \
+               const ops::key_type *&b, const ops::key_type *b_end,            \
+               ops::key_type *&dest, std::ptrdiff_t gallop_after){            \
+  return vector_merge_forward<ops>(a, a_end, b, b_end, dest, gallop_after);    \
+}                                                                              \
+SCP_AVX2 __attribute__((flatten)) inline merge_stop                            \
+name##_backward(const ops::key_type *a, const ops::key_type *&a_end,           \
+                const ops::key_type *b, const ops::key_type *&b_end,           \
+                ops::key_type *&dest_end, std::ptrdiff_t gallop_after){       \
+  return vector_merge_backward<ops>(a, a_end, b, b_end, dest_end, gallop_after);\
+}
+
+SCP_MERGE_KERNELS(avx2_merge_32, avx2_merge_ops_32)
+SCP_MERGE_KERNELS(avx2_merge_64, avx2_merge_ops_64)
+
+#undef SCP_MERGE_KERNELS
+#undef SCP_AVX2
+
+#endif
+
+
+/// The merge kernels this CPU supports for keys of the given width, or a pair
+/// of nullptrs.
+template<
+  typename Key>
+merge_kernel_pair<Key>
+select_merge_kernels(
+){
+#ifdef SCP_SIMD_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")){
+    if constexpr(sizeof(Key) == 4) return {avx2_merge_32_forward, avx2_merge_32_backward};
+    else                           return {avx2_merge_64_forward, avx2_merge_64_backward};
+  }
+#endif
+  return {nullptr, nullptr};
+}
+
+
+template<
+  typename Key>
+inline
+merge_kernel_pair<Key>
+merge_kernels(
+){
+  static const merge_kernel_pair<Key> selected = select_merge_kernels<Key>();
+  return selected;
+}
+
+};
+};
@@ -0,0 +1,422 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief Vectorized bitonic sorting networks for small blocks of 32 and 64 bit
+integer keys, usable as the small-sort kernel of the other engines.
+
+A range of up to max_network_size elements is copied into an aligned block of
+8, 16, 32 or 64 elements, padded with the largest key, sorted with a bitonic
+network and copied back.  Compare-exchanges between elements at least one
+vector apart are a min and a max of two whole vectors.  The ones within a vector
+permute the vector against itself and blend the mins and maxes by lane.
+
+The kernel is picked once at runtime: AVX2 if the CPU has it, SSE4.2 otherwise.
+If neither is available, or the keys aren't 32 or 64 bit integers, or the
+comparison isn't the default ascending one, network_sort() returns false and
+the engine keeps its own insertion sort.  Engines only try the network at all
+when SCP::simd::use_networks is set (--small-sort=network).
+
+A network isn't stable, but integer keys that compare equal are identical, so
+the stable engines can still use it.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCP_SIMD_X86 1
+#endif
+
+
+namespace SCP{
+namespace simd{
+
+/// Set from --small-sort.  Engines only use the networks when this is set.
+inline bool use_networks = false;
+
+enum{
+  min_network_size = 8,
+  max_network_size = 64
+};
+
+
+/// Keys the networks handle: 32 and 64 bit integers.
+template<
+  typename T>
+inline constexpr bool network_sortable_v =
+     std::is_integral<T>::value
+  && !std::is_same<T, bool>::value
+  && (sizeof(T) == 4 || sizeof(T) == 8);
+
+
+/// Comparators the networks handle: those that sort T in ascending order.
+template<
+  typename T,
+  typename Compare>
+inline constexpr bool ascending_compare_v =
+     std::is_same<Compare, std::less<T> >::value
+  || std::is_same<Compare, std::less<> >::value;
+
+
+/// Sorts data[0, n) in place, where n is a power of two in
+/// [min_network_size, max_network_size].
+template<
+  typename Key>
+using network_kernel = void (*)(Key *data, std::size_t n);
+
+
+/*******************************************************************************
+The network itself, written against an Ops type for one instruction set and key
+width.  Ops provides:
+
+  lanes                       keys per vector.
+  exchange_vectors(lo, hi, ascending)
+                              compare-exchange the vectors at lo and hi, leaving
+                              the mins at lo if ascending, at hi otherwise.
+  exchange_lanes(p, base, j, k)
+                              the bitonic step (k, j) for j < lanes on the
+                              vector at p, holding keys base..base + lanes - 1.
+
+Only pointers cross into Ops, so no vector types appear here; the kernels are
+built with 'flatten' so that everything is inlined under their target.
+*******************************************************************************/
+template<
+  typename Ops>
+inline
+void
+bitonic_network(
+  typename Ops::key_type *data,
+  std::size_t n
+){
+  for(std::size_t k = 2; k <= n; k <<= 1){
+    for(std::size_t j = k >> 1; j > 0; j >>= 1){
+      if(j >= std::size_t(Ops::lanes)){
+        for(std::size_t block = 0; block < n; block += 2 * j)
+          for(std::size_t i = block; i < block + j; i += Ops::lanes)
+            Ops::exchange_vectors(data + i, data + i + j, (i & k) == 0);
+      }else{
+        for(std::size_t i = 0; i < n; i += Ops::lanes)
+          Ops::exchange_lanes(data + i, i, j, k);
+      }
+    }
+  }
+}
+
+
+#ifdef SCP_SIMD_X86
+
+#define SCP_AVX2 __attribute__((target("avx2")))
+#define SCP_SSE42 __attribute__((target("sse4.2")))
+
+
+struct avx2_ops_32{
+  typedef std::int32_t key_type;
+  enum { lanes = 8 };
+
+  SCP_AVX2 static void
+  exchange_vectors(
+    key_type *lo,
+    key_type *hi,
+    bool ascending
+  ){
+    __m256i a = _mm256_load_si256((const __m256i*)lo);
+    __m256i b = _mm256_load_si256((const __m256i*)hi);
+    __m256i mn = _mm256_min_epi32(a, b);
+    __m256i mx = _mm256_max_epi32(a, b);
+    _mm256_store_si256((__m256i*)lo, ascending ? mn : mx);
+    _mm256_store_si256((__m256i*)hi, ascending ? mx : mn);
+  }
+
+  SCP_AVX2 static void
+  exchange_lanes(
+    key_type *p,
+    std::size_t base,
+    std::size_t j,
+    std::size_t k
+  ){
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i v = _mm256_load_si256((const __m256i*)p);
+    __m256i partner = _mm256_permutevar8x32_epi32(
+      v, _mm256_xor_si256(lane, _mm256_set1_epi32(int(j))));
+    __m256i mn = _mm256_min_epi32(v, partner);
+    __m256i mx = _mm256_max_epi32(v, partner);
+    // A lane keeps the min if it is the lower of its pair in an ascending
+    // sequence, or the upper one in a descending sequence.
+    __m256i zero = _mm256_setzero_si256();
+    __m256i index = _mm256_add_epi32(lane, _mm256_set1_epi32(int(base)));
+    __m256i lower = _mm256_cmpeq_epi32(_mm256_and_si256(lane, _mm256_set1_epi32(int(j))), zero);
+    __m256i up = _mm256_cmpeq_epi32(_mm256_and_si256(index, _mm256_set1_epi32(int(k))), zero);
+    __m256i take_max = _mm256_xor_si256(lower, up);
+    _mm256_store_si256((__m256i*)p, _mm256_blendv_epi8(mn, mx, take_max));
+  }
+};
+
+
+struct avx2_ops_64{
+  typedef std::int64_t key_type;
+  enum { lanes = 4 };
+
+  SCP_AVX2 static void
+  exchange_vectors(
+    key_type *lo,
+    key_type *hi,
+    bool ascending
+  ){
+    __m256i a = _mm256_load_si256((const __m256i*)lo);
+    __m256i b = _mm256_load_si256((const __m256i*)hi);
+    __m256i a_greater = _mm256_cmpgt_epi64(a, b);
+    __m256i mn = _mm256_blendv_epi8(a, b, a_greater);
+    __m256i mx = _mm256_blendv_epi8(b, a, a_greater);
+    _mm256_store_si256((__m256i*)lo, ascending ? mn : mx);
+    _mm256_store_si256((__m256i*)hi, ascending ? mx : mn);
+  }
+
+  SCP_AVX2 static void
+  exchange_lanes(
+    key_type *p,
+    std::size_t base,
+    std::size_t j,
+    std::size_t k
+  ){
+    __m256i v = _mm256_load_si256((const __m256i*)p);
+    __m256i partner = j == 1 ? _mm256_permute4x64_epi64(v, 0xB1)
+                             : _mm256_permute4x64_epi64(v, 0x4E);
+    __m256i v_greater = _mm256_cmpgt_epi64(v, partner);
+    __m256i mn = _mm256_blendv_epi8(v, partner, v_greater);
+    __m256i mx = _mm256_blendv_epi8(partner, v, v_greater);
+    __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i index = _mm256_add_epi64(lane, _mm256_set1_epi64x(std::int64_t(base)));
+    __m256i lower = _mm256_cmpeq_epi64(_mm256_and_si256(lane, _mm256_set1_epi64x(std::int64_t(j))), zero);
+    __m256i up = _mm256_cmpeq_epi64(_mm256_and_si256(index, _mm256_set1_epi64x(std::int64_t(k))), zero);
+    __m256i take_max = _mm256_xor_si256(lower, up);
+    _mm256_store_si256((__m256i*)p, _mm256_blendv_epi8(mn, mx, take_max));
+  }
+};
+
+
+struct sse42_ops_32{
+  typedef std::int32_t key_type;
+  enum { lanes = 4 };
+
+  SCP_SSE42 static void
+  exchange_vectors(
+    key_type *lo,
+    key_type *hi,
+    bool ascending
+  ){
+    __m128i a = _mm_load_si128((const __m128i*)lo);
+    __m128i b = _mm_load_si128((const __m128i*)hi);
+    __m128i mn = _mm_min_epi32(a, b);
+    __m128i mx = _mm_max_epi32(a, b);
+    _mm_store_si128((__m128i*)lo, ascending ? mn : mx);
+    _mm_store_si128((__m128i*)hi, ascending ? mx : mn);
+  }
+
+  SCP_SSE42 static void
+  exchange_lanes(
+    key_type *p,
+    std::size_t base,
+    std::size_t j,
+    std::size_t k
+  ){
+    __m128i v = _mm_load_si128((const __m128i*)p);
+    __m128i partner = j == 1 ? _mm_shuffle_epi32(v, 0xB1)
+                             : _mm_shuffle_epi32(v, 0x4E);
+    __m128i mn = _mm_min_epi32(v, partner);
+    __m128i mx = _mm_max_epi32(v, partner);
+    __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i zero = _mm_setzero_si128();
+    __m128i index = _mm_add_epi32(lane, _mm_set1_epi32(int(base)));
+    __m128i lower = _mm_cmpeq_epi32(_mm_and_si128(lane, _mm_set1_epi32(int(j))), zero);
+    __m128i up = _mm_cmpeq_epi32(_mm_and_si128(index, _mm_set1_epi32(int(k))), zero);
+    __m128i take_max = _mm_xor_si128(lower, up);
+    _mm_store_si128((__m128i*)p, _mm_blendv_epi8(mn, mx, take_max));
+  }
+};
+
+
+struct sse42_ops_64{
+  typedef std::int64_t key_type;
+  enum { lanes = 2 };
+
+  SCP_SSE42 static void
+  exchange_vectors(
+    key_type *lo,
+    key_type *hi,
+    bool ascending
+  ){
+    __m128i a = _mm_load_si128((const __m128i*)lo);
+    __m128i b = _mm_load_si128((const __m128i*)hi);
+    __m128i a_greater = _mm_cmpgt_epi64(a, b);
+    __m128i mn = _mm_blendv_epi8(a, b, a_greater);
+    __m128i mx = _mm_blendv_epi8(b, a, a_greater);
+    _mm_store_si128((__m128i*)lo, ascending ? mn : mx);
+    _mm_store_si128((__m128i*)hi, ascending ? mx : mn);
+  }
+
+  SCP_SSE42 static void
+  exchange_lanes(
+    key_type *p,
+    std::size_t base,
+    std::size_t,
+    std::size_t k
+  ){
+    // j is always 1 with two lanes.
+    __m128i v = _mm_load_si128((const __m128i*)p);
+    __m128i partner = _mm_shuffle_epi32(v, 0x4E);
+    __m128i v_greater = _mm_cmpgt_epi64(v, partner);
+    __m128i mn = _mm_blendv_epi8(v, partner, v_greater);
+    __m128i mx = _mm_blendv_epi8(partner, v, v_greater);
+    bool up = (base & k) == 0;
+    __m128i take_min_first = up ? _mm_unpacklo_epi64(mn, mx)
+                                : _mm_unpacklo_epi64(mx, mn);
+    _mm_store_si128((__m128i*)p, take_min_first);
+  }
+};
+
+
+SCP_AVX2 __attribute__((flatten)) inline void
+avx2_network_32(std::int32_t *data, std::size_t n){ bitonic_network<avx2_ops_32>(data, n); }
+
+SCP_AVX2 __attribute__((flatten)) inline void
+avx2_network_64(std::int64_t *data, std::size_t n){ bitonic_network<avx2_ops_64>(data, n); }
+
+SCP_SSE42 __attribute__((flatten)) inline void
+sse42_network_32(std::int32_t *data, std::size_t n){ bitonic_network<sse42_ops_32>(data, n); }
+
+SCP_SSE42 __attribute__((flatten)) inline void
+sse42_network_64(std::int64_t *data, std::size_t n){ bitonic_network<sse42_ops_64>(data, n); }
+
+#undef SCP_AVX2
+#undef SCP_SSE42
+
+#endif
+
+
+/// The best kernel this CPU supports for keys of the given width, or nullptr.
+template<
+  typename Key>
+network_kernel<Key>
+select_kernel(
+){
+#ifdef SCP_SIMD_X86
+  __builtin_cpu_init();
+  if constexpr(sizeof(Key) == 4){
+    if(__builtin_cpu_supports("avx2")) return avx2_network_32;
+    if(__builtin_cpu_supports("sse4.2")) return sse42_network_32;
+  }else{
+    if(__builtin_cpu_supports("avx2")) return avx2_network_64;
+    if(__builtin_cpu_supports("sse4.2")) return sse42_network_64;
+  }
+#endif
+  return nullptr;
+}
+
+
+template<
+  typename Key>
+inline
+network_kernel<Key>
+kernel(
+){
+  static const network_kernel<Key> selected = select_kernel<Key>();
+  return selected;
+}
+
+
+/// Whether network_sort() can handle ranges of T sorted with Compare, so an
+/// engine can skip whatever it would otherwise do.  Checked before each use
+/// since the flag and CPU are only known at runtime.
+template<
+  typename T,
+  typename Compare>
+inline
+bool
+use_network(
+){
+  if constexpr(network_sortable_v<T> && ascending_compare_v<T, Compare>){
+    typedef std::conditional_t<sizeof(T) == 4, std::int32_t, std::int64_t> Key;
+    return use_networks && kernel<Key>() != nullptr;
+  }else{
+    return false;
+  }
+}
+
+
+/**
+*  @brief Sort a small range of integers in ascending order with a SIMD
+*  sorting network.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @return  Whether the range was sorted.
+*
+*  Returns false, leaving the range untouched, if it holds more than
+*  max_network_size elements or use_network() doesn't hold for its value type
+*  and std::less.
+*/
+template<
+  typename RandomAccessIterator>
+inline
+bool
+network_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if constexpr(network_sortable_v<T>){
+    typedef std::conditional_t<sizeof(T) == 4, std::int32_t, std::int64_t> Key;
+    std::size_t n = last - first;
+    if(n > std::size_t(max_network_size) || !use_network<T, std::less<T> >())
+      return false;
+    if(n < 2) return true;
+
+    // Unsigned keys are sorted as signed ones with the sign bit flipped.
+    const Key flip = std::is_signed<T>::value ? Key(0) : std::numeric_limits<Key>::min();
+    std::size_t padded = min_network_size;
+    while(padded < n) padded <<= 1;
+
+    alignas(64) Key block[max_network_size];
+    for(std::size_t i = 0; i < n; i++)
+      block[i] = Key(first[i]) ^ flip;
+    std::fill(block + n, block + padded, std::numeric_limits<Key>::max());
+
+    kernel<Key>()(block, padded);
+
+    for(std::size_t i = 0; i < n; i++)
+      first[i] = T(block[i] ^ flip);
+    return true;
+  }else{
+    return false;
+  }
+}
+
+};
+};
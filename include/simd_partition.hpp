@@ -0,0 +1,450 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+/*******************************************************************************
+@brief SCP::introsort with a vectorized partition step.
+
+simd_introsort_loop() is introsort_loop() with the same threshold, depth limit
+and heapsort fallback; only the partition differs.  The pivot is still the
+median of three moved to the front, but the rest of the range is partitioned a
+whole vector at a time:
+
+ * A vector of keys is compared against the broadcast pivot, giving a mask of
+   the keys that go left.
+ * The vector is rearranged so that those keys come first and the others last,
+   with AVX-512 compress/expand, or with AVX2 and a permutation table indexed
+   by the mask.
+ * The whole vector is stored both at the left write position and ending at
+   the right write position; the write positions then advance by the number
+   of lows and highs.
+
+One vector's worth of keys at each end is copied out before starting, so there
+is always room for these full-width stores without overwriting unread keys.
+The next vector is read from whichever end has less room.  What is left at the
+end is partitioned with scalar code.
+
+Keys equal to the pivot go right in even vectors and left in odd ones, so runs
+of equal keys split evenly, as they do with the Hoare partition of
+introsort_loop().  Since that is only a loose balance, the pivot itself is
+swapped to the partition point and left out of both sides, which guarantees
+progress.
+
+The kernel is picked at runtime (AVX-512F, then AVX2) and used for signed 32
+and 64 bit integers in contiguous storage sorted with the default comparison.
+Anything else, and ranges shorter than min_simd_partition, are partitioned
+with std::__unguarded_partition().
+*******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "huge_pages.hpp"
+#include "introsort.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCP_SIMD_PARTITION_X86 1
+#endif
+
+
+namespace SCP{
+namespace simd{
+
+/// Shorter ranges are partitioned with scalar code.  At least two vectors of
+/// the widest kernel.
+enum { min_simd_partition = 32 };
+
+
+/// Keys the partition kernels handle.
+template<
+  typename T>
+inline constexpr bool partitionable_v =
+     std::is_integral<T>::value
+  && std::is_signed<T>::value
+  && (sizeof(T) == 4 || sizeof(T) == 8);
+
+
+/// Iterators over contiguous storage.
+template<
+  typename RandomAccessIterator>
+inline constexpr bool contiguous_iterator_v =
+     std::is_pointer<RandomAccessIterator>::value
+  || std::is_same<RandomAccessIterator,
+       typename std::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>::iterator>::value
+  || std::is_same<RandomAccessIterator,
+       typename huge_pages::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>::iterator>::value;
+
+
+/// Partitions [first, last) around pivot and returns the number of keys moved
+/// to the front.  Keys less than the pivot go to the front and greater ones to
+/// the back; equal ones may go either way.  Requires last - first >=
+/// min_simd_partition.
+template<
+  typename T>
+using partition_kernel = std::size_t (*)(T *first, T *last, T pivot);
+
+
+/*******************************************************************************
+The partition loop, written against an Ops type for one instruction set and key
+width.  Ops provides:
+
+  lanes                       keys per vector.
+  partition_vector(in, left, right_end, pivot, equal_left)
+                              loads the vector at 'in', stores it rearranged
+                              with the low keys first at 'left' and at
+                              right_end - lanes, and returns how many keys were
+                              low.  Keys equal to the pivot count as low if
+                              equal_left is set.
+*******************************************************************************/
+template<
+  typename Ops>
+inline
+std::size_t
+vector_partition(
+  typename Ops::key_type *first,
+  typename Ops::key_type *last,
+  typename Ops::key_type pivot
+){
+  typedef typename Ops::key_type T;
+  const std::size_t lanes = Ops::lanes;
+
+  // The first and last vectors, and later the unread remainder.
+  T spare[3 * Ops::lanes];
+  std::copy(first, first + lanes, spare);
+  std::copy(last - lanes, last, spare + lanes);
+
+  T *read_left = first + lanes;
+  T *read_right = last - lanes;
+  T *write_left = first;
+  T *write_right = last;
+  bool equal_left = false;
+
+  while(std::size_t(read_right - read_left) >= lanes){
+    T *in;
+    if(read_left - write_left <= write_right - read_right){
+      in = read_left;
+      read_left += lanes;
+    }else{
+      read_right -= lanes;
+      in = read_right;
+    }
+    std::size_t low = Ops::partition_vector(in, write_left, write_right, pivot, equal_left);
+    write_left += low;
+    write_right -= lanes - low;
+    equal_left = !equal_left;
+  }
+
+  std::size_t remainder = read_right - read_left;
+  std::copy(read_left, read_right, spare + 2 * lanes);
+  for(std::size_t i = 0; i < 2 * lanes + remainder; i++){
+    T key = spare[i];
+    if(key < pivot || (key == pivot && (i & 1)))
+      *write_left++ = key;
+    else
+      *--write_right = key;
+  }
+  return write_left - first;
+}
+
+
+#ifdef SCP_SIMD_PARTITION_X86
+
+#define SCP_AVX2 __attribute__((target("avx2,popcnt")))
+#define SCP_AVX512 __attribute__((target("avx512f,popcnt")))
+
+
+/// For every mask of high lanes, the lane order putting the low lanes first.
+/// Indices are of 32 bit elements, so a 64 bit lane l is the pair 2l, 2l + 1.
+template<
+  int lanes>
+struct permutation_table{
+  alignas(32) std::int32_t index[1 << lanes][8];
+
+  constexpr
+  permutation_table(
+  ) : index() {
+    const int width = 8 / lanes;
+    for(int mask = 0; mask < (1 << lanes); mask++){
+      int position = 0;
+      for(int high = 0; high < 2; high++)
+        for(int lane = 0; lane < lanes; lane++)
+          if(((mask >> lane) & 1) == high)
+            for(int part = 0; part < width; part++)
+              index[mask][position++] = lane * width + part;
+    }
+  }
+};
+
+inline constexpr permutation_table<8> permutation_32{};
+inline constexpr permutation_table<4> permutation_64{};
+
+
+template<
+  typename T>
+struct avx2_partition_ops{
+  typedef T key_type;
+  enum { lanes = 32 / sizeof(T) };
+
+  SCP_AVX2 static std::size_t
+  partition_vector(
+    const T *in,
+    T *left,
+    T *right_end,
+    T pivot,
+    bool equal_left
+  ){
+    __m256i v = _mm256_loadu_si256((const __m256i*)in);
+    int high;
+    const std::int32_t *order;
+    if constexpr(sizeof(T) == 4){
+      __m256i p = _mm256_set1_epi32(pivot);
+      __m256i is_high = equal_left ? _mm256_cmpgt_epi32(v, p)
+                                   : _mm256_xor_si256(_mm256_cmpgt_epi32(p, v), _mm256_set1_epi32(-1));
+      high = _mm256_movemask_ps(_mm256_castsi256_ps(is_high));
+      order = permutation_32.index[high];
+    }else{
+      __m256i p = _mm256_set1_epi64x(pivot);
+      __m256i is_high = equal_left ? _mm256_cmpgt_epi64(v, p)
+                                   : _mm256_xor_si256(_mm256_cmpgt_epi64(p, v), _mm256_set1_epi64x(-1));
+      high = _mm256_movemask_pd(_mm256_castsi256_pd(is_high));
+      order = permutation_64.index[high];
+    }
+    __m256i arranged = _mm256_permutevar8x32_epi32(v, _mm256_load_si256((const __m256i*)order));
+    _mm256_storeu_si256((__m256i*)left, arranged);
+    _mm256_storeu_si256((__m256i*)(right_end - lanes), arranged);
+    return lanes - __builtin_popcount(high);
+  }
+};
+
+
+template<
+  typename T>
+struct avx512_partition_ops{
+  typedef T key_type;
+  enum { lanes = 64 / sizeof(T) };
+
+  SCP_AVX512 static std::size_t
+  partition_vector(
+    const T *in,
+    T *left,
+    T *right_end,
+    T pivot,
+    bool equal_left
+  ){
+    __m512i v = _mm512_loadu_si512(in);
+    __m512i arranged;
+    std::size_t low_count;
+    if constexpr(sizeof(T) == 4){
+      __m512i p = _mm512_set1_epi32(pivot);
+      __mmask16 low = equal_left ? _mm512_cmple_epi32_mask(v, p) : _mm512_cmplt_epi32_mask(v, p);
+      low_count = __builtin_popcount(low);
+      arranged = _mm512_mask_expand_epi32(_mm512_maskz_compress_epi32(low, v),
+                                          __mmask16(0xFFFFu << low_count),
+                                          _mm512_maskz_compress_epi32(__mmask16(~low), v));
+    }else{
+      __m512i p = _mm512_set1_epi64(pivot);
+      __mmask8 low = equal_left ? _mm512_cmple_epi64_mask(v, p) : _mm512_cmplt_epi64_mask(v, p);
+      low_count = __builtin_popcount(low);
+      arranged = _mm512_mask_expand_epi64(_mm512_maskz_compress_epi64(low, v),
+                                          __mmask8(0xFFu << low_count),
+                                          _mm512_maskz_compress_epi64(__mmask8(~low), v));
+    }
+    _mm512_storeu_si512(left, arranged);
+    _mm512_storeu_si512(right_end - lanes, arranged);
+    return low_count;
+  }
+};
+
+
+template<
+  typename T>
+SCP_AVX2 __attribute__((flatten)) std::size_t
+avx2_partition(T *first, T *last, T pivot){ return vector_partition<avx2_partition_ops<T> >(first, last, pivot); }
+
+template<
+  typename T>
+SCP_AVX512 __attribute__((flatten)) std::size_t
+avx512_partition(T *first, T *last, T pivot){ return vector_partition<avx512_partition_ops<T> >(first, last, pivot); }
+
+#undef SCP_AVX2
+#undef SCP_AVX512
+
+#endif
+
+
+/// The best partition kernel this CPU supports for T, or nullptr.
+template<
+  typename T>
+partition_kernel<T>
+select_partition_kernel(
+){
+#ifdef SCP_SIMD_PARTITION_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f")) return avx512_partition<T>;
+  if(__builtin_cpu_supports("avx2")) return avx2_partition<T>;
+#endif
+  return nullptr;
+}
+
+
+template<
+  typename T>
+inline
+partition_kernel<T>
+partition_kernel_for(
+){
+  static const partition_kernel<T> selected = select_partition_kernel<T>();
+  return selected;
+}
+
+};
+
+
+/// Partitions around the median of three, returning the pivot's final
+/// position: everything before it is not greater, everything after it not
+/// less.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+_RandomAccessIterator
+simd_partition_pivot(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+
+  _RandomAccessIterator __mid = __first + (__last - __first) / 2;
+  std::__move_median_to_first(__first, __first + 1, __mid, __last - 1, __comp);
+
+  _RandomAccessIterator __cut;
+  if constexpr (simd::partitionable_v<_ValueType>
+                && simd::contiguous_iterator_v<_RandomAccessIterator>
+                && std::is_same<_Compare, __gnu_cxx::__ops::_Iter_less_iter>::value){
+    simd::partition_kernel<_ValueType> __kernel = simd::partition_kernel_for<_ValueType>();
+    if (__kernel != nullptr && __last - __first > int(simd::min_simd_partition)){
+      _ValueType *__base = &*__first;
+      __cut = __first + 1 + __kernel(__base + 1, __base + (__last - __first), *__base);
+      std::iter_swap(__first, __cut - 1);
+      return __cut - 1;
+    }
+  }
+  __cut = std::__unguarded_partition(__first + 1, __last, __first, __comp);
+  std::iter_swap(__first, __cut - 1);
+  return __cut - 1;
+}
+
+
+/// This is a helper function for the sort routine.
+template<
+  typename _RandomAccessIterator,
+  typename _Size,
+  typename _Compare>
+void
+simd_introsort_loop(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Size __depth_limit,
+  _Compare __comp
+){
+  while (__last - __first > int(_S_threshold)){
+    if (__depth_limit == 0){
+      heapsort_impl(__first, __last, __comp);
+      return;
+    }
+    --__depth_limit;
+    _RandomAccessIterator __cut = simd_partition_pivot(__first, __last, __comp);
+    simd_introsort_loop(__cut + 1, __last, __depth_limit, __comp);
+    __last = __cut;
+  }
+  if (network_leaves<_RandomAccessIterator, _Compare>())
+    sort_leaf(__first, __last, __comp);
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+simd_sort_impl(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  if (__first != __last){
+    simd_introsort_loop(__first, __last, std::__lg(__last - __first) * 2, __comp);
+    if (!network_leaves<_RandomAccessIterator, _Compare>())
+      final_insertion_sort(__first, __last, __comp);
+  }
+}
+
+
+/**
+*  @brief Sort the elements of a sequence with a vectorized partition.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @return  Nothing.
+*
+*  Same as SCP::introsort() but for the partition step.
+*/
+template<
+  typename _RandomAccessIterator>
+inline
+void
+simd_introsort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last
+){
+  simd_sort_impl(__first, __last, __gnu_cxx::__ops::__iter_less_iter());
+}
+
+
+/**
+*  @brief Sort the elements of a sequence using a predicate for comparison.
+*  @param  __first   An iterator.
+*  @param  __last    Another iterator.
+*  @param  __comp    A comparison functor.
+*  @return  Nothing.
+*
+*  A predicate always uses the scalar partition.
+*/
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+simd_introsort(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  simd_sort_impl(__first, __last, __gnu_cxx::__ops::__iter_comp_iter(__comp));
+}
+
+};
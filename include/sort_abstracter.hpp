@@ -22,10 +22,23 @@ with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <timsort.hpp>
 #include "other_timsorts.hpp"
 
+#include "auto_sort.hpp"
+#include "block_merge_sort.hpp"
+#include "dual_pivot_quicksort.hpp"
+#include "heapsort.hpp"
 #include "introsort.hpp"
+#include "parallel_introsort.hpp"
+#include "parallel_timsort.hpp"
+#include "pdqsort.hpp"
+#include "radix_sort.hpp"
+#include "samplesort.hpp"
+#include "selection.hpp"
+#include "simd_partition.hpp"
 
 
 /*******************************************************************************
@@ -61,12 +74,234 @@ void (*get_sort_func_ptr(
     switch(args.chosen_sort){
       case std_sort:           return std::sort;
       case std_stable_sort:    return std::stable_sort;
+      case block_merge_sort:   return SCP::block_merge_sort;
       case introsort:          return SCP::introsort;
+      case heapsort:           return SCP::heapsort;
+      case simd_introsort:     return SCP::simd_introsort;
+      case dual_pivot_quicksort: return SCP::dual_pivot_quicksort;
+      case static_network:     return SCP::static_network_sort;
+      case parallel_introsort: return SCP::parallel_introsort;
       case sequential_timsort: return madlib::timsort;
-      //case parallel_timsort:   return madlib::timsort;
+      case parallel_timsort:   return SCP::parallel_timsort;
+      case parallel_samplesort: return SCP::parallel_samplesort;
       case gfx_timsort:        return gfx::timsort;
       case tvs_timsort:        return tim::timsort;
+      case gfx_powersort:      return gfx::powersort;
+      case tvs_powersort:      return tim::powersort;
+      case pdqsort:            return SCP::pdqsort;
+      case radix_sort:         return SCP::radix_sort;
+      case auto_:              return SCP::autosort::auto_sort;
       case null:            return null_sort;
       default: exit(-3);
     };
 }
+
+
+/*******************************************************************************
+Comparisons made through counting_less, for --count-comparisons.  Atomic so the
+parallel sorts can share it.
+*******************************************************************************/
+inline std::atomic<std::size_t> comparison_count{0};
+
+
+struct counting_less{
+  template<
+    typename T>
+  bool
+  operator()(
+    const T &lhs,
+    const T &rhs
+  ) const {
+    comparison_count.fetch_add(1, std::memory_order_relaxed);
+    return lhs < rhs;
+  }
+};
+
+
+/*******************************************************************************
+As get_sort_func_ptr(), but the sort compares through counting_less.  SIMD
+kernels only apply to the default comparison, so they are bypassed and every
+comparison is a counted scalar one.  madlib::timsort takes no comparator, so
+sequential_timsort can't be counted, and radix_sort makes no comparisons.  The
+counted auto sort never picks radix_sort, and its count includes the probe.
+*******************************************************************************/
+template<
+  typename RandomAccessItertor>
+void (*get_counting_sort_func_ptr(
+  const struct config args,
+  RandomAccessItertor
+))(
+  RandomAccessItertor,
+  RandomAccessItertor
+){
+    typedef RandomAccessItertor It;
+    switch(args.chosen_sort){
+      case std_sort:           return [](It b, It e){ std::sort(b, e, counting_less()); };
+      case std_stable_sort:    return [](It b, It e){ std::stable_sort(b, e, counting_less()); };
+      case block_merge_sort:   return [](It b, It e){ SCP::block_merge_sort(b, e, counting_less()); };
+      case introsort:          return [](It b, It e){ SCP::introsort(b, e, counting_less()); };
+      case heapsort:           return [](It b, It e){ SCP::heapsort(b, e, counting_less()); };
+      case simd_introsort:     return [](It b, It e){ SCP::simd_introsort(b, e, counting_less()); };
+      case dual_pivot_quicksort: return [](It b, It e){ SCP::dual_pivot_quicksort(b, e, counting_less()); };
+      case static_network:     return [](It b, It e){ SCP::static_network_sort(b, e, counting_less()); };
+      case parallel_introsort: return [](It b, It e){ SCP::parallel_introsort(b, e, counting_less()); };
+      case parallel_timsort:   return [](It b, It e){ SCP::parallel_timsort(b, e, counting_less()); };
+      case parallel_samplesort: return [](It b, It e){ SCP::parallel_samplesort(b, e, counting_less()); };
+      case gfx_timsort:        return [](It b, It e){ gfx::timsort(b, e, counting_less()); };
+      case tvs_timsort:        return [](It b, It e){ tim::timsort(b, e, counting_less()); };
+      case gfx_powersort:      return [](It b, It e){ gfx::powersort(b, e, counting_less()); };
+      case tvs_powersort:      return [](It b, It e){ tim::powersort(b, e, counting_less()); };
+      case pdqsort:            return [](It b, It e){ SCP::pdqsort(b, e, counting_less()); };
+      case auto_:              return [](It b, It e){ SCP::autosort::auto_sort(b, e, counting_less()); };
+      case null:            return null_sort;
+      case sequential_timsort:
+        cout << "Comparisons can't be counted for sequential_timsort." << endl;
+        exit(EINVAL);
+      case radix_sort:
+        cout << "radix_sort makes no comparisons to count." << endl;
+        exit(EINVAL);
+      default: exit(-3);
+    };
+}
+
+
+/*******************************************************************************
+Batch entry points, for --mode small_arrays with --batch-entry.  The function
+sorts each of the arrays of the given length laid out one after the other in
+[first, last), the last possibly shorter, doing the setup the sort needs once
+for all of them.  Sorts without one give nullptr.  With --count-comparisons,
+they compare through counting_less.
+*******************************************************************************/
+template<
+  typename RandomAccessItertor>
+void (*get_batch_sort_func_ptr(
+  const struct config args,
+  RandomAccessItertor
+))(
+  RandomAccessItertor,
+  RandomAccessItertor,
+  std::size_t
+){
+    typedef RandomAccessItertor It;
+    if(args.count_comparisons){
+      switch(args.chosen_sort){
+        case static_network:   return [](It b, It e, std::size_t l){ SCP::static_network_sort_batch(b, e, l, counting_less()); };
+        case gfx_timsort:      return [](It b, It e, std::size_t l){ gfx::timsort_batch(b, e, l, counting_less()); };
+        case tvs_timsort:      return [](It b, It e, std::size_t l){ tim::timsort_batch(b, e, l, counting_less()); };
+        default: return nullptr;
+      };
+    }
+    switch(args.chosen_sort){
+      case static_network:   return [](It b, It e, std::size_t l){ SCP::static_network_sort_batch(b, e, l); };
+      case gfx_timsort:      return [](It b, It e, std::size_t l){ gfx::timsort_batch(b, e, l); };
+      case tvs_timsort:      return [](It b, It e, std::size_t l){ tim::timsort_batch(b, e, l); };
+      default: return nullptr;
+    };
+}
+
+
+/*******************************************************************************
+The chosen sort if it is a stable one, for checking that it is with --verify,
+otherwise nullptr.  radix_sort is stable too, but it is left out because it only
+sorts integral keys: radix_key() is only enabled for integral types, and the
+check sorts doubles.
+*******************************************************************************/
+template<
+  typename RandomAccessItertor>
+void (*get_stable_sort_func_ptr(
+  const struct config args,
+  RandomAccessItertor
+))(
+  RandomAccessItertor,
+  RandomAccessItertor
+){
+    switch(args.chosen_sort){
+      case std_stable_sort:    return std::stable_sort;
+      case block_merge_sort:   return SCP::block_merge_sort;
+      case sequential_timsort: return madlib::timsort;
+      case parallel_timsort:   return SCP::parallel_timsort;
+      case gfx_timsort:        return gfx::timsort;
+      case tvs_timsort:        return tim::timsort;
+      case gfx_powersort:      return gfx::powersort;
+      case tvs_powersort:      return tim::powersort;
+      default: return nullptr;
+    };
+}
+
+
+/*******************************************************************************
+As get_sort_func_ptr(), for --mode partial and --mode select.  The function
+takes (first, middle, last).  For 'partial' it sorts the middle - first
+smallest elements into [first, middle), for 'select' it puts the element that
+belongs at middle there.  All but heap_select partial sort by selecting
+middle and then sorting what is in front of it.
+*******************************************************************************/
+template<
+  typename RandomAccessItertor>
+void (*get_select_func_ptr(
+  const struct config args,
+  RandomAccessItertor
+))(
+  RandomAccessItertor,
+  RandomAccessItertor,
+  RandomAccessItertor
+){
+    typedef RandomAccessItertor It;
+    if(args.chosen_mode == partial_mode){
+      switch(args.chosen_select){
+        case heap_select:      return [](It b, It m, It e){ SCP::SCP_partial_sort(b, m, e, __gnu_cxx::__ops::__iter_less_iter()); };
+        case introselect:      return [](It b, It m, It e){ SCP::introselect(b, m, e); SCP::introsort(b, m); };
+        case floyd_rivest:     return [](It b, It m, It e){ SCP::floyd_rivest_select(b, m, e); SCP::introsort(b, m); };
+        case simd_quickselect: return [](It b, It m, It e){ SCP::simd_quickselect(b, m, e); SCP::simd_introsort(b, m); };
+        case sort_truncate:    return [](It b, It, It e){ SCP::introsort(b, e); };
+        case null_select:      return [](It, It, It){};
+        default: exit(-3);
+      };
+    }
+    switch(args.chosen_select){
+      case heap_select:      return SCP::heap_select_nth;
+      case introselect:      return SCP::introselect;
+      case floyd_rivest:     return SCP::floyd_rivest_select;
+      case simd_quickselect: return SCP::simd_quickselect;
+      case sort_truncate:    return [](It b, It, It e){ SCP::introsort(b, e); };
+      case null_select:      return [](It, It, It){};
+      default: exit(-3);
+    };
+}
+
+
+/*******************************************************************************
+As get_select_func_ptr(), but comparing through counting_less.
+*******************************************************************************/
+template<
+  typename RandomAccessItertor>
+void (*get_counting_select_func_ptr(
+  const struct config args,
+  RandomAccessItertor
+))(
+  RandomAccessItertor,
+  RandomAccessItertor,
+  RandomAccessItertor
+){
+    typedef RandomAccessItertor It;
+    if(args.chosen_mode == partial_mode){
+      switch(args.chosen_select){
+        case heap_select:      return [](It b, It m, It e){ SCP::SCP_partial_sort(b, m, e, __gnu_cxx::__ops::__iter_comp_iter(counting_less())); };
+        case introselect:      return [](It b, It m, It e){ SCP::introselect(b, m, e, counting_less()); SCP::introsort(b, m, counting_less()); };
+        case floyd_rivest:     return [](It b, It m, It e){ SCP::floyd_rivest_select(b, m, e, counting_less()); SCP::introsort(b, m, counting_less()); };
+        case simd_quickselect: return [](It b, It m, It e){ SCP::simd_quickselect(b, m, e, counting_less()); SCP::simd_introsort(b, m, counting_less()); };
+        case sort_truncate:    return [](It b, It, It e){ SCP::introsort(b, e, counting_less()); };
+        case null_select:      return [](It, It, It){};
+        default: exit(-3);
+      };
+    }
+    switch(args.chosen_select){
+      case heap_select:      return [](It b, It n, It e){ SCP::heap_select_nth(b, n, e, counting_less()); };
+      case introselect:      return [](It b, It n, It e){ SCP::introselect(b, n, e, counting_less()); };
+      case floyd_rivest:     return [](It b, It n, It e){ SCP::floyd_rivest_select(b, n, e, counting_less()); };
+      case simd_quickselect: return [](It b, It n, It e){ SCP::simd_quickselect(b, n, e, counting_less()); };
+      case sort_truncate:    return [](It b, It, It e){ SCP::introsort(b, e, counting_less()); };
+      case null_select:      return [](It, It, It){};
+      default: exit(-3);
+    };
+}
@@ -0,0 +1,442 @@
+/*******************************************************************************
+Copyright Josh Marshall, 2018
+*******************************************************************************/
+
+/*******************************************************************************
+This file is part of "Sort Performance Comparison".
+
+"Sort Performance Comparison" is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+"Sort Performance Comparison" is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the Affero GNU General Public License
+version 3 for more details.
+
+You should have received a copy of the GNU Affero General Public License along
+with "Sort Performance Comparison".  If not, see <http://www.gnu.org/licenses/>.
+*******************************************************************************/
+
+
+
+
+
+/*******************************************************************************
+@brief Sorting networks for every size up to 32, built at compile time and
+unrolled into straight line code, for the scalar types the SIMD networks of
+simd_network.hpp don't cover and for sizes that aren't powers of two.
+
+For each size the smallest of these is taken:
+
+ * Knuth's merge exchange, Batcher's odd-even merge sort for any size (TAOCP
+   5.2.2, Algorithm M), which is optimal in size and depth up to 8.
+ * The smallest known networks for 9, 10, 12 and 16 inputs (Floyd, Waksman,
+   Shapiro and Green), or one of them with its highest inputs removed.
+ * The networks for the largest power of two below the size and for the rest,
+   merged with Batcher's odd-even merge with its highest inputs removed.
+
+Removing inputs works for any network in the usual form, with the smaller
+element going to the lower index: the removed inputs stand for keys greater
+than all others, which none of the remaining comparators can move.  That
+makes the networks optimal in size up to 12 and for 14 to 16, and as small as
+the smallest known for 31 and 32.  They are within 5% of it in between.
+
+Each comparator loads both keys and stores them back selected by one
+comparison, which compilers turn into conditional moves rather than branches.
+Only arithmetic and pointer types are sorted this way; for anything else a
+copy and a select cost more than the branch saves.
+*******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bits/predefined_ops.h>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+
+namespace SCP{
+namespace static_network{
+
+/// Set from --small-sort.  Engines only use the networks when this is set.
+inline bool use_networks = false;
+
+enum{
+  max_size = 32,
+  // the merge exchange network for 32 is the largest generated
+  max_comparators = 191
+};
+
+
+struct comparator{
+  unsigned char low;
+  unsigned char high;
+};
+
+
+/// A network, as the list of its comparators in the order they are applied.
+struct network{
+  std::size_t size = 0;
+  comparator comparators[max_comparators] = {};
+
+  constexpr void
+  add(
+    std::size_t low,
+    std::size_t high
+  ){
+    comparators[size++] = comparator{(unsigned char)low, (unsigned char)high};
+  }
+};
+
+
+/// Floyd, 25 comparators.
+inline constexpr comparator best_known_9[] = {
+  {0,3},{1,7},{2,5},{4,8},{0,7},{2,4},{3,8},{5,6},{0,2},{1,3},{4,5},{7,8},
+  {1,4},{3,6},{5,7},{0,1},{2,4},{3,5},{6,8},{2,3},{4,5},{6,7},{1,2},{3,4},
+  {5,6}};
+
+/// Waksman, 29 comparators.
+inline constexpr comparator best_known_10[] = {
+  {4,9},{3,8},{2,7},{1,6},{0,5},{1,4},{6,9},{0,3},{5,8},{0,2},{3,6},{7,9},
+  {0,1},{2,4},{5,7},{8,9},{1,2},{4,6},{7,8},{3,5},{2,5},{6,8},{1,3},{4,7},
+  {2,3},{6,7},{3,4},{5,6},{4,5}};
+
+/// Shapiro and Green, 39 comparators.
+inline constexpr comparator best_known_12[] = {
+  {0,8},{1,7},{2,6},{3,11},{4,10},{5,9},{0,1},{2,5},{3,4},{6,9},{7,8},
+  {10,11},{0,2},{1,6},{5,10},{9,11},{0,3},{1,2},{4,6},{5,7},{8,11},{9,10},
+  {1,4},{3,5},{6,8},{7,10},{1,3},{2,5},{6,9},{8,10},{2,3},{4,5},{6,7},{8,9},
+  {4,6},{5,7},{3,4},{5,6},{7,8}};
+
+/// Green, 60 comparators.
+inline constexpr comparator best_known_16[] = {
+  {0,13},{1,12},{2,15},{3,14},{4,8},{5,6},{7,11},{9,10},{0,5},{1,7},{2,9},
+  {3,4},{6,13},{8,14},{10,15},{11,12},{0,1},{2,3},{4,5},{6,8},{7,9},{10,11},
+  {12,13},{14,15},{0,2},{1,3},{4,10},{5,11},{6,7},{8,9},{12,14},{13,15},
+  {1,2},{3,12},{4,6},{5,7},{8,10},{9,11},{13,14},{1,4},{2,6},{5,8},{7,10},
+  {9,13},{11,14},{2,4},{3,6},{9,12},{11,13},{3,5},{6,8},{7,9},{10,12},{3,4},
+  {5,6},{7,8},{9,10},{11,12},{6,7},{8,9}};
+
+
+/// The comparators of a table that only touch inputs below n.
+template<
+  std::size_t Size>
+constexpr network
+truncated(
+  const comparator (&table)[Size],
+  std::size_t n
+){
+  network result;
+  for(const comparator &c : table)
+    if(c.high < n)
+      result.add(c.low, c.high);
+  return result;
+}
+
+
+/// Knuth's Algorithm M for n inputs.
+constexpr network
+merge_exchange(
+  std::size_t n
+){
+  network result;
+  if(n < 2)
+    return result;
+  std::size_t t = 1;
+  while((std::size_t(1) << t) < n)
+    ++t;
+  for(std::size_t p = std::size_t(1) << (t - 1); p > 0; p >>= 1){
+    std::size_t q = std::size_t(1) << (t - 1);
+    std::size_t r = 0;
+    std::size_t d = p;
+    for(;;){
+      for(std::size_t i = 0; i + d < n; ++i)
+        if((i & p) == r)
+          result.add(i, i + d);
+      if(q == p)
+        break;
+      d = q - p;
+      q >>= 1;
+      r = p;
+    }
+  }
+  return result;
+}
+
+
+/// Appends Batcher's odd-even merge of the two halves of the n inputs from
+/// lo, taking every rth, leaving out the comparators that touch limit or
+/// above.
+constexpr void
+odd_even_merge(
+  network &result,
+  std::size_t lo,
+  std::size_t n,
+  std::size_t r,
+  std::size_t limit
+){
+  const std::size_t m = r * 2;
+  if(m < n){
+    odd_even_merge(result, lo, n, m, limit);
+    odd_even_merge(result, lo + r, n, m, limit);
+    for(std::size_t i = lo + r; i + r < lo + n; i += m)
+      if(i + r < limit)
+        result.add(i, i + r);
+  }else if(lo + r < limit){
+    result.add(lo, lo + r);
+  }
+}
+
+
+constexpr network best_network(std::size_t n);
+
+
+/// The networks for the largest power of two p below n and for n - p above
+/// it, then a merge of the two.
+constexpr network
+merged(
+  std::size_t n
+){
+  std::size_t p = 1;
+  while(2 * p < n)
+    p *= 2;
+  network result = best_network(p);
+  const network upper = best_network(n - p);
+  for(std::size_t i = 0; i < upper.size; ++i)
+    result.add(upper.comparators[i].low + p, upper.comparators[i].high + p);
+  odd_even_merge(result, 0, 2 * p, 1, n);
+  return result;
+}
+
+
+/// The smallest of the networks described at the top for n inputs.
+constexpr network
+best_network(
+  std::size_t n
+){
+  network best = merge_exchange(n);
+  if(n < 2)
+    return best;
+  const network candidates[] = {
+    n <= 9 ? truncated(best_known_9, n) : best,
+    n <= 10 ? truncated(best_known_10, n) : best,
+    n <= 12 ? truncated(best_known_12, n) : best,
+    n <= 16 ? truncated(best_known_16, n) : best,
+    n > 2 ? merged(n) : best};
+  for(const network &candidate : candidates)
+    if(candidate.size < best.size)
+      best = candidate;
+  return best;
+}
+
+
+template<
+  std::size_t N>
+inline constexpr network network_v = best_network(N);
+
+
+/// Puts the lesser of *a and *b at a and the other at b.  __comp compares
+/// through iterators, as in introsort.hpp, here pointers to copies.
+template<
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+compare_exchange(
+  _RandomAccessIterator __a,
+  _RandomAccessIterator __b,
+  _Compare &__comp
+){
+  typedef typename std::iterator_traits<_RandomAccessIterator>::value_type
+    _ValueType;
+  const _ValueType __x = *__a;
+  const _ValueType __y = *__b;
+  const bool __swap = __comp(&__y, &__x);
+  *__a = __swap ? __y : __x;
+  *__b = __swap ? __x : __y;
+}
+
+
+template<
+  std::size_t N,
+  typename _RandomAccessIterator,
+  typename _Compare,
+  std::size_t... I>
+inline
+void
+apply_network(
+  _RandomAccessIterator __first,
+  _Compare &__comp,
+  std::index_sequence<I...>
+){
+  // the networks for 0 and 1 elements are empty
+  (void)__first;
+  (void)__comp;
+  (compare_exchange(__first + network_v<N>.comparators[I].low,
+                    __first + network_v<N>.comparators[I].high, __comp), ...);
+}
+
+
+/// Sorts the N elements from __first.
+template<
+  std::size_t N,
+  typename _RandomAccessIterator,
+  typename _Compare>
+void
+sort_n(
+  _RandomAccessIterator __first,
+  _Compare &__comp
+){
+  apply_network<N>(__first, __comp, std::make_index_sequence<network_v<N>.size>());
+}
+
+
+template<
+  typename _RandomAccessIterator,
+  typename _Compare,
+  std::size_t... N>
+constexpr auto
+kernel_table(
+  std::index_sequence<N...>
+){
+  return std::array<void (*)(_RandomAccessIterator, _Compare&), sizeof...(N)>{
+    &sort_n<N, _RandomAccessIterator, _Compare>...};
+}
+
+
+/// The network for __n elements, __n at most _Max, unrolled.  Sorting many
+/// ranges of the same length can look it up once.
+template<
+  std::size_t _Max,
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void (*kernel(
+  std::size_t __n
+))(_RandomAccessIterator, _Compare&){
+  static constexpr auto __kernels = kernel_table<_RandomAccessIterator, _Compare>(
+    std::make_index_sequence<_Max + 1>());
+  return __kernels[__n];
+}
+
+
+/// Sorts [__first, __last), of at most _Max elements, with the network for
+/// its length.
+template<
+  std::size_t _Max,
+  typename _RandomAccessIterator,
+  typename _Compare>
+inline
+void
+sort_small(
+  _RandomAccessIterator __first,
+  _RandomAccessIterator __last,
+  _Compare __comp
+){
+  kernel<_Max, _RandomAccessIterator, _Compare>(__last - __first)(__first, __comp);
+}
+
+
+/// Types the networks handle.
+template<
+  typename T>
+inline constexpr bool network_sortable_v =
+  std::is_arithmetic<T>::value || std::is_pointer<T>::value;
+
+
+/// Whether the engines should sort their short ranges of T with the networks.
+template<
+  typename T>
+inline
+bool
+use_network(
+){
+  if constexpr(network_sortable_v<T>)
+    return use_networks;
+  else
+    return false;
+}
+
+
+/**
+*  @brief Sort a small range of arithmetic or pointer elements with the
+*  network for its length.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @param  comp    A comparison functor.
+*  @return  Whether the range was sorted.
+*
+*  Returns false, leaving the range untouched, if it holds more than max_size
+*  elements or use_network() doesn't hold for its value type.
+*/
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+bool
+network_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if constexpr(network_sortable_v<T>){
+    if(last - first > max_size || !use_network<T>())
+      return false;
+    sort_small<max_size>(first, last, __gnu_cxx::__ops::__iter_comp_iter(comp));
+    return true;
+  }else{
+    return false;
+  }
+}
+
+
+/// Whether sorting T with Compare can't tell a network from a stable sort:
+/// integer and pointer keys in ascending order, where equal keys are the same
+/// value.  Floating point keys aren't, as -0.0 and +0.0 compare equal, and
+/// neither are keys under any other comparator, which may only look at part
+/// of them.
+template<
+  typename T,
+  typename Compare>
+inline constexpr bool stable_network_sortable_v =
+     (std::is_integral<T>::value || std::is_pointer<T>::value)
+  && (std::is_same<Compare, std::less<T> >::value
+      || std::is_same<Compare, std::less<> >::value);
+
+
+/**
+*  @brief network_sort() for the stable sorts.
+*  @param  first   An iterator.
+*  @param  last    Another iterator.
+*  @param  comp    A comparison functor.
+*  @return  Whether the range was sorted.
+*
+*  The networks aren't stable, so this also returns false, leaving the range
+*  untouched, unless stable_network_sortable_v holds.
+*/
+template<
+  typename RandomAccessIterator,
+  typename Compare>
+inline
+bool
+stable_network_sort(
+  RandomAccessIterator first,
+  RandomAccessIterator last,
+  Compare comp
+){
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  if constexpr(stable_network_sortable_v<T, Compare>)
+    return network_sort(first, last, comp);
+  else
+    return false;
+}
+
+};
+
+};
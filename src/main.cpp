@@ -27,14 +27,34 @@ TODO: add brief explanation
 TODO: Add rebust argument handling
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <deque>
+#include <functional>
+#include <random>
 //#include <forward_list>
 //#include <list>
+#include <thread>
 #include <vector>
 
+#include "append_sort.hpp"
 #include "data_preparation.hpp"
+#include "decorate_sort.hpp"
+#include "distributed_sort.hpp"
+#include "external_sort.hpp"
+#include "huge_pages.hpp"
 //#include "iterator_metrics.hpp"
+#include "parallel.hpp"
+#include "other_timsorts.hpp"
 #include "parse_arguments.hpp"
+#include "perf_counters.hpp"
+#include "prefetch.hpp"
+#include "scratch_accounting.hpp"
+#include "segmented_sort.hpp"
+#include "simd_network.hpp"
+#include "static_network.hpp"
 #include "sort_abstracter.hpp"
 
 
@@ -42,6 +62,444 @@ using std::vector;
 using std::deque;
 
 
+/*******************************************************************************
+Runs f, between starting and stopping the perf counters and the scratch memory
+accounting, if they were asked for.
+*******************************************************************************/
+template<
+  typename Function>
+void
+run_measured(
+  const struct config args,
+  Function f
+){
+  if(args.report_scratch)
+    SCP::scratch::start();
+  if(args.enable_perf_counters){
+    SCP::perf_counters counters;
+    counters.start();
+    f();
+    counters.stop();
+    counters.report(cout);
+  }else{
+    f();
+  }
+  if(args.report_scratch)
+    cout << "scratch bytes: " << SCP::scratch::stop() << endl;
+}
+
+
+/*******************************************************************************
+K for --mode partial and --mode select, checked against the length of the data,
+which for stdin is only known once it is read.
+*******************************************************************************/
+std::size_t
+selection_rank(
+  const struct config args,
+  std::size_t length
+){
+  if(args.select_k == 0)
+    return (length + 1) / 2;
+  if(std::size_t(args.select_k) > length){
+    cout << "k can't be larger than the length of the data." << endl;
+    exit(EINVAL);
+  }
+  return args.select_k;
+}
+
+
+/// The 64 bit finalizer of MurmurHash3.
+inline
+std::uint64_t
+hash_mix(
+  std::uint64_t x
+){
+  x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdULL;
+  x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+  return x ^ (x >> 33);
+}
+
+
+/*******************************************************************************
+An order independent hash of the elements, so that --verify can tell whether
+the data was only permuted without keeping a copy of it.
+*******************************************************************************/
+template<
+  typename Iterator>
+std::uint64_t
+multiset_checksum(
+  Iterator first,
+  Iterator last
+){
+  std::uint64_t sum = 0;
+  for(; first != last; ++first)
+    sum += hash_mix(std::uint64_t(*first));
+  return sum;
+}
+
+
+/*******************************************************************************
+The key of --mode project and --mode decorate: --key-cost rounds of hash_mix(),
+standing in for a key that is hashed or parsed out of a record.
+*******************************************************************************/
+std::uint64_t
+costly_key(
+  long value,
+  ssize_t rounds
+){
+  std::uint64_t x = std::uint64_t(value);
+  for(ssize_t i = 0; i < rounds; i++)
+    x = hash_mix(x);
+  return x;
+}
+
+
+/// A long that compares by its costly_key(), for --mode project.
+struct projected_long{
+  static inline ssize_t key_cost = 0;
+  long value;
+
+  projected_long() = default;
+
+  explicit
+  projected_long(
+    long value
+  ):
+    value(value)
+  {}
+
+  /// For multiset_checksum().
+  explicit
+  operator std::uint64_t(
+  ) const {
+    return std::uint64_t(value);
+  }
+
+  bool
+  operator<(
+    const projected_long &other
+  ) const {
+    return costly_key(value, key_cost) < costly_key(other.value, key_cost);
+  }
+};
+
+
+/// radix_sort sorts projected_long by its costly_key() too, computing it again
+/// on every pass.
+inline
+std::uint64_t
+radix_key(
+  const projected_long &x
+){
+  return costly_key(x.value, projected_long::key_cost);
+}
+
+
+/*******************************************************************************
+For --verify with a stable sort: -0.0 and +0.0 compare equal but have different
+bits, so sorting them mixed with other doubles shows whether equal elements kept
+their order.  Short arrays of every length up to 128 reach the sorts' small
+array paths, with --small-sort and --merge-kernel in effect, and through the
+batch entry point too when there is one.
+*******************************************************************************/
+void
+verify_stability(
+  const struct config args
+){
+  auto sorter = get_stable_sort_func_ptr(args, (double*)nullptr);
+  if(sorter == nullptr)
+    return;
+  auto batch_sorter = get_batch_sort_func_ptr(args, (double*)nullptr);
+  const double values[] = {-1.0, -0.0, 0.0, 1.0};
+  std::mt19937_64 generator(0);
+  auto stable = [&](vector<double> input, std::size_t length, bool batch){
+    vector<double> expected(input);
+    for(std::size_t i = 0; i < expected.size(); i += length)
+      std::stable_sort(expected.begin() + i, expected.begin() + std::min(i + length, expected.size()));
+    if(batch)
+      batch_sorter(input.data(), input.data() + input.size(), length);
+    else
+      sorter(input.data(), input.data() + input.size());
+    return std::memcmp(input.data(), expected.data(), input.size() * sizeof(double)) == 0;
+  };
+  bool correct = true;
+  for(std::size_t length = 1; correct && length <= 128; ++length){
+    vector<double> input(length * 16);
+    for(double &x : input)
+      x = values[generator() % 4];
+    for(std::size_t i = 0; correct && i < input.size(); i += length)
+      correct = stable(vector<double>(input.begin() + i, input.begin() + i + length), length, false);
+    if(correct && batch_sorter != nullptr)
+      correct = stable(input, length, true);
+  }
+  if(correct){
+    vector<double> input(10000);
+    for(double &x : input)
+      x = values[generator() % 4];
+    correct = stable(input, input.size(), false);
+  }
+  if(!correct){
+    cout << "Verification failed: the sort isn't stable." << endl;
+    exit(1);
+  }
+}
+
+
+template<
+  typename Iterator>
+void
+verify_result(
+  const struct config args,
+  Iterator first,
+  Iterator last,
+  std::size_t k,
+  std::uint64_t checksum
+){
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  bool correct = multiset_checksum(first, last) == checksum;
+  if(args.chosen_mode == partial_mode){
+    const Iterator middle = first + k;
+    correct = correct && std::is_sorted(first, middle)
+      && std::none_of(middle, last, [&](const T &x){ return x < *(middle - 1); });
+  }else if(args.chosen_mode == select_mode){
+    const Iterator nth = first + (k - 1);
+    correct = correct
+      && std::none_of(first, nth, [&](const T &x){ return *nth < x; })
+      && std::none_of(nth + 1, last, [&](const T &x){ return x < *nth; });
+  }else if(args.chosen_mode == small_arrays_mode){
+    for(Iterator array = first; correct && array != last; ){
+      const Iterator next = last - array > args.array_length ? array + args.array_length : last;
+      correct = std::is_sorted(array, next);
+      array = next;
+    }
+  }else{
+    correct = correct && std::is_sorted(first, last);
+  }
+  if(!correct){
+    cout << "Verification failed." << endl;
+    exit(1);
+  }
+  if(args.chosen_mode == undefined_mode || args.chosen_mode == sort_mode
+     || args.chosen_mode == small_arrays_mode)
+    verify_stability(args);
+  cout << "verified" << endl;
+}
+
+
+/*******************************************************************************
+--mode append and --mode append_merge.  The test data is generated as one
+sequence of --length + --rounds * --batch elements, so with 'sorted' every batch
+is greater than what it is appended to, and with 'reverse_sorted' less.  Its
+first --length elements are sorted up front, and then each round appends the
+next --batch and sorts again.  Only the sorting is timed, but generating and
+appending the batches is inside of the perf counters and scratch accounting.
+*******************************************************************************/
+template<
+  typename T,
+  template<typename, typename...> class container>
+void
+run_append_test(
+  const struct config args,
+  container<T>
+){
+  typedef typename container<T>::iterator iterator;
+  typedef std::chrono::steady_clock clock;
+
+  if(args.chosen_test == stdin_){
+    cout << "Appended batches can't be read from stdin." << endl;
+    exit(EINVAL);
+  }
+  struct config stream_args = args;
+  stream_args.test_length += args.append_batch * args.append_rounds;
+  test_data_stream<T> source(stream_args);
+
+  vector<T> batch(args.test_length);
+  source.read(batch.data(), batch.size());
+  std::uint64_t checksum = args.verify ? multiset_checksum(batch.begin(), batch.end()) : 0;
+  container<T> data(batch.begin(), batch.end());
+  std::sort(data.begin(), data.end());
+  batch.resize(args.append_batch);
+
+  auto sorter = args.count_comparisons
+              ? get_counting_sort_func_ptr(args, iterator())
+              : get_sort_func_ptr(args, iterator());
+  // the null sort leaves the batch unsorted, so there is nothing to merge
+  const bool merging = args.chosen_mode == append_merge_mode
+                    && args.chosen_sort != null;
+  clock::duration sorting(0);
+  run_measured(args, [&]{
+    for(ssize_t round = 0; round < args.append_rounds; round++){
+      source.read(batch.data(), batch.size());
+      if(args.verify)
+        checksum += multiset_checksum(batch.begin(), batch.end());
+      const std::size_t sorted_length = data.size();
+      data.insert(data.end(), batch.begin(), batch.end());
+
+      const clock::time_point start = clock::now();
+      const iterator begin = data.begin();
+      const iterator end = data.end();
+      if(!merging)
+        sorter(begin, end);
+      else if(args.count_comparisons)
+        SCP::sort_appended(begin, begin + sorted_length, end, sorter, counting_less());
+      else
+        SCP::sort_appended(begin, begin + sorted_length, end, sorter);
+      sorting += clock::now() - start;
+    }
+  });
+  cout << "sort seconds: " << std::chrono::duration<double>(sorting).count() << endl;
+  if(args.count_comparisons)
+    cout << "comparisons: " << comparison_count << endl;
+  if(args.verify)
+    verify_result(args, data.begin(), data.end(), 0, checksum);
+}
+
+
+/*******************************************************************************
+--mode project and --mode decorate, which sort the test data by costly_key().
+'project' sorts projected_long elements directly with the chosen sort, and
+'decorate' sorts the same elements with decorate_sort(), the chosen sort
+sorting the (key, index) pairs.
+*******************************************************************************/
+template<
+  typename T,
+  template<typename, typename...> class container>
+void
+run_projection_test(
+  const struct config args,
+  container<T>
+){
+  typedef vector<SCP::decorated<std::uint64_t> >::iterator decorated_iterator;
+
+  projected_long::key_cost = args.key_cost;
+  container<projected_long> data;
+  populate_container(args, data);
+  auto begin = data.begin();
+  auto end   = data.end();
+  const std::uint64_t checksum = args.verify ? multiset_checksum(begin, end) : 0;
+  if(args.chosen_mode == decorate_mode){
+    auto sorter = args.count_comparisons
+                ? get_counting_sort_func_ptr(args, decorated_iterator())
+                : get_sort_func_ptr(args, decorated_iterator());
+    auto key = [&](const projected_long &x){ return costly_key(x.value, args.key_cost); };
+    run_measured(args, [&]{ SCP::decorate_sort(begin, end, key, sorter); });
+  }else{
+    auto sorter = args.count_comparisons
+                ? get_counting_sort_func_ptr(args, begin)
+                : get_sort_func_ptr(args, begin);
+    run_measured(args, [&]{ sorter(begin, end); });
+  }
+  if(args.count_comparisons)
+    cout << "comparisons: " << comparison_count << endl;
+  if(args.verify)
+    verify_result(args, begin, end, 0, checksum);
+}
+
+
+/*******************************************************************************
+--mode small_arrays.  The test data is cut into arrays of --array-length, which
+are sorted one after the other.  With 'random_order' every array is random, and
+with the other orderings every array is in that order, as part of the whole.
+
+The arrays are sorted twice.  The first pass, through the batch entry point with
+--batch-entry, is timed as a whole for the throughput, and is what the perf
+counters, scratch accounting and --verify see.  The second pass sorts a copy
+of the input one array at a time, reading the clock between arrays, so each
+latency includes one clock read.
+*******************************************************************************/
+template<
+  typename T,
+  template<typename, typename...> class container>
+void
+run_small_arrays_test(
+  const struct config args,
+  container<T>
+){
+  typedef std::chrono::steady_clock clock;
+
+  container<T> data;
+  populate_container(args, data);
+  container<T> copy(data);
+  auto begin = data.begin();
+  auto end   = data.end();
+  const std::uint64_t checksum = args.verify ? multiset_checksum(begin, end) : 0;
+  auto sorter = args.count_comparisons
+              ? get_counting_sort_func_ptr(args, begin)
+              : get_sort_func_ptr(args, begin);
+  auto batch_sorter = get_batch_sort_func_ptr(args, begin);
+  if(args.batch_entry && batch_sorter == nullptr){
+    cout << "The chosen sort has no batch entry point." << endl;
+    exit(EINVAL);
+  }
+  const std::size_t length = args.array_length;
+  const std::size_t arrays = (data.size() + length - 1) / length;
+  auto next_array = [&](auto array, auto last){
+    return std::size_t(last - array) > length ? array + length : last;
+  };
+
+  clock::duration sorting(0);
+  run_measured(args, [&]{
+    const clock::time_point start = clock::now();
+    if(args.batch_entry){
+      batch_sorter(begin, end, length);
+    }else{
+      for(auto array = begin; array != end; array = next_array(array, end))
+        sorter(array, next_array(array, end));
+    }
+    sorting = clock::now() - start;
+  });
+  const std::size_t counted = comparison_count;
+
+  vector<clock::duration::rep> latencies;
+  latencies.reserve(arrays);
+  clock::time_point last_time = clock::now();
+  for(auto array = copy.begin(); array != copy.end(); array = next_array(array, copy.end())){
+    sorter(array, next_array(array, copy.end()));
+    const clock::time_point now = clock::now();
+    latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_time).count());
+    last_time = now;
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  cout << "arrays: " << arrays << endl;
+  if(arrays != 0){
+    const double seconds = std::chrono::duration<double>(sorting).count();
+    cout << "nanoseconds per array: " << seconds * 1e9 / arrays << endl;
+    cout << "arrays per second: " << arrays / seconds << endl;
+    for(const double percentile : {50.0, 90.0, 99.0, 99.9})
+      cout << "latency p" << percentile << " nanoseconds: "
+           << latencies[std::size_t(percentile / 100 * (arrays - 1))] << endl;
+    cout << "latency max nanoseconds: " << latencies.back() << endl;
+  }
+  if(args.count_comparisons)
+    cout << "comparisons: " << counted << endl;
+  if(args.verify)
+    verify_result(args, begin, end, 0, checksum);
+}
+
+
+/*******************************************************************************
+--segmented.  gather_sort_scatter() moves the container into a buffer a block at a
+time, the chosen sort sorts it through plain pointers, and it is moved back.
+*******************************************************************************/
+template<
+  typename Iterator>
+void
+run_segmented_sort(
+  const struct config args,
+  Iterator begin,
+  Iterator end
+){
+  typedef typename std::iterator_traits<Iterator>::value_type value_type;
+  auto sorter = args.count_comparisons
+              ? get_counting_sort_func_ptr(args, (value_type*)nullptr)
+              : get_sort_func_ptr(args, (value_type*)nullptr);
+  SCP::segmented::stats counts;
+  run_measured(args, [&]{ counts = SCP::segmented::gather_sort_scatter(begin, end, sorter); });
+  counts.report(cout);
+}
+
+
 template<
   typename T,
   template<typename, typename...> class container>
@@ -62,6 +520,19 @@ run_test_on_container(
   iterator;
   //*/
 
+  if(args.chosen_mode == append_mode || args.chosen_mode == append_merge_mode){
+    run_append_test(args, container<T>());
+    return;
+  }
+  if(args.chosen_mode == project_mode || args.chosen_mode == decorate_mode){
+    run_projection_test(args, container<T>());
+    return;
+  }
+  if(args.chosen_mode == small_arrays_mode){
+    run_small_arrays_test(args, container<T>());
+    return;
+  }
+
   container<T> data;
   populate_container(args, data);
 
@@ -74,16 +545,178 @@ run_test_on_container(
   }else{//*/
   auto begin = data.begin();
   auto end   = data.end();
-  auto sorter = get_sort_func_ptr(args, begin);
-  sorter(begin, end);
+  const bool selecting = args.chosen_mode == partial_mode
+                      || args.chosen_mode == select_mode;
+  const std::size_t k = selecting ? selection_rank(args, data.size()) : 0;
+  const std::uint64_t checksum = args.verify ? multiset_checksum(begin, end) : 0;
+  if(selecting){
+    // 'partial' sorts [begin, begin + k), 'select' places the kth at k - 1.
+    auto middle = args.chosen_mode == partial_mode ? begin + k
+                : k == 0 ? end : begin + (k - 1);
+    auto selector = args.count_comparisons
+                  ? get_counting_select_func_ptr(args, begin)
+                  : get_select_func_ptr(args, begin);
+    run_measured(args, [&]{ selector(begin, middle, end); });
+  }else if(args.segmented){
+    run_segmented_sort(args, begin, end);
+  }else if(args.warm_scratch){
+    // the first call grows the thread's arenas on a copy, the second reuses them
+    typedef std::chrono::steady_clock clock;
+    auto sorter = args.count_comparisons
+                ? get_counting_sort_func_ptr(args, begin)
+                : get_sort_func_ptr(args, begin);
+    container<T> copy(data);
+    const clock::time_point first_start = clock::now();
+    sorter(copy.begin(), copy.end());
+    const clock::duration first_call = clock::now() - first_start;
+    comparison_count = 0;
+    clock::duration warm_call(0);
+    run_measured(args, [&]{
+      const clock::time_point start = clock::now();
+      sorter(begin, end);
+      warm_call = clock::now() - start;
+    });
+    cout << "first call seconds: " << std::chrono::duration<double>(first_call).count() << endl;
+    cout << "warm call seconds: " << std::chrono::duration<double>(warm_call).count() << endl;
+  }else{
+    auto sorter = args.count_comparisons
+                ? get_counting_sort_func_ptr(args, begin)
+                : get_sort_func_ptr(args, begin);
+    run_measured(args, [&]{ sorter(begin, end); });
+  }
+  if(args.count_comparisons)
+    cout << "comparisons: " << comparison_count << endl;
+  if(!selecting && args.chosen_sort == auto_)
+    SCP::autosort::last_decision.report(cout);
+  if(args.verify && !(args.chosen_mode == select_mode && k == 0))
+    verify_result(args, begin, end, k, checksum);
   //}
 }
 
 
+/*******************************************************************************
+--verify for --memory-budget: neither the input nor the output is held in
+memory, so both are streamed through a block at a time.  The input is produced
+again by a second test_data_stream, which yields the same data.
+*******************************************************************************/
+std::uint64_t
+external_input_checksum(
+  const struct config args
+){
+  test_data_stream<long int> source(args);
+  vector<long int> block(std::size_t(1) << 16);
+  std::uint64_t checksum = 0;
+  for(std::size_t got; (got = source.read(block.data(), block.size())) != 0; )
+    checksum += multiset_checksum(block.begin(), block.begin() + got);
+  return checksum;
+}
+
+
+void
+verify_external_result(
+  const struct config args,
+  int fd,
+  std::uint64_t checksum
+){
+  vector<long int> block(std::size_t(1) << 16);
+  std::uint64_t sum = 0;
+  bool correct = true;
+  long int previous = LONG_MIN;
+  for(ssize_t done = 0; correct && done < args.test_length; ){
+    const std::size_t count = std::min<std::size_t>(block.size(), args.test_length - done);
+    SCP::external::read_fully(fd, block.data(), count * sizeof(long int),
+                              off_t(done * sizeof(long int)));
+    correct = previous <= block[0] && std::is_sorted(block.begin(), block.begin() + count);
+    sum += multiset_checksum(block.begin(), block.begin() + count);
+    previous = block[count - 1];
+    done += count;
+  }
+  if(!correct || sum != checksum || lseek(fd, 0, SEEK_END) != off_t(args.test_length * sizeof(long int))){
+    cout << "Verification failed." << endl;
+    exit(1);
+  }
+  cout << "verified" << endl;
+}
+
+
+void
+run_external_test(
+  const struct config args
+){
+  if(args.chosen_container != vector_){
+    cout << "External sorting is only supported with the 'vector' container." << endl;
+    exit(EINVAL);
+  }
+  if(args.count_comparisons){
+    cout << "Comparisons can't be counted in an external sort." << endl;
+    exit(EINVAL);
+  }
+  if(args.chosen_mode != undefined_mode && args.chosen_mode != sort_mode){
+    cout << "Only full sorts can be run externally." << endl;
+    exit(EINVAL);
+  }
+
+  const std::uint64_t checksum = args.verify ? external_input_checksum(args) : 0;
+  test_data_stream<long int> source(args);
+  auto sorter = get_sort_func_ptr(args, (long int*)nullptr);
+  // the sorted output is written out like a run, and thrown away once verified
+  const int out_fd = SCP::external::open_temporary();
+  SCP::external::stats counts;
+  run_measured(args, [&]{
+    counts = SCP::external::external_sort<long int>(
+      [&](long int *out, std::size_t max){ return source.read(out, max); },
+      sorter, out_fd, args.memory_budget);
+  });
+  counts.report(cout);
+  if(args.verify)
+    verify_external_result(args, out_fd, checksum);
+  close(out_fd);
+}
+
+
+void
+run_distributed_test(
+  const struct config args
+){
+  if(args.chosen_container != vector_){
+    cout << "Distributed sorting is only supported with the 'vector' container." << endl;
+    exit(EINVAL);
+  }
+  if(args.count_comparisons){
+    cout << "Comparisons can't be counted across processes." << endl;
+    exit(EINVAL);
+  }
+
+  vector<long int> data;
+  populate_container(args, data);
+  const std::uint64_t checksum = args.verify ? multiset_checksum(data.begin(), data.end()) : 0;
+  const std::size_t processes = args.process_count != 0
+                              ? args.process_count
+                              : std::max(1u, std::thread::hardware_concurrency());
+  auto sorter = get_sort_func_ptr(args, (long int*)nullptr);
+  SCP::distributed::stats counts;
+  run_measured(args, [&]{
+    counts = SCP::distributed::distributed_sort(
+      data.data(), data.data() + data.size(), sorter, processes);
+  });
+  counts.report(cout);
+  if(args.verify)
+    verify_result(args, data.begin(), data.end(), 0, checksum);
+}
+
+
 void
 test_bootstrap(
   const struct config args
 ){
+  if(args.memory_budget != 0){
+    run_external_test(args);
+    return;
+  }
+  if(args.chosen_mode == distributed_mode){
+    run_distributed_test(args);
+    return;
+  }
   /*if(args.enable_iterator_metrics){
     switch(args.chosen_container){
       case deque_:
@@ -101,7 +734,7 @@ test_bootstrap(
       run_test_on_container(args, std::deque<long int>());
       break;
     case vector_:
-      run_test_on_container(args, std::vector<long int>());
+      run_test_on_container(args, SCP::huge_pages::vector<long int>());
       break;
     default:
       exit(-2);
@@ -126,6 +759,109 @@ int main(int argc, char **argv){
     return results;
   }
 
+  SCP::parallel::thread_count = run_config.thread_count;
+  SCP::simd::use_networks = run_config.chosen_small_sort == network_small_sort;
+  SCP::static_network::use_networks = run_config.chosen_small_sort == static_network_small_sort;
+  SCP::prefetch::enabled = run_config.prefetch;
+  gfx::pooled_scratch = run_config.warm_scratch;
+  tim::pooled_scratch = run_config.warm_scratch;
+  if(run_config.chosen_pages == small_pages)
+    SCP::huge_pages::pages = SCP::huge_pages::page_size::small;
+  else if(run_config.chosen_pages == transparent_huge_pages)
+    SCP::huge_pages::pages = SCP::huge_pages::page_size::transparent;
+  else if(run_config.chosen_pages == hugetlbfs_pages)
+    SCP::huge_pages::pages = SCP::huge_pages::page_size::hugetlb;
+  if(run_config.chosen_pages == hugetlbfs_pages){
+    try{
+      SCP::huge_pages::deallocate(SCP::huge_pages::allocate(SCP::huge_pages::huge_page_bytes),
+                                  SCP::huge_pages::huge_page_bytes);
+    }catch(const std::bad_alloc &){
+      cout << "No huge pages could be mapped for --pages hugetlbfs; reserve some in /proc/sys/vm/nr_hugepages." << endl;
+      return EINVAL;
+    }
+  }
+  SCP::huge_pages::accounting = [](std::ptrdiff_t bytes){
+    if(SCP::scratch::counting.load(std::memory_order_relaxed))
+      SCP::scratch::allocated(bytes);
+  };
+  #ifdef TIMSORT_MERGE_KERNEL
+  if(run_config.chosen_merge_kernel != undefined_merge_kernel){
+    cout << "The merge kernel was fixed at compile time." << endl;
+    return EINVAL;
+  }
+  #else
+  if(run_config.chosen_merge_kernel == branchless_merge_kernel)
+    tim::merge_kernel = tim::merge_kernel_type::branchless;
+  else if(run_config.chosen_merge_kernel == simd_merge_kernel)
+    tim::merge_kernel = tim::merge_kernel_type::simd;
+  #endif
+  if(run_config.chosen_final_merge == multiway_final_merge){
+    gfx::final_merge = SCP::final_merge_type::multiway;
+    tim::final_merge = SCP::final_merge_type::multiway;
+  }
+
+  if(run_config.chosen_mode == partial_mode
+     || run_config.chosen_mode == select_mode){
+    if(run_config.chosen_select == undefined_select){
+      cout << "--mode partial and --mode select need a --select-type." << endl;
+      return EINVAL;
+    }
+    if(run_config.chosen_mode == partial_mode && run_config.select_k == 0){
+      cout << "--mode partial needs a --k." << endl;
+      return EINVAL;
+    }
+  }else if(run_config.chosen_select != undefined_select
+           || run_config.select_k != 0){
+    cout << "--select-type and --k only apply to --mode partial and --mode select." << endl;
+    return EINVAL;
+  }
+  if(run_config.chosen_mode == append_mode
+     || run_config.chosen_mode == append_merge_mode){
+    if(run_config.append_batch == 0 || run_config.append_rounds == 0){
+      cout << "--mode append and --mode append_merge need a --batch and --rounds." << endl;
+      return EINVAL;
+    }
+  }else if(run_config.append_batch != 0 || run_config.append_rounds != 0){
+    cout << "--batch and --rounds only apply to --mode append and --mode append_merge." << endl;
+    return EINVAL;
+  }
+  if(run_config.chosen_mode == project_mode
+     || run_config.chosen_mode == decorate_mode){
+    if(run_config.key_cost == 0){
+      cout << "--mode project and --mode decorate need a --key-cost." << endl;
+      return EINVAL;
+    }
+  }else if(run_config.key_cost != 0){
+    cout << "--key-cost only applies to --mode project and --mode decorate." << endl;
+    return EINVAL;
+  }
+  if(run_config.segmented
+     && ((run_config.chosen_mode != undefined_mode && run_config.chosen_mode != sort_mode)
+         || run_config.memory_budget != 0)){
+    cout << "--segmented only applies to --mode sort, in memory." << endl;
+    return EINVAL;
+  }
+  if(run_config.warm_scratch
+     && ((run_config.chosen_mode != undefined_mode && run_config.chosen_mode != sort_mode
+          && run_config.chosen_mode != small_arrays_mode)
+         || run_config.memory_budget != 0)){
+    cout << "--warm-scratch only applies to --mode sort and --mode small_arrays, in memory." << endl;
+    return EINVAL;
+  }
+  if(run_config.chosen_mode != distributed_mode && run_config.process_count != 0){
+    cout << "--processes only applies to --mode distributed." << endl;
+    return EINVAL;
+  }
+  if(run_config.chosen_mode == small_arrays_mode){
+    if(run_config.array_length == 0){
+      cout << "--mode small_arrays needs an --array-length." << endl;
+      return EINVAL;
+    }
+  }else if(run_config.array_length != 0 || run_config.batch_entry){
+    cout << "--array-length and --batch-entry only apply to --mode small_arrays." << endl;
+    return EINVAL;
+  }
+
   #ifdef SCP_DEBUG
   cout << "Got configuration, running analysis" << endl;
   #endif